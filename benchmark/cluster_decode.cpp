@@ -0,0 +1,115 @@
+/*
+ * Decoding throughput of compressed clusters.
+ *
+ * Compares the two ways a cluster is read from a file:
+ *  - "stream": the compressed data is fed to the decoder in small chunks
+ *    read from the file (the cluster size is unknown).
+ *  - "whole": the compressed data is loaded at once and decoded from memory
+ *    (the archive gives an upper bound of the cluster size).
+ *
+ * Usage: cluster_decode [iterations]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zim/zim.h>
+
+#include "../src/cluster.h"
+#include "../src/file_compound.h"
+#include "../src/file_reader.h"
+#include "../src/writer/cluster.h"
+
+namespace
+{
+
+const char* const CLUSTER_FILE = "cluster_decode.bench";
+
+std::string makeBlob(unsigned seed, size_t size)
+{
+  static const char* const words[] = {
+    "zim", "archive", "cluster", "blob", "entry", "title", "content", "the",
+    "of", "and", "wikipedia", "compression", "offline", "reader", "article"
+  };
+  std::string blob;
+  while (blob.size() < size) {
+    seed = seed * 1103515245 + 12345;
+    blob += words[(seed >> 16) % (sizeof(words)/sizeof(words[0]))];
+    blob += ' ';
+  }
+  blob.resize(size);
+  return blob;
+}
+
+zim::zsize_t writeCluster(zim::CompressionType comp)
+{
+  zim::writer::Cluster cluster(comp);
+  for (unsigned i = 0; i < 256; ++i) {
+    cluster.addContent(makeBlob(i, 8*1024));
+  }
+  cluster.close();
+
+  const int fd = ::open(CLUSTER_FILE, O_RDWR|O_CREAT|O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create the cluster file");
+  }
+  cluster.write(fd);
+  const auto size = ::lseek(fd, 0, SEEK_END);
+  ::close(fd);
+  return zim::zsize_t(size);
+}
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+double decodeAll(const zim::Reader& reader, zim::zsize_t maxClusterSize, int iterations, zim::size_type* decodedSize)
+{
+  *decodedSize = 0;
+  const double start = now();
+  for (int i = 0; i < iterations; ++i) {
+    const auto cluster = zim::Cluster::read(reader, zim::offset_t(0), maxClusterSize);
+    for (zim::blob_index_type n = 0; n < cluster->count().v; ++n) {
+      *decodedSize += cluster->getBlob(zim::blob_index_t(n)).size();
+    }
+  }
+  return now() - start;
+}
+
+void run(const char* name, zim::CompressionType comp, int iterations)
+{
+  const auto clusterSize = writeCluster(comp);
+  auto fileCompound = std::make_shared<zim::FileCompound>(CLUSTER_FILE);
+  const auto& part = fileCompound->begin()->second;
+  const zim::FileReader reader(part, zim::offset_t(0), clusterSize);
+
+  zim::size_type decodedSize;
+  const auto streamTime = decodeAll(reader, zim::zsize_t(0), iterations, &decodedSize);
+  const auto wholeTime = decodeAll(reader, clusterSize, iterations, &decodedSize);
+  const double mb = decodedSize / (1024.0 * 1024.0);
+
+  std::cout << name << " (" << clusterSize.v << " compressed bytes):" << std::endl;
+  std::cout << "  stream: " << mb / streamTime << " MB/s" << std::endl;
+  std::cout << "  whole:  " << mb / wholeTime << " MB/s" << std::endl;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+  run("zstd", zim::zimcompZstd, iterations);
+  run("lzma", zim::zimcompLzma, iterations / 10 + 1);
+  std::remove(CLUSTER_FILE);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Throughput of random cluster reads on a cold page cache.
+ *
+ * Reads the (compressed) data of random clusters of an archive:
+ *  - "one by one": a blocking read per cluster.
+ *  - "batch": Reader::readBatch(), submitting the reads of a batch at once
+ *    (with io_uring when libzim is built with it).
+ *
+ * The archive is dropped from the page cache before each run. This only
+ * works for a single part archive.
+ *
+ * Usage: cluster_fetch <zim file> [clusters] [batch size]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+
+#include "../src/buffer.h"
+#include "../src/file_reader.h"
+#include "../src/fileimpl.h"
+#include "../src/fs.h"
+
+namespace
+{
+
+struct ClusterRange
+{
+  zim::offset_t offset;
+  zim::zsize_t size;
+};
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+// The size of a cluster is the distance to the next one.
+std::vector<ClusterRange> getClusterRanges(const zim::FileImpl& impl)
+{
+  std::vector<zim::offset_type> offsets;
+  for (zim::cluster_index_type i = 0; i < impl.getCountClusters().v; ++i) {
+    offsets.push_back(impl.getClusterOffset(zim::cluster_index_t(i)).v);
+  }
+  std::sort(offsets.begin(), offsets.end());
+  const auto& header = impl.getFileheader();
+  const auto end = header.hasChecksum() ? header.getChecksumPos() : impl.getFilesize().v;
+
+  std::vector<ClusterRange> ranges;
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    const auto next = i + 1 < offsets.size() ? offsets[i+1] : end;
+    ranges.push_back({zim::offset_t(offsets[i]), zim::zsize_t(std::min(next, end) - offsets[i])});
+  }
+  return ranges;
+}
+
+void dropPageCache(const zim::DEFAULTFS::FD& fd)
+{
+  posix_fadvise(fd.getNativeHandle(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+double readOneByOne(const zim::Reader& reader, const std::vector<ClusterRange>& clusters)
+{
+  size_t size = 0;
+  const double start = now();
+  for (const auto& cluster: clusters) {
+    auto data = zim::Buffer::makeBuffer(cluster.size);
+    reader.read(const_cast<char*>(data.data()), cluster.offset, cluster.size);
+    size += cluster.size.v;
+  }
+  return size / (1024.0 * 1024.0) / (now() - start);
+}
+
+double readByBatch(const zim::Reader& reader, const std::vector<ClusterRange>& clusters, size_t batchSize)
+{
+  size_t size = 0;
+  const double start = now();
+  for (size_t begin = 0; begin < clusters.size(); begin += batchSize) {
+    const size_t end = std::min(clusters.size(), begin + batchSize);
+    std::vector<zim::Buffer> data;
+    std::vector<zim::Reader::ReadRequest> requests;
+    data.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      data.push_back(zim::Buffer::makeBuffer(clusters[i].size));
+      requests.push_back({const_cast<char*>(data.back().data()), clusters[i].offset, clusters[i].size});
+      size += clusters[i].size.v;
+    }
+    reader.readBatch(requests);
+  }
+  return size / (1024.0 * 1024.0) / (now() - start);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <zim file> [clusters] [batch size]" << std::endl;
+    return 1;
+  }
+  const size_t clusterCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const size_t batchSize = argc > 3 ? std::atoi(argv[3]) : 64;
+
+  const zim::FileImpl impl(argv[1]);
+  const auto ranges = getClusterRanges(impl);
+  if (ranges.empty()) {
+    std::cerr << "No cluster in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<ClusterRange> clusters;
+  unsigned seed = 1;
+  for (size_t i = 0; i < clusterCount; ++i) {
+    seed = seed * 1103515245 + 12345;
+    clusters.push_back(ranges[(seed >> 4) % ranges.size()]);
+  }
+
+  const auto fd = std::make_shared<zim::DEFAULTFS::FD>(zim::DEFAULTFS::openFile(argv[1]));
+  const zim::FileReader reader(fd, zim::offset_t(0), fd->getSize());
+
+  dropPageCache(*fd);
+  std::cout << "one by one: " << readOneByOne(reader, clusters) << " MB/s" << std::endl;
+  dropPageCache(*fd);
+  std::cout << "batch(" << batchSize << "): " << readByBatch(reader, clusters, batchSize) << " MB/s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Scaling of ConcurrentCache with the number of threads.
+ *
+ * Each thread accesses random keys of a cache holding half of the key space,
+ * as a server reading clusters for concurrent requests. The sharded cache is
+ * compared with a single shard one (one lock for the whole cache).
+ *
+ * Usage: concurrent_cache [accesses per thread]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../src/concurrent_cache.h"
+
+namespace
+{
+
+const size_t CACHE_SIZE = 512;
+const unsigned KEY_COUNT = 2 * CACHE_SIZE;
+
+// Keeps the compiler from optimizing the accesses away.
+std::atomic<unsigned> sink(0);
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+double run(size_t shardCount, unsigned threadCount, unsigned accesses)
+{
+  zim::ConcurrentCache<unsigned, std::shared_ptr<const unsigned>> cache(CACHE_SIZE, shardCount);
+  std::vector<std::thread> threads;
+  const double start = now();
+  for (unsigned t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&cache, t, accesses](){
+      unsigned seed = t + 1;
+      unsigned sum = 0;
+      for (unsigned i = 0; i < accesses; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const unsigned key = (seed >> 8) % KEY_COUNT;
+        sum += *cache.getOrPut(key, [key](){ return std::make_shared<const unsigned>(key); });
+      }
+      sink += sum;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  return threadCount * accesses / (now() - start);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  const unsigned accesses = argc > 1 ? std::atoi(argv[1]) : 200000;
+  std::cout << "threads  1 shard (Mops/s)  sharded (Mops/s)" << std::endl;
+  for (unsigned threadCount = 1; threadCount <= 64; threadCount *= 2) {
+    const double single = run(1, threadCount, accesses);
+    const double sharded = run(0, threadCount, accesses);
+    std::cout << threadCount << "\t " << single / 1e6 << "\t\t   " << sharded / 1e6 << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Scaling of dirent reads with the number of threads.
+ *
+ * Each thread reads random entries of an archive by index. The dirent
+ * cache is disabled so that every access parses the dirent from the file.
+ *
+ * Usage: dirent_lookup <zim file> [lookups per thread]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <zim/archive.h>
+#include <zim/entry.h>
+
+namespace
+{
+
+// Keeps the compiler from optimizing the lookups away.
+std::atomic<size_t> sink(0);
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+double run(const zim::Archive& archive, unsigned threadCount, unsigned lookups)
+{
+  const auto entryCount = archive.getEntryCount();
+  std::vector<std::thread> threads;
+  const double start = now();
+  for (unsigned t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&archive, entryCount, t, lookups](){
+      unsigned seed = t + 1;
+      size_t sum = 0;
+      for (unsigned i = 0; i < lookups; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const auto entry = archive.getEntryByPath((seed >> 4) % entryCount);
+        sum += entry.getPath().size();
+      }
+      sink += sum;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  return threadCount * lookups / (now() - start);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <zim file> [lookups per thread]" << std::endl;
+    return 1;
+  }
+  const unsigned lookups = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+  setenv("ZIM_DIRENTCACHE", "0", 1);
+  const zim::Archive archive(argv[1]);
+
+  std::cout << "threads  lookups/s" << std::endl;
+  for (unsigned threadCount = 1; threadCount <= 64; threadCount *= 2) {
+    std::cout << threadCount << "\t " << run(archive, threadCount, lookups) << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Throughput of a full read of an archive.
+ *
+ * Compares reading all the items with iterEfficient() (one thread, through
+ * the cluster cache) to Archive::forEachItem() with a growing number of
+ * threads.
+ *
+ * Usage: for_each_item <zim file> [max threads]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <zim/archive.h>
+#include <zim/entry.h>
+#include <zim/item.h>
+
+namespace
+{
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+double iterate(const zim::Archive& archive)
+{
+  size_t size = 0;
+  const double start = now();
+  for (auto entry: archive.iterEfficient()) {
+    if (!entry.isRedirect()) {
+      size += entry.getItem().getData().size();
+    }
+  }
+  return size / (1024.0 * 1024.0) / (now() - start);
+}
+
+double visit(const zim::Archive& archive, unsigned threadCount)
+{
+  std::atomic<size_t> size(0);
+  const double start = now();
+  archive.forEachItem([&size](const zim::Item&, const zim::Blob& data) {
+    size += data.size();
+  }, threadCount);
+  return size / (1024.0 * 1024.0) / (now() - start);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <zim file> [max threads]" << std::endl;
+    return 1;
+  }
+  const unsigned maxThreads = argc > 2 ? std::atoi(argv[2]) : 8;
+
+  const zim::Archive archive(argv[1]);
+  std::cout << "iterEfficient: " << iterate(archive) << " MB/s" << std::endl;
+  for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+    std::cout << "forEachItem(" << threadCount << "): " << visit(archive, threadCount) << " MB/s" << std::endl;
+  }
+  return 0;
+}
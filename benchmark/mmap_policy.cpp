@@ -0,0 +1,154 @@
+/*
+ * Cost of the policies of mapping of the archive in memory.
+ *
+ * For each policy (applied to all the kinds of regions, or the default
+ * policies), a process opens the archive from a cold page cache, reads
+ * the items of a sample of entries, then reads them again. It measures:
+ *  - "cold": the opening and the first read of the items,
+ *  - "warm": the second read of the items,
+ *  - "rss": the resident memory of the process after the reads (only
+ *    available on Linux).
+ * Dropping the page cache only works for single part archives.
+ *
+ * Usage: mmap_policy [-n <number of entries>] <zim file>
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <zim/archive.h>
+#include <zim/entry.h>
+#include <zim/item.h>
+
+namespace
+{
+
+struct Policy
+{
+  const char* name;
+  bool isDefault;
+  zim::MmapPolicy policy;
+};
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+void dropPageCache(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+// The resident memory of the process (in KiB), 0 if unknown.
+size_t residentMemory()
+{
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * (sysconf(_SC_PAGE_SIZE) / 1024);
+}
+
+size_t readItems(const zim::Archive& archive, const std::vector<zim::entry_index_type>& indexes)
+{
+  size_t total = 0;
+  for (const auto idx: indexes) {
+    const auto entry = archive.getEntryByPath(idx);
+    if (!entry.isRedirect()) {
+      total += entry.getItem().getData().size();
+    }
+  }
+  return total;
+}
+
+// Run in a child process, so that each policy starts with the same memory.
+void run(const std::string& path, const std::vector<zim::entry_index_type>& indexes, const Policy& policy)
+{
+  if (!policy.isDefault) {
+    for (const auto region: {zim::MemoryRegion::POINTER_TABLES, zim::MemoryRegion::CLUSTERS, zim::MemoryRegion::BLOBS}) {
+      zim::setMmapPolicy(region, policy.policy);
+    }
+  }
+  dropPageCache(path);
+  const double start = now();
+  const zim::Archive archive(path);
+  readItems(archive, indexes);
+  const double cold = now();
+  readItems(archive, indexes);
+  const double warm = now();
+  std::cout << std::left << std::setw(10) << policy.name << std::right
+            << std::fixed << std::setprecision(3)
+            << std::setw(10) << (cold - start) * 1000 << "  "
+            << std::setw(10) << (warm - cold) * 1000 << "  "
+            << std::setw(9) << residentMemory() << std::endl;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  unsigned count = 1000;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      count = std::atoi(argv[++i]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path.empty() || count == 0) {
+    std::cerr << "Usage: " << argv[0] << " [-n <number of entries>] <zim file>" << std::endl;
+    return 1;
+  }
+
+  std::vector<zim::entry_index_type> indexes;
+  {
+    const zim::Archive archive(path);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<zim::entry_index_type> distribution(0, archive.getEntryCount() - 1);
+    for (unsigned i = 0; i < count; ++i) {
+      indexes.push_back(distribution(random));
+    }
+  }
+
+  const Policy policies[] = {
+    {"default", true, zim::MmapPolicy::LAZY},
+    {"populate", false, zim::MmapPolicy::POPULATE},
+    {"lazy", false, zim::MmapPolicy::LAZY},
+    {"random", false, zim::MmapPolicy::RANDOM},
+    {"willneed", false, zim::MmapPolicy::WILLNEED},
+    {"hugepage", false, zim::MmapPolicy::HUGEPAGE}
+  };
+  std::cout << "policy    cold (ms)   warm (ms)   rss (KiB)" << std::endl;
+  for (const auto& policy: policies) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      std::cerr << "Cannot fork: " << std::strerror(errno) << std::endl;
+      return 1;
+    }
+    if (pid == 0) {
+      run(path, indexes, policy);
+      std::exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+  }
+  return 0;
+}
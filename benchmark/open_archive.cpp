@@ -0,0 +1,109 @@
+/*
+ * Latency of the opening of archives.
+ *
+ * Opens each of the given archives several times, with both open modes,
+ * and measures:
+ *  - "open": the construction of the archive,
+ *  - "first lookup": a first lookup by path in the opened archive (this is
+ *    where the lazy mode reads what it skipped when opening).
+ * The archives are opened from a cold page cache (the archive is dropped
+ * from it before each opening) and then from a warm one. Dropping the
+ * page cache only works for single part archives.
+ *
+ * Usage: open_archive [-n <openings per archive>] <zim file>...
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zim/archive.h>
+#include <zim/entry.h>
+
+namespace
+{
+
+struct Latency
+{
+  double open = 0;
+  double firstLookup = 0;
+};
+
+double now()
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+void dropPageCache(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+// Mean latencies (in ms) of the openings of all the archives.
+Latency run(const std::vector<std::string>& paths, unsigned openings, zim::OpenMode mode, bool cold)
+{
+  Latency total;
+  for (const auto& path: paths) {
+    // The path of an entry, from an archive which is not measured.
+    const auto entryPath = zim::Archive(path).getMainEntry().getPath();
+    for (unsigned i = 0; i < openings; ++i) {
+      if (cold) {
+        dropPageCache(path);
+      }
+      const double start = now();
+      const zim::Archive archive(path, mode);
+      const double opened = now();
+      archive.getEntryByPath(entryPath);
+      total.open += opened - start;
+      total.firstLookup += now() - opened;
+    }
+  }
+  const auto count = paths.size() * openings;
+  total.open = total.open * 1000 / count;
+  total.firstLookup = total.firstLookup * 1000 / count;
+  return total;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  unsigned openings = 20;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      openings = std::atoi(argv[++i]);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.empty() || openings == 0) {
+    std::cerr << "Usage: " << argv[0] << " [-n <openings per archive>] <zim file>..." << std::endl;
+    return 1;
+  }
+
+  std::cout << "mode  cache  open (ms)  first lookup (ms)" << std::endl;
+  for (const bool cold: {true, false}) {
+    for (const auto mode: {zim::OpenMode::EAGER, zim::OpenMode::LAZY}) {
+      const auto latency = run(paths, openings, mode, cold);
+      std::cout << (mode == zim::OpenMode::EAGER ? "eager " : "lazy  ")
+                << (cold ? "cold   " : "warm   ")
+                << std::fixed << std::setprecision(3)
+                << std::setw(9) << latency.open << "  "
+                << std::setw(17) << latency.firstLookup << std::endl;
+    }
+  }
+  return 0;
+}
@@ -22,8 +22,10 @@
 
 #include "zim.h"
 #include "entry.h"
+#include "item.h"
 #include "uuid.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
@@ -34,6 +36,8 @@ namespace zim
 {
   class FileImpl;
 
+  typedef std::bitset<size_t(IntegrityCheck::COUNT)> IntegrityCheckList;
+
   enum class EntryOrder {
     pathOrder,
     titleOrder,
@@ -67,6 +71,18 @@ namespace zim
        */
       explicit Archive(const std::string& fname);
 
+      /** Archive constructor.
+       *
+       *  Same as `Archive(fname)`, with the given open mode.
+       *  With `OpenMode::LAZY`, only the header of the archive is read (and
+       *  checked) here. The other parts of the archive are read on first use,
+       *  so an invalid archive may be reported later by any other method.
+       *
+       *  @param fname The filename to the file to open (utf8 encoded)
+       *  @param mode How the archive is opened.
+       */
+      Archive(const std::string& fname, OpenMode mode);
+
 #ifndef _WIN32
       /** Archive constructor.
        *
@@ -78,6 +94,17 @@ namespace zim
        */
       explicit Archive(int fd);
 
+      /** Archive constructor.
+       *
+       *  Same as `Archive(fd)`, with the given open mode.
+       *
+       *  Note: This function is not available under Windows.
+       *
+       *  @param fd The descriptor of a seekable file representing a ZIM archive
+       *  @param mode How the archive is opened.
+       */
+      Archive(int fd, OpenMode mode);
+
       /** Archive constructor.
        *
        *  Construct an archive from a descriptor of a file with an embedded ZIM
@@ -92,6 +119,14 @@ namespace zim
        *  @param size The size of the ZIM archive.
        */
       Archive(int fd, offset_type offset, size_type size);
+
+      /** Archive constructor.
+       *
+       *  Same as `Archive(fd, offset, size)`, with the given open mode.
+       *
+       *  Note: This function is not available under Windows.
+       */
+      Archive(int fd, offset_type offset, size_type size, OpenMode mode);
 #endif
 
       /** Return the filename of the zim file.
@@ -162,6 +197,46 @@ namespace zim
        */
       Entry getEntryByPath(const std::string& path) const;
 
+      /** Get several entries using their paths.
+       *
+       *  This is the same as calling `getEntryByPath` for each path, but
+       *  the paths are looked up together, in sorted order, which is
+       *  cheaper than independent lookups for big batches.
+       *
+       *  @param paths The entries' paths.
+       *  @return For each path (in the same order), a pair whose first
+       *          value tells if an entry has the path and the second one
+       *          is the index of the entry (to be used with
+       *          `getEntryByPath(entry_index_type)`).
+       */
+      std::vector<std::pair<bool, entry_index_type>> getEntriesByPath(const std::vector<std::string>& paths) const;
+
+      /** Prefetch the content of entries.
+       *
+       *  The clusters containing the items of the entries (redirections are
+       *  followed) are read in background threads, so that the items can
+       *  be read without waiting for the disk later on. This function
+       *  returns immediately, it is only a hint: the oldest requests are
+       *  dropped if too many of them are pending and errors are ignored.
+       *
+       *  The number of background threads is given by the
+       *  `ZIM_PREFETCHTHREADS` environment variable (2 by default).
+       *
+       *  @param indexes The indexes of the entries (in path order).
+       *  @param decompress If true, the clusters are also decompressed
+       *                    and put in the cluster cache. Else the operating
+       *                    system is only asked to read them.
+       */
+      void prefetch(const std::vector<entry_index_type>& indexes, bool decompress = true) const;
+
+      /** Prefetch the content of entries.
+       *
+       *  Same as `prefetch(indexes, decompress)`, with the entries given
+       *  by their paths (as accepted by `getEntryByPath`). The paths are
+       *  also resolved in the background. Unknown paths are ignored.
+       */
+      void prefetch(const std::vector<std::string>& paths, bool decompress = true) const;
+
       /** Get an entry using its "title" index.
        *
        *  Use the index of the entry to get the idx'th entry
@@ -303,6 +378,25 @@ namespace zim
        */
       EntryRange<EntryOrder::efficientOrder> iterEfficient() const;
 
+      /** Visit all the items of the archive with several threads.
+       *
+       *  The clusters of the archive are shared between `nbThreads`
+       *  threads. Each cluster is decompressed once (the cluster cache is
+       *  not used) by one thread, which calls `visitor` for every item
+       *  stored in the cluster. Redirections are not visited.
+       *
+       *  This is the fastest way to read the content of a whole archive.
+       *
+       *  `visitor` is called concurrently from different threads and in
+       *  no particular order. If it throws, the visit is stopped and the
+       *  (first) exception is rethrown by `forEachItem`.
+       *
+       *  @param visitor The function called with each item and its data.
+       *  @param nbThreads The number of threads to use (0 means the number
+       *                   of cores of the machine).
+       */
+      void forEachItem(std::function<void(const Item& item, const Blob& data)> visitor, unsigned nbThreads = 0) const;
+
       /** Find a range of entry starting with path.
        *
        * The path is the "long path". (Ie, with the namespace)
@@ -349,6 +443,16 @@ namespace zim
        */
       bool check() const;
 
+      /** Check that the zim file is valid (in regard to its checksum).
+       *
+       *  Same as `check()`, calling `progress` as the archive is read
+       *  with the number of bytes already checked and the total number
+       *  of bytes to check.
+       *
+       *  @return True if the file is valid.
+       */
+      bool check(std::function<void(size_type checked, size_type total)> progress) const;
+
       /** Check the integrity of the zim file.
        *
        * Run different type of checks to verify the zim file is valid
@@ -359,6 +463,78 @@ namespace zim
        */
       bool checkIntegrity(IntegrityCheck checkType);
 
+      /** Check the integrity of the zim file.
+       *
+       * Same as `checkIntegrity(checkType)`, the work being shared between
+       * `nbThreads` threads (0 to use one thread per core).
+       *
+       * @return True if the file is valid.
+       */
+      bool checkIntegrity(IntegrityCheck checkType, unsigned nbThreads);
+
+      /** Run several integrity checks of the zim file.
+       *
+       * The checks are run serially by default. The work may be shared
+       * between `nbThreads` threads instead (0 to use one thread per core).
+       * The dirents are decoded once for all the checks on the dirents.
+       *
+       * Only the first failure is reported on the error output: the first
+       * one found by the first failing check (in the order of
+       * `IntegrityCheck`), whatever the number of threads.
+       *
+       * @return True if the file is valid.
+       */
+      bool checkIntegrity(IntegrityCheckList checks, unsigned nbThreads = 1);
+
+      /** Run all the integrity checks of the zim file.
+       *
+       * Same as `checkIntegrity()` with all the checks of
+       * `IntegrityCheckList` (`IntegrityCheck::CLUSTER_DATA` is not run).
+       *
+       * @return True if the file is valid.
+       */
+      bool checkAll(unsigned nbThreads = 1);
+
+      /** Get the maximum size of the cluster cache.
+       *
+       *  The cluster cache keeps the decompressed clusters of the archive.
+       *  Its default size is given by the `ZIM_CLUSTERCACHE_BYTES`
+       *  environment variable (or the `CLUSTER_CACHE_BYTES` build option).
+       *  The deprecated `ZIM_CLUSTERCACHE` variable and `CLUSTER_CACHE_SIZE`
+       *  build option, giving a number of clusters, are still used if set
+       *  (counting 4MB per cluster).
+       *
+       *  @return The maximum size of the cache, in bytes.
+       */
+      size_type getClusterCacheMaxSize() const;
+
+      /** Get the current size of the cluster cache.
+       *
+       *  @return The memory used by the clusters in the cache, in bytes.
+       */
+      size_type getClusterCacheCurrentSize() const;
+
+      /** Set the maximum size of the cluster cache.
+       *
+       *  Clusters are evicted from the cache if it doesn't fit in the new
+       *  size anymore.
+       *
+       *  @param nbBytes The maximum size of the cache, in bytes.
+       */
+      void setClusterCacheMaxSize(size_type nbBytes);
+
+      /** Load all the dirents of the archive in memory.
+       *
+       *  The dirents are decoded once into compact arrays, entries are then
+       *  found and read without accessing the file. This is worth it for
+       *  archives which are heavily used (a server), at the cost of an
+       *  initial scan and of some memory (about the size of the dirents
+       *  in the file).
+       *
+       *  Calling this function more than once has no effect.
+       */
+      void preloadDirents();
+
       /** Check if the file is split in the filesystem.
        *
        *  @return True if the archive is split in different file (foo.zimaa, foo.zimbb).
@@ -395,6 +571,9 @@ namespace zim
 #endif
 
     private:
+      friend class ArchiveRegistry;
+      explicit Archive(std::shared_ptr<FileImpl> impl);
+
       std::shared_ptr<FileImpl> m_impl;
   };
 
@@ -497,8 +676,73 @@ private:
       mutable std::unique_ptr<Entry> m_entry;
   };
 
-  typedef std::bitset<size_t(IntegrityCheck::COUNT)> IntegrityCheckList;
   bool validate(const std::string& zimPath, IntegrityCheckList checksToRun);
+
+  /** Set how the regions of a kind are mapped in memory.
+   *
+   *  The policy applies to the regions mapped from then on, by all the
+   *  archives. The defaults are `RANDOM` for the pointer tables (read by
+   *  binary searches), `POPULATE` for the clusters (fully decompressed)
+   *  and `LAZY` for the blobs (which may be partially read).
+   *  Nothing is mapped in memory on Windows.
+   *
+   *  @param region The kind of regions.
+   *  @param policy How they are mapped.
+   */
+  void setMmapPolicy(MemoryRegion region, MmapPolicy policy);
+
+  /** Get how the regions of a kind are mapped in memory.
+   *
+   *  @param region The kind of regions.
+   *  @return The policy of the kind.
+   */
+  MmapPolicy getMmapPolicy(MemoryRegion region);
+
+  /**
+   * The registry of the archives of the process.
+   *
+   * The archives opened by the registry are shared: opening an archive
+   * already opened by the registry (with the same path, or a copy of it with
+   * the same UUID) gives an archive sharing its internal state (caches,
+   * lookup grids, file descriptors) with the already opened one.
+   * The registry doesn't keep the archives open: an archive is closed when
+   * its last `Archive` object is destroyed.
+   *
+   * The registry also limits the number of files kept open by all the
+   * archives of the process (opened by the registry or not). Above this
+   * limit, the files which have not been used recently are closed, and
+   * reopened (by their path) on their next use.
+   */
+  class ArchiveRegistry
+  {
+    public:
+      /** Open an archive, or get the already opened one.
+       *
+       *  With `OpenMode::EAGER`, an archive already opened lazily is fully
+       *  read (and checked) before being returned.
+       *
+       *  @param fname The filename to the file to open (utf8 encoded)
+       *  @param mode How the archive is opened.
+       */
+      static Archive open(const std::string& fname, OpenMode mode = OpenMode::EAGER);
+
+      /** Set the maximum number of files kept open by the archives.
+       *
+       *  0 means no limit. The default is the value of the
+       *  `ZIM_MAXOPENFILES` environment variable (or no limit).
+       *  A file being read is not closed, so the limit may be exceeded by
+       *  concurrent reads.
+       *
+       *  @param count The maximum number of open files.
+       */
+      static void setMaxOpenFiles(unsigned count);
+
+      /** Get the maximum number of files kept open by the archives. */
+      static unsigned getMaxOpenFiles();
+
+      /** Get the number of files kept open by the archives. */
+      static unsigned getOpenFileCount();
+  };
 }
 
 #endif // ZIM_ARCHIVE_H
@@ -64,6 +64,9 @@ namespace zim
          * This method will be called several times (at least twice) for
          * each content to add.
          *
+         * Each blob is written (or compressed) on its own. Returning a few big
+         * blobs (hundreds of KiB) rather than many small ones is faster.
+         *
          * It is up to the implementation to manage correctly the data pointed by
          * the returned blob.
          * It may (re)use the same buffer between calls (rewriting its content),
@@ -68,6 +68,10 @@ namespace zim
         /**
          * Configure the compression algorithm to use.
          *
+         * `zimcompZstdSeekable` compresses groups of blobs in independent zstd
+         * frames. Reading one blob then only needs to decompress its frame
+         * (at the cost of a slightly worse compression ratio).
+         *
          * @param comptype the compression algorithm to use.
          * @return a reference to itself.
          */
@@ -101,6 +105,44 @@ namespace zim
          */
         Creator& configNbWorkers(unsigned nbWorkers);
 
+        /**
+         * Set the maximum number of pending tasks and clusters.
+         *
+         * Adding content blocks while the workers are that much behind.
+         *
+         * @param queueSize The size of the queues of the workers (at least 1).
+         * @return a reference to itself.
+         */
+        Creator& configQueueSize(unsigned queueSize);
+
+        /**
+         * Configure the creation of a path hash index.
+         *
+         * The index is stored in the archive and lets the readers find an
+         * entry by its path with a single probe instead of a binary search.
+         * It takes about 7 bytes per entry.
+         *
+         * @param withIndex True if the path hash index must be created.
+         * @return a reference to itself.
+         */
+        Creator& configPathHashIndex(bool withIndex);
+
+        /**
+         * Configure the order in which the clusters are written.
+         *
+         * By default, the clusters are written in the order they are
+         * created, each one once compressed: a cluster slow to compress
+         * delays the writing of the next ones. If `completionOrder` is true,
+         * the clusters are written as soon as they are compressed instead.
+         * This is faster with several workers, but two archives created
+         * from the same content are then not byte-identical.
+         *
+         * @param completionOrder True to write the clusters in the order
+         *                        they are compressed.
+         * @return a reference to itself.
+         */
+        Creator& configClusterCompletionOrder(bool completionOrder);
+
         /**
          * Start the zim creation.
          *
@@ -186,6 +228,9 @@ namespace zim
         size_t m_minClusterSize = 1024-64;
         std::string m_indexingLanguage;
         unsigned m_nbWorkers = 4;
+        unsigned m_queueSize = 10;
+        bool m_withPathHashIndex = false;
+        bool m_clusterCompletionOrder = false;
 
         // zim data
         std::string m_mainPath;
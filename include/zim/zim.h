@@ -58,11 +58,39 @@ namespace zim
     zimcompZip, // Not supported anymore in the libzim
     zimcompBzip2, // Not supported anymore in the libzim
     zimcompLzma,
-    zimcompZstd
+    zimcompZstd,
+    zimcompZstdSeekable // Zstd, one independent frame per group of blobs
   };
 
   static const char MimeHtmlTemplate[] = "text/x-zim-htmltemplate";
 
+  enum class OpenMode
+  {
+    EAGER, // The sections of the archive are read (and checked) when it is opened
+    LAZY // Only the header is read when opening, each section is read on first use
+  };
+
+  // The kinds of regions of an archive which are mapped in memory.
+  enum class MemoryRegion
+  {
+    POINTER_TABLES, // The lists of pointers to the dirents, the titles and the clusters
+    CLUSTERS, // The compressed data of the clusters
+    BLOBS, // The blobs of the uncompressed clusters
+
+    // This must be the last one and denotes the count of all kinds
+    COUNT
+  };
+
+  // How a region is mapped in memory.
+  enum class MmapPolicy
+  {
+    POPULATE, // The whole region is read when it is mapped
+    LAZY, // The pages are read on first access (with the system read ahead)
+    RANDOM, // The pages are read on first access, without read ahead
+    WILLNEED, // The region is read ahead in the background
+    HUGEPAGE // As LAZY, with transparent huge pages if the system supports them
+  };
+
   enum class IntegrityCheck
   {
     CHECKSUM,
@@ -74,7 +102,13 @@ namespace zim
     DIRENT_MIMETYPES, // Checks that mime-type values in dirents are valid
 
     // This must be the last one and denotes the count of all checks
-    COUNT
+    COUNT,
+
+    // Checks that clusters can be read and decompressed. This reads and
+    // decompresses the whole archive, so it is not part of the checks
+    // counted by COUNT (nor of IntegrityCheckList): it is only run when
+    // asked for by itself.
+    CLUSTER_DATA
   };
 }
 
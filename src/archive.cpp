@@ -34,14 +34,30 @@ namespace zim
     : m_impl(new FileImpl(fname))
     { }
 
+  Archive::Archive(const std::string& fname, OpenMode mode)
+    : m_impl(new FileImpl(fname, mode))
+    { }
+
+  Archive::Archive(std::shared_ptr<FileImpl> impl)
+    : m_impl(std::move(impl))
+    { }
+
 #ifndef _WIN32
   Archive::Archive(int fd)
     : m_impl(new FileImpl(fd))
     { }
 
+  Archive::Archive(int fd, OpenMode mode)
+    : m_impl(new FileImpl(fd, mode))
+    { }
+
   Archive::Archive(int fd, offset_type offset, size_type size)
     : m_impl(new FileImpl(fd, offset_t(offset), zsize_t(size)))
     { }
+
+  Archive::Archive(int fd, offset_type offset, size_type size, OpenMode mode)
+    : m_impl(new FileImpl(fd, offset_t(offset), zsize_t(size), mode))
+    { }
 #endif
 
   const std::string& Archive::getFilename() const
@@ -128,6 +144,115 @@ namespace zim
     throw EntryNotFound("Cannot find entry");
   }
 
+  namespace
+  {
+    typedef std::vector<std::pair<bool, entry_index_type>> PathLookupResults;
+
+    // Looks up the paths not found yet, using the key given by `makeKey`
+    // (which returns false if there is no key to look up for a path).
+    template<typename MakeKey>
+    void findMissingPaths(FileImpl& impl, const std::vector<std::string>& paths, PathLookupResults& results, MakeKey makeKey)
+    {
+      std::vector<size_t> indexes;
+      std::vector<FileImpl::FindxKey> keys;
+      for (size_t i = 0; i < paths.size(); ++i) {
+        FileImpl::FindxKey key;
+        if (!results[i].first && makeKey(paths[i], key)) {
+          indexes.push_back(i);
+          keys.push_back(std::move(key));
+        }
+      }
+      if (keys.empty()) {
+        return;
+      }
+      const auto found = impl.findx(keys);
+      for (size_t k = 0; k < keys.size(); ++k) {
+        if (found[k].first) {
+          results[indexes[k]] = {true, entry_index_type(found[k].second)};
+        }
+      }
+    }
+
+    bool parseLongPathKey(const std::string& path, FileImpl::FindxKey& key)
+    {
+      try {
+        std::tie(key.first, key.second) = parseLongPath(path);
+        return true;
+      } catch (std::runtime_error&) {
+        return false;
+      }
+    }
+
+    // Same lookups as Archive::getEntryByPath, each step is done for all the
+    // paths not found by the previous ones.
+    PathLookupResults findEntriesByPath(FileImpl& impl, const std::vector<std::string>& paths)
+    {
+      PathLookupResults results(paths.size(), {false, 0});
+      if (impl.hasNewNamespaceScheme()) {
+        findMissingPaths(impl, paths, results, [](const std::string& path, FileImpl::FindxKey& key) {
+          key = {'C', path};
+          return true;
+        });
+        findMissingPaths(impl, paths, results, [](const std::string& path, FileImpl::FindxKey& key) {
+          if (!parseLongPathKey(path, key)) {
+            return false;
+          }
+          key.first = 'C';
+          return true;
+        });
+      } else {
+        findMissingPaths(impl, paths, results, parseLongPathKey);
+        for (auto ns:{'A', 'I', 'J', '-'}) {
+          findMissingPaths(impl, paths, results, [ns](const std::string& path, FileImpl::FindxKey& key) {
+            key = {ns, path};
+            return true;
+          });
+        }
+      }
+      return results;
+    }
+  }
+
+  std::vector<std::pair<bool, entry_index_type>> Archive::getEntriesByPath(const std::vector<std::string>& paths) const
+  {
+    return findEntriesByPath(*m_impl, paths);
+  }
+
+  void Archive::prefetch(const std::vector<entry_index_type>& indexes, bool decompress) const
+  {
+    // The tasks are run (or dropped) before the FileImpl is destroyed.
+    FileImpl* impl = m_impl.get();
+    m_impl->addPrefetchTask([impl, indexes, decompress]() {
+      std::vector<entry_index_t> entries;
+      for (auto idx: indexes) {
+        entries.push_back(entry_index_t(idx));
+      }
+      impl->prefetchEntries(entries, decompress);
+    });
+  }
+
+  void Archive::prefetch(const std::vector<std::string>& paths, bool decompress) const
+  {
+    FileImpl* impl = m_impl.get();
+    m_impl->addPrefetchTask([impl, paths, decompress]() {
+      std::vector<entry_index_t> entries;
+      for (const auto& result: findEntriesByPath(*impl, paths)) {
+        if (result.first) {
+          entries.push_back(entry_index_t(result.second));
+        }
+      }
+      impl->prefetchEntries(entries, decompress);
+    });
+  }
+
+  void Archive::forEachItem(std::function<void(const Item& item, const Blob& data)> visitor, unsigned nbThreads) const
+  {
+    const auto impl = m_impl;
+    m_impl->forEachItem([&visitor, &impl](entry_index_t idx, const Blob& data) {
+      visitor(Item(impl, idx.v), data);
+    }, nbThreads);
+  }
+
   Entry Archive::getEntryByTitle(entry_index_type idx) const
   {
     return Entry(m_impl, entry_index_type(m_impl->getIndexByTitle(title_index_t(idx))));
@@ -337,6 +462,31 @@ namespace zim
     return m_impl->verify();
   }
 
+  bool Archive::check(std::function<void(size_type checked, size_type total)> progress) const
+  {
+    return m_impl->verify(progress);
+  }
+
+  size_type Archive::getClusterCacheMaxSize() const
+  {
+    return m_impl->getClusterCacheMaxSize();
+  }
+
+  size_type Archive::getClusterCacheCurrentSize() const
+  {
+    return m_impl->getClusterCacheCurrentSize();
+  }
+
+  void Archive::setClusterCacheMaxSize(size_type nbBytes)
+  {
+    m_impl->setClusterCacheMaxSize(nbBytes);
+  }
+
+  void Archive::preloadDirents()
+  {
+    m_impl->preloadDirents();
+  }
+
   bool Archive::is_multiPart() const
   {
     return m_impl->is_multiPart();
@@ -388,16 +538,34 @@ namespace zim
     return m_impl->checkIntegrity(checkType);
   }
 
+  bool Archive::checkIntegrity(IntegrityCheck checkType, unsigned nbThreads)
+  {
+    return m_impl->checkIntegrity(checkType, nbThreads);
+  }
+
+  bool Archive::checkIntegrity(IntegrityCheckList checks, unsigned nbThreads)
+  {
+    FileImpl::IntegrityChecks implChecks;
+    for (size_t i = 0; i < checks.size(); ++i) {
+      implChecks.set(i, checks.test(i));
+    }
+    return m_impl->checkIntegrity(implChecks, nbThreads);
+  }
+
+  bool Archive::checkAll(unsigned nbThreads)
+  {
+    IntegrityCheckList checks;
+    checks.set();
+    return checkIntegrity(checks, nbThreads);
+  }
+
   bool validate(const std::string& zimPath, IntegrityCheckList checksToRun)
   {
     try
     {
       Archive a(zimPath);
-      for ( size_t i = 0; i < checksToRun.size(); ++i )
-      {
-        if ( checksToRun.test(i) && !a.checkIntegrity(IntegrityCheck(i)) )
-          return false;
-      }
+      if ( !a.checkIntegrity(checksToRun, 1) )
+        return false;
     }
     catch(ZimFileFormatError &exception)
     {
@@ -0,0 +1,179 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <zim/archive.h>
+#include "fileimpl.h"
+#include "file_part.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
+namespace zim
+{
+
+namespace
+{
+
+std::string canonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+  char buf[_MAX_PATH];
+  if (_fullpath(buf, path.c_str(), _MAX_PATH)) {
+    return buf;
+  }
+#else
+  if (char* const p = realpath(path.c_str(), nullptr)) {
+    const std::string result(p);
+    free(p);
+    return result;
+  }
+#endif
+  // A split archive (foo.zim being foo.zimaa, foo.zimab...) is known by
+  // the given path, and its UUID.
+  return path;
+}
+
+// A null UUID doesn't identify an archive.
+std::string uuidKey(const FileImpl& impl)
+{
+  const auto& uuid = impl.getFileheader().getUuid();
+  if (std::all_of(uuid.data, uuid.data + uuid.size(), [](char c) { return c == 0; })) {
+    return std::string();
+  }
+  return std::string(uuid.data, uuid.size());
+}
+
+class Registry
+{
+  public: // types
+    typedef std::shared_ptr<FileImpl> ImplPtr;
+
+  public: // functions
+    static Registry& instance()
+    {
+      static Registry registry;
+      return registry;
+    }
+
+    ImplPtr find(const std::string& path)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return find(m_byPath, path);
+    }
+
+    // Registers a newly opened archive, or returns the same archive if it
+    // has been registered meanwhile.
+    ImplPtr add(const std::string& path, ImplPtr impl)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto uuid = uuidKey(*impl);
+      auto shared = find(m_byPath, path);
+      if (!shared && !uuid.empty()) {
+        shared = find(m_byUuid, uuid);
+        if (shared && shared->getFilesize() != impl->getFilesize()) {
+          // Not a copy of the same archive.
+          shared.reset();
+        }
+      }
+      if (shared) {
+        impl = shared;
+      } else if (!uuid.empty()) {
+        m_byUuid[uuid] = impl;
+      }
+      m_byPath[path] = impl;
+      purge();
+      return impl;
+    }
+
+  private: // types
+    typedef std::map<std::string, std::weak_ptr<FileImpl>> Map;
+
+  private: // functions
+    static ImplPtr find(Map& map, const std::string& key)
+    {
+      const auto it = map.find(key);
+      if (it == map.end()) {
+        return nullptr;
+      }
+      auto impl = it->second.lock();
+      if (!impl) {
+        map.erase(it);
+      }
+      return impl;
+    }
+
+    // Removes the closed archives, each time the registry has doubled.
+    void purge()
+    {
+      const auto size = m_byPath.size() + m_byUuid.size();
+      if (size < 2 * m_sizeAfterPurge) {
+        return;
+      }
+      for (auto map: {&m_byPath, &m_byUuid}) {
+        for (auto it = map->begin(); it != map->end(); ) {
+          it = it->second.expired() ? map->erase(it) : std::next(it);
+        }
+      }
+      m_sizeAfterPurge = std::max<size_t>(16, m_byPath.size() + m_byUuid.size());
+    }
+
+  private: // data
+    std::mutex m_mutex;
+    Map m_byPath;
+    Map m_byUuid;
+    size_t m_sizeAfterPurge = 16;
+};
+
+} // unnamed namespace
+
+Archive ArchiveRegistry::open(const std::string& fname, OpenMode mode)
+{
+  auto& registry = Registry::instance();
+  const auto path = canonicalPath(fname);
+  auto impl = registry.find(path);
+  if (!impl) {
+    // Opened without the lock, so that archives can be opened concurrently.
+    impl = registry.add(path, std::make_shared<FileImpl>(fname, mode));
+  }
+  if (mode == OpenMode::EAGER) {
+    impl->load();
+  }
+  return Archive(impl);
+}
+
+void ArchiveRegistry::setMaxOpenFiles(unsigned count)
+{
+  FilePart::setMaxOpenFiles(count);
+}
+
+unsigned ArchiveRegistry::getMaxOpenFiles()
+{
+  return FilePart::getMaxOpenFiles();
+}
+
+unsigned ArchiveRegistry::getOpenFileCount()
+{
+  return FilePart::getOpenFileCount();
+}
+
+} // namespace zim
@@ -0,0 +1,98 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "buffer_pool.h"
+#include "envvalue.h"
+
+namespace zim {
+
+namespace
+{
+
+// Smaller buffers are allocated as usual.
+const size_t MIN_POOLED_SIZE = 64*1024;
+const size_t MAX_FREE_SIZE = 64*1024*1024;
+
+// The capacity of the block of a buffer of `size` bytes. The capacities
+// are the multiples of a quarter of a power of two, so that a block can
+// be reused for buffers of close sizes, wasting at most a quarter of it.
+size_t blockCapacity(size_t size)
+{
+  size_t step = MIN_POOLED_SIZE / 4;
+  while (step * 8 < size) {
+    step *= 2;
+  }
+  return (size + step - 1) / step * step;
+}
+
+} // unnamed namespace
+
+BufferPool& BufferPool::instance()
+{
+  static BufferPool* const pool = new BufferPool(envMemSize("ZIM_BUFFERPOOL_BYTES", MAX_FREE_SIZE));
+  return *pool;
+}
+
+BufferPool::BufferPool(size_t maxFreeSize)
+  : m_freeSize(0),
+    m_maxFreeSize(maxFreeSize)
+{}
+
+Buffer BufferPool::makeBuffer(zsize_t size)
+{
+  if (size.v < MIN_POOLED_SIZE) {
+    return Buffer::makeBuffer(size);
+  }
+
+  const size_t capacity = blockCapacity(size.v);
+  char* data = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_freeBlocks.find(capacity);
+    if (it != m_freeBlocks.end() && !it->second.empty()) {
+      data = it->second.back();
+      it->second.pop_back();
+      m_freeSize -= capacity;
+    }
+  }
+  if (!data) {
+    data = new char[capacity];
+  }
+  const auto deleter = [this, capacity](char* p) { release(p, capacity); };
+  return Buffer::makeBuffer(Buffer::DataPtr(data, deleter), size);
+}
+
+size_t BufferPool::getFreeSize()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_freeSize;
+}
+
+void BufferPool::release(char* data, size_t capacity)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeSize + capacity <= m_maxFreeSize) {
+      m_freeBlocks[capacity].push_back(data);
+      m_freeSize += capacity;
+      return;
+    }
+  }
+  delete[] data;
+}
+
+} // zim
@@ -0,0 +1,59 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_BUFFER_POOL_H_
+#define ZIM_BUFFER_POOL_H_
+
+#include "buffer.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace zim {
+
+// A pool of the memory of the large buffers (the decoded clusters).
+// Allocating and freeing a large buffer usually maps and unmaps memory,
+// each page of it being faulted in again on first write. The memory of the
+// destroyed buffers is kept (up to a limit) to be reused by the next ones.
+class BufferPool {
+  public: // functions
+    // Never destroyed: buffers may be destroyed by static destructors.
+    static BufferPool& instance();
+
+    // A buffer of `size` bytes. Its memory goes back to the pool when the
+    // buffer (and all the buffers sharing its data) are destroyed.
+    Buffer makeBuffer(zsize_t size);
+
+    // The memory kept by the pool for the next buffers.
+    size_t getFreeSize();
+
+  private: // functions
+    explicit BufferPool(size_t maxFreeSize);
+    void release(char* data, size_t capacity);
+
+  private: // data
+    std::mutex m_mutex;
+    // The free memory blocks, by capacity.
+    std::map<size_t, std::vector<char*>> m_freeBlocks;
+    size_t m_freeSize;
+    const size_t m_maxFreeSize;
+};
+
+} // zim
+
+#endif // ZIM_BUFFER_POOL_H_
@@ -0,0 +1,246 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_CLOCKCACHE_H
+#define ZIM_CLOCKCACHE_H
+
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <cassert>
+
+namespace zim {
+
+/**
+   clock_cache is a bounded cache with the same interface as lru_cache.
+
+   Lookup is done through a hash table and the eviction uses the CLOCK
+   algorithm (an approximation of LRU): each slot has a "referenced" flag
+   set on access, and the clock hand evicts the first slot without the flag,
+   clearing the flags on its way. A hit only sets a flag, it doesn't have to
+   reorder a list.
+
+   Each entry has a cost (1 by default, so that the bound is a number of
+   entries) which can be changed with setCost(). Entries are evicted as long
+   as the total cost exceeds the maximum cost of the cache.
+ */
+template<typename key_t, typename value_t>
+class clock_cache {
+public: // types
+  enum AccessStatus {
+    HIT, // key was found in the cache
+    PUT, // key was not in the cache but was created by the getOrPut() access
+    MISS // key was not in the cache; get() access failed
+  };
+
+  class AccessResult
+  {
+    const AccessStatus status_;
+    const value_t val_;
+  public:
+    AccessResult(const value_t& val, AccessStatus status)
+      : status_(status), val_(val)
+    {}
+    AccessResult() : status_(MISS), val_() {}
+
+    bool hit() const { return status_ == HIT; }
+    bool miss() const { return !hit(); }
+    const value_t& value() const
+    {
+      if ( status_ == MISS )
+        throw std::range_error("There is no such key in cache");
+      return val_;
+    }
+
+    operator const value_t& () const { return value(); }
+  };
+
+public: // functions
+  explicit clock_cache(size_t max_cost) :
+    _hand(0),
+    _cost(0),
+    _max_cost(max_cost) {
+  }
+
+  // If 'key' is present in the cache, returns the associated value,
+  // otherwise puts the given value into the cache (and returns it with
+  // a status of a cache miss).
+  AccessResult getOrPut(const key_t& key, const value_t& value) {
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      Slot& slot = _slots[it->second];
+      slot.referenced = true;
+      return AccessResult(slot.value, HIT);
+    } else {
+      putMissing(key, value);
+      return AccessResult(value, PUT);
+    }
+  }
+
+  void put(const key_t& key, const value_t& value) {
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      Slot& slot = _slots[it->second];
+      slot.referenced = true;
+      slot.value = value;
+    } else {
+      putMissing(key, value);
+    }
+  }
+
+  AccessResult get(const key_t& key) {
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return AccessResult();
+    } else {
+      Slot& slot = _slots[it->second];
+      slot.referenced = true;
+      return AccessResult(slot.value, HIT);
+    }
+  }
+
+  // Removes 'key' from the cache. Returns false if it was not there.
+  bool drop(const key_t& key) {
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return false;
+    }
+    freeSlot(it->second);
+    return true;
+  }
+
+  // Changes the cost of 'key' (if it is in the cache) and evicts entries
+  // (possibly 'key' itself) until the total cost fits in the cache.
+  void setCost(const key_t& key, size_t cost) {
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      Slot& slot = _slots[it->second];
+      _cost = _cost - slot.cost + cost;
+      slot.cost = cost;
+      slot.referenced = true;
+      evictUntil(_max_cost);
+    }
+  }
+
+  void setMaxCost(size_t max_cost) {
+    _max_cost = max_cost;
+    evictUntil(_max_cost);
+  }
+
+  // Evicts the entry chosen by the clock hand, whatever the maximum cost,
+  // and gives its cost. Returns false if the cache is empty.
+  bool evictOne(size_t& evicted_cost) {
+    if (_index.empty()) {
+      return false;
+    }
+    while (true) {
+      const size_t pos = _hand;
+      if (++_hand == _slots.size()) {
+        _hand = 0;
+      }
+      Slot& slot = _slots[pos];
+      if (slot.used && !slot.referenced) {
+        evicted_cost = slot.cost;
+        freeSlot(pos);
+        return true;
+      }
+      slot.referenced = false;
+    }
+  }
+
+  bool exists(const key_t& key) const {
+    return _index.find(key) != _index.end();
+  }
+
+  size_t size() const {
+    return _index.size();
+  }
+
+  size_t cost() const {
+    return _cost;
+  }
+
+  size_t maxCost() const {
+    return _max_cost;
+  }
+
+private: // types
+  struct Slot {
+    Slot(const key_t& k, const value_t& v) : key(k), value(v), cost(1), referenced(false), used(true) {}
+    key_t key;
+    value_t value;
+    size_t cost;
+    bool referenced;
+    bool used;
+  };
+
+private: // functions
+  void putMissing(const key_t& key, const value_t& value) {
+    assert(_index.find(key) == _index.end());
+    if (_max_cost == 0) {
+      return;
+    }
+    evictUntil(_max_cost - 1);
+    size_t pos = _slots.size();
+    if (_freeSlots.empty()) {
+      _slots.push_back(Slot(key, value));
+    } else {
+      pos = _freeSlots.back();
+      _freeSlots.pop_back();
+      _slots[pos] = Slot(key, value);
+    }
+    _index[key] = pos;
+    _cost += 1;
+  }
+
+  void evictUntil(size_t max_cost) {
+    while (_cost > max_cost) {
+      Slot& slot = _slots[_hand];
+      if (slot.used && !slot.referenced) {
+        freeSlot(_hand);
+      } else {
+        slot.referenced = false;
+      }
+      if (++_hand == _slots.size()) {
+        _hand = 0;
+      }
+    }
+  }
+
+  void freeSlot(size_t pos) {
+    Slot& slot = _slots[pos];
+    _index.erase(slot.key);
+    _cost -= slot.cost;
+    // Release the value now, the slot is only reused by a later put.
+    slot.value = value_t();
+    slot.used = false;
+    _freeSlots.push_back(pos);
+  }
+
+private: // data
+  std::vector<Slot> _slots;
+  std::vector<size_t> _freeSlots;
+  std::unordered_map<key_t, size_t> _index;
+  size_t _hand;
+  size_t _cost;
+  size_t _max_cost;
+};
+
+} // namespace zim
+
+#endif // ZIM_CLOCKCACHE_H
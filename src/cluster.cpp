@@ -21,6 +21,7 @@
 #include <zim/blob.h>
 #include <zim/error.h>
 #include "buffer_reader.h"
+#include "buffer_pool.h"
 #include "endian_tools.h"
 #include "bufferstreamer.h"
 #include "decoderstreamreader.h"
@@ -44,21 +45,73 @@ namespace zim
 namespace
 {
 
+// Above this size, a cluster is read from the archive as it is decoded,
+// and a zstd frame is decoded as a stream rather than at once.
+const size_type MAX_ONE_SHOT_DECODE_SIZE = 32*1024*1024;
+
+template<typename INFO>
+std::unique_ptr<IStreamReader>
+getDecoderReader(const Buffer& compressedData)
+{
+  return std::unique_ptr<IStreamReader>(new DecoderStreamReader<INFO>(compressedData));
+}
+
+// If the zstd frame header gives the size of the content, decode the whole
+// cluster at once in a buffer of the right size.
+template<>
+std::unique_ptr<IStreamReader>
+getDecoderReader<ZSTD_INFO>(const Buffer& compressedData)
+{
+  const auto contentSize = ZSTD_INFO::get_frame_content_size(compressedData.data(), compressedData.size().v);
+  if (contentSize == 0 || contentSize > MAX_ONE_SHOT_DECODE_SIZE) {
+    return std::unique_ptr<IStreamReader>(new DecoderStreamReader<ZSTD_INFO>(compressedData));
+  }
+
+  auto content = BufferPool::instance().makeBuffer(zsize_t(contentSize));
+  if (!ZSTD_INFO::decode_frame(const_cast<char*>(content.data()), contentSize,
+                               compressedData.data(), compressedData.size().v)) {
+    throw ZimFileFormatError("Invalid zstd stream for cluster.");
+  }
+  return std::unique_ptr<IStreamReader>(
+    new RawStreamReader(std::make_shared<BufferReader>(content)));
+}
+
 std::unique_ptr<IStreamReader>
-getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp, bool* extended)
+getClusterReader(const Reader& zimReader, offset_t offset, zsize_t maxSize, CompressionType* comp, bool* extended)
 {
   uint8_t clusterInfo = zimReader.read(offset);
   *comp = static_cast<CompressionType>(clusterInfo & 0x0F);
   *extended = clusterInfo & 0x10;
   auto subReader = std::shared_ptr<const Reader>(zimReader.sub_reader(offset+offset_t(1)));
 
+  // Load the whole compressed data at once (a single mmap or read) rather
+  // than feeding the decoder with small chunks. A bigger cluster is
+  // streamed, not to hold all its compressed data in memory.
+  Buffer compressedData = Buffer::makeBuffer(zsize_t(0));
+  const bool inMemory = maxSize.v > 1
+                     && maxSize.v - 1 <= MAX_ONE_SHOT_DECODE_SIZE
+                     && (*comp == zimcompLzma || *comp == zimcompZstd);
+  if (inMemory) {
+    const auto size = std::min(zsize_t(maxSize.v - 1), subReader->size());
+    compressedData = subReader->get_buffer(offset_t(0), size, MemoryRegion::CLUSTERS);
+  }
+
   switch (*comp) {
     case zimcompDefault:
     case zimcompNone:
+    // The header of a seekable cluster is not compressed.
+    // Its frames are decoded independently by the cluster itself.
+    case zimcompZstdSeekable:
       return std::unique_ptr<IStreamReader>(new RawStreamReader(subReader));
     case zimcompLzma:
+      if (inMemory) {
+        return getDecoderReader<LZMA_INFO>(compressedData);
+      }
       return std::unique_ptr<IStreamReader>(new DecoderStreamReader<LZMA_INFO>(subReader));
     case zimcompZstd:
+      if (inMemory) {
+        return getDecoderReader<ZSTD_INFO>(compressedData);
+      }
       return std::unique_ptr<IStreamReader>(new DecoderStreamReader<ZSTD_INFO>(subReader));
     case zimcompZip:
       throw std::runtime_error("zlib not enabled in this library");
@@ -71,24 +124,46 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
 
 } // unnamed namespace
 
-  std::shared_ptr<Cluster> Cluster::read(const Reader& zimReader, offset_t clusterOffset)
+  std::shared_ptr<Cluster> Cluster::read(const Reader& zimReader, offset_t clusterOffset, zsize_t maxClusterSize, zsize_t maxDecodeSize)
   {
     CompressionType comp;
     bool extended;
-    auto reader = getClusterReader(zimReader, clusterOffset, &comp, &extended);
-    return std::make_shared<Cluster>(std::move(reader), comp, extended);
+    auto reader = getClusterReader(zimReader, clusterOffset, maxClusterSize, &comp, &extended);
+    // getClusterReader() has read the cluster info byte at clusterOffset.
+    zsize_t dataSize(zimReader.size().v - clusterOffset.v - 1);
+    if (maxClusterSize.v > 1) {
+      dataSize = std::min(dataSize, zsize_t(maxClusterSize.v - 1));
+    }
+    return std::make_shared<Cluster>(std::move(reader), comp, extended, dataSize, maxDecodeSize);
   }
 
-  Cluster::Cluster(std::unique_ptr<IStreamReader> reader_, CompressionType comp, bool isExtended)
+  Cluster::Cluster(std::unique_ptr<IStreamReader> reader_, CompressionType comp, bool isExtended, zsize_t dataSize, zsize_t maxDecodeSize)
     : compression(comp),
       isExtended(isExtended),
-      m_reader(std::move(reader_))
+      m_reader(std::move(reader_)),
+      m_content(Buffer::makeBuffer(zsize_t(0))),
+      m_isDecoded(false)
   {
-    if (isExtended) {
+    if (isSeekable()) {
+      if (isExtended) {
+        read_seekable_header<uint64_t>(dataSize);
+      } else {
+        read_seekable_header<uint32_t>(dataSize);
+      }
+    } else if (isExtended) {
       read_header<uint64_t>();
     } else {
       read_header<uint32_t>();
     }
+
+    if (isCompressed() && !isSeekable()) {
+      const zsize_t contentSize((m_blobOffsets.back() - m_blobOffsets.front()).v);
+      if (contentSize <= maxDecodeSize) {
+        m_content = m_reader->sub_reader(contentSize)->get_buffer(offset_t(0), contentSize);
+        m_isDecoded = true;
+        m_reader.reset();
+      }
+    }
   }
 
   /* This return the number of char read */
@@ -120,6 +195,69 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
     }
   }
 
+  /* A seekable cluster starts with an uncompressed header:
+   *  - the blob count (N) and the frame count (F)
+   *  - N+1 blob offsets, relative to the start of the uncompressed content
+   *  - F+1 indexes of the first blob of each frame (the last one is N)
+   *  - F+1 frame offsets, relative to the end of the header
+   * followed by the F zstd frames.
+   */
+  template<typename OFFSET_TYPE>
+  void Cluster::read_seekable_header(zsize_t dataSize)
+  {
+    const OFFSET_TYPE blobCount = m_reader->read<OFFSET_TYPE>();
+    const OFFSET_TYPE frameCount = m_reader->read<OFFSET_TYPE>();
+
+    // The counts come from the file: check that the tables fit in the
+    // cluster before looping on them or allocating them.
+    const uint64_t maxEntries = dataSize.v / sizeof(OFFSET_TYPE);
+    if (blobCount >= maxEntries || frameCount >= maxEntries
+     || 2 + (uint64_t(blobCount) + 1) + 2 * (uint64_t(frameCount) + 1) > maxEntries) {
+      throw ZimFileFormatError("Invalid seekable cluster header");
+    }
+
+    const auto bufferSize = zsize_t(sizeof(OFFSET_TYPE) * (blobCount + 1 + 2 * (frameCount + 1)));
+    auto buffer = m_reader->sub_reader(bufferSize)->get_buffer(offset_t(0), bufferSize);
+    auto seqReader = BufferStreamer(buffer, bufferSize);
+
+    m_blobOffsets.clear();
+    m_blobOffsets.reserve(blobCount + 1);
+    for (OFFSET_TYPE i = 0; i <= blobCount; ++i) {
+      const offset_t offset(seqReader.read<OFFSET_TYPE>());
+      if (!m_blobOffsets.empty() && offset < m_blobOffsets.back()) {
+        throw ZimFileFormatError("Invalid blob offsets in seekable cluster");
+      }
+      m_blobOffsets.push_back(offset);
+    }
+
+    m_frameFirstBlobs.clear();
+    m_frameFirstBlobs.reserve(frameCount + 1);
+    for (OFFSET_TYPE i = 0; i <= frameCount; ++i) {
+      const auto firstBlob = blob_index_type(seqReader.read<OFFSET_TYPE>());
+      if (m_frameFirstBlobs.empty() ? firstBlob != 0 : firstBlob <= m_frameFirstBlobs.back()) {
+        throw ZimFileFormatError("Invalid frame table in seekable cluster");
+      }
+      m_frameFirstBlobs.push_back(firstBlob);
+    }
+    if (m_frameFirstBlobs.back() != blobCount) {
+      throw ZimFileFormatError("Invalid frame table in seekable cluster");
+    }
+
+    m_frameOffsets.clear();
+    m_frameOffsets.reserve(frameCount + 1);
+    for (OFFSET_TYPE i = 0; i <= frameCount; ++i) {
+      const offset_t offset(seqReader.read<OFFSET_TYPE>());
+      if (!m_frameOffsets.empty() && offset < m_frameOffsets.back()) {
+        throw ZimFileFormatError("Invalid frame offsets in seekable cluster");
+      }
+      m_frameOffsets.push_back(offset);
+    }
+
+    m_framesReader = m_reader->sub_reader(zsize_t(m_frameOffsets.back().v));
+    m_frameReaders.resize(frameCount);
+    m_blobReaders.resize(blobCount);
+  }
+
   zsize_t Cluster::getBlobSize(blob_index_t n) const
   {
       if (blob_index_type(n)+1 >= m_blobOffsets.size()) {
@@ -131,6 +269,9 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
   const Reader& Cluster::getReader(blob_index_t n) const
   {
     std::lock_guard<std::mutex> lock(m_readerAccessMutex);
+    if (isSeekable()) {
+      return getSeekableReader(n);
+    }
     for(blob_index_type current(m_blobReaders.size()); current<=n.v; ++current) {
       auto blobSize = getBlobSize(blob_index_t(current));
       if (blobSize.v > SIZE_MAX) {
@@ -139,9 +280,66 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
         m_blobReaders.push_back(m_reader->sub_reader(blobSize));
       }
     }
+    if (m_blobReaders.size() == count().v) {
+      m_reader.reset();
+    }
     return *m_blobReaders[blob_index_type(n)];
   }
 
+  // Must be called with m_readerAccessMutex locked
+  const Reader& Cluster::getSeekableReader(blob_index_t n) const
+  {
+    auto& blobReader = m_blobReaders[blob_index_type(n)];
+    if (!blobReader) {
+      const auto frameIt = std::upper_bound(m_frameFirstBlobs.begin(), m_frameFirstBlobs.end(), n.v) - 1;
+      const auto& frameReader = getFrameReader(frameIt - m_frameFirstBlobs.begin());
+      const auto frameStart = m_blobOffsets[*frameIt];
+      blobReader = frameReader.sub_reader(m_blobOffsets[blob_index_type(n)] - frameStart, getBlobSize(n));
+    }
+    return *blobReader;
+  }
+
+  // Must be called with m_readerAccessMutex locked
+  const Reader& Cluster::getFrameReader(size_t frameIndex) const
+  {
+    auto& frameReader = m_frameReaders[frameIndex];
+    if (!frameReader) {
+      const auto frameBegin = m_frameOffsets[frameIndex];
+      const auto frameEnd = m_frameOffsets[frameIndex+1];
+      const auto frameSize = zsize_t((m_blobOffsets[m_frameFirstBlobs[frameIndex+1]] - m_blobOffsets[m_frameFirstBlobs[frameIndex]]).v);
+      if (frameSize.v == 0) {
+        frameReader.reset(new BufferReader(Buffer::makeBuffer(zsize_t(0))));
+      } else {
+        // The size of the frame content is known, decode it at once.
+        const auto compressedData = m_framesReader->get_buffer(frameBegin, zsize_t((frameEnd - frameBegin).v), MemoryRegion::CLUSTERS);
+        auto content = BufferPool::instance().makeBuffer(frameSize);
+        if (!ZSTD_INFO::decode_frame(const_cast<char*>(content.data()), frameSize.v,
+                                     compressedData.data(), compressedData.size().v)) {
+          throw ZimFileFormatError("Invalid zstd frame in seekable cluster");
+        }
+        frameReader.reset(new BufferReader(content));
+      }
+    }
+    return *frameReader;
+  }
+
+  size_t Cluster::getMemorySize() const
+  {
+    const size_t blobReaderSize = sizeof(std::unique_ptr<const Reader>) + sizeof(BufferReader);
+    size_t size = sizeof(Cluster)
+                + m_blobOffsets.size() * sizeof(offset_t)
+                + count().v * blobReaderSize;
+    if (isSeekable()) {
+      size += m_frameFirstBlobs.size() * sizeof(blob_index_type)
+            + m_frameOffsets.size() * sizeof(offset_t)
+            + m_frameReaders.size() * blobReaderSize;
+    }
+    if (isCompressed()) {
+      size += m_blobOffsets.back().v;
+    }
+    return size;
+  }
+
   Blob Cluster::getBlob(blob_index_t n) const
   {
     if (n < count()) {
@@ -149,7 +347,11 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
       if (blobSize.v > SIZE_MAX) {
         return Blob();
       }
-      return getReader(n).get_buffer(offset_t(0), blobSize);
+      if (isDecoded()) {
+        const auto blobOffset = m_blobOffsets[blob_index_type(n)] - m_blobOffsets.front();
+        return m_content.sub_buffer(blobOffset, blobSize);
+      }
+      return getReader(n).get_buffer(offset_t(0), blobSize, MemoryRegion::BLOBS);
     } else {
       return Blob();
     }
@@ -166,7 +368,11 @@ getClusterReader(const Reader& zimReader, offset_t offset, CompressionType* comp
       if (size.v > SIZE_MAX) {
         return Blob();
       }
-      return getReader(n).get_buffer(offset, size);
+      if (isDecoded()) {
+        const auto blobOffset = m_blobOffsets[blob_index_type(n)] - m_blobOffsets.front();
+        return m_content.sub_buffer(blobOffset + offset, size);
+      }
+      return getReader(n).get_buffer(offset, size, MemoryRegion::BLOBS);
     } else {
       return Blob();
     }
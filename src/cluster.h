@@ -41,13 +41,17 @@ namespace zim
   class Cluster : public std::enable_shared_from_this<Cluster> {
       typedef std::vector<offset_t> BlobOffsets;
       typedef std::vector<std::unique_ptr<const Reader>> BlobReaders;
+      typedef std::vector<blob_index_type> FrameFirstBlobs;
+      typedef std::vector<offset_t> FrameOffsets;
+      typedef std::vector<std::unique_ptr<const Reader>> FrameReaders;
 
     public:
       const CompressionType compression;
       const bool isExtended;
 
     private:
-      std::unique_ptr<IStreamReader> m_reader;
+      // Released once the content is fully read, to give back its decoder.
+      mutable std::unique_ptr<IStreamReader> m_reader;
 
       // offsets of the blob boundaries relative to the start of the cluster data
       // (*after* the first byte (clusterInfo))
@@ -58,15 +62,39 @@ namespace zim
       mutable std::mutex m_readerAccessMutex;
       mutable BlobReaders m_blobReaders;
 
+      // The content of a compressed cluster (but a seekable one), decoded
+      // at once when asked for (see read()). The blobs are views of it. As it
+      // is not modified once the cluster is constructed, they are got
+      // without lock.
+      Buffer m_content;
+      bool m_isDecoded;
+
+      // Only used by seekable clusters (zimcompZstdSeekable).
+      // Blobs are grouped in independently compressed frames. For F frames,
+      // m_frameFirstBlobs and m_frameOffsets contain F+1 entries (the last
+      // ones being the blob count and the end of the last frame).
+      FrameFirstBlobs m_frameFirstBlobs;
+      FrameOffsets m_frameOffsets;
+      std::unique_ptr<const Reader> m_framesReader;
+      mutable FrameReaders m_frameReaders;
+
 
       template<typename OFFSET_TYPE>
       void read_header();
+      template<typename OFFSET_TYPE>
+      void read_seekable_header(zsize_t dataSize);
+      bool isDecoded() const { return m_isDecoded; }
       const Reader& getReader(blob_index_t n) const;
+      const Reader& getSeekableReader(blob_index_t n) const;
+      const Reader& getFrameReader(size_t frameIndex) const;
 
     public:
-      Cluster(std::unique_ptr<IStreamReader> reader, CompressionType comp, bool isExtended);
+      // `dataSize` is an upper bound of the size of the cluster data (after
+      // the cluster info byte), used to check the header of the cluster.
+      Cluster(std::unique_ptr<IStreamReader> reader, CompressionType comp, bool isExtended, zsize_t dataSize, zsize_t maxDecodeSize = zsize_t(0));
       CompressionType getCompression() const   { return compression; }
       bool isCompressed() const                { return compression != zimcompDefault && compression != zimcompNone; }
+      bool isSeekable() const                  { return compression == zimcompZstdSeekable; }
 
       blob_index_t count() const               { return blob_index_t(m_blobOffsets.size() - 1); }
 
@@ -76,7 +104,18 @@ namespace zim
       Blob getBlob(blob_index_t n) const;
       Blob getBlob(blob_index_t n, offset_t offset, zsize_t size) const;
 
-      static std::shared_ptr<Cluster> read(const Reader& zimReader, offset_t clusterOffset);
+      // Memory (in bytes) used by the cluster once all its blobs are read.
+      // The decompressed data of a compressed cluster is held by the cluster,
+      // while the blobs of an uncompressed cluster are read from the archive.
+      size_t getMemorySize() const;
+
+      // `maxClusterSize` is an upper bound of the size of the cluster in
+      // `zimReader`, or 0 if it is unknown. When it is known, the compressed
+      // data is loaded with a single read and decoded from memory.
+      // A compressed cluster (but a seekable one) whose content is not
+      // larger than `maxDecodeSize` is decoded at once, the others (all of
+      // them by default) are decoded on demand.
+      static std::shared_ptr<Cluster> read(const Reader& zimReader, offset_t clusterOffset, zsize_t maxClusterSize = zsize_t(0), zsize_t maxDecodeSize = zsize_t(0));
   };
 
 }
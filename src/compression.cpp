@@ -2,15 +2,85 @@
 
 #include "envvalue.h"
 
+#include <mutex>
 #include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// The decoder contexts kept for the next streams to decode.
+const size_t MAX_POOLED_DECODERS = 8;
+
+// The contexts of the decoders not in use. Initializing a decoder from a
+// context of the pool resets it rather than allocating a new one.
+template<typename CONTEXT>
+class DecoderPool
+{
+  public:
+    typedef void (*FreeFunction)(CONTEXT*);
+
+    explicit DecoderPool(FreeFunction freeContext)
+      : m_freeContext(freeContext)
+    {}
+
+    // Takes a context of the pool, returns false if there is none.
+    bool take(CONTEXT* context)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_contexts.empty()) {
+        return false;
+      }
+      *context = m_contexts.back();
+      m_contexts.pop_back();
+      return true;
+    }
+
+    // Gives back a context, which is freed if the pool is full.
+    void give(CONTEXT context)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_contexts.size() < MAX_POOLED_DECODERS) {
+          m_contexts.push_back(context);
+          return;
+        }
+      }
+      m_freeContext(&context);
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::vector<CONTEXT> m_contexts;
+    const FreeFunction m_freeContext;
+};
+
+// Never destroyed: decoders may be ended by static destructors.
+DecoderPool<lzma_stream>& lzmaDecoders()
+{
+  static auto* const pool = new DecoderPool<lzma_stream>([](lzma_stream* stream) { lzma_end(stream); });
+  return *pool;
+}
+
+DecoderPool<::ZSTD_DStream*>& zstdDecoders()
+{
+  static auto* const pool = new DecoderPool<::ZSTD_DStream*>([](::ZSTD_DStream** stream) { ::ZSTD_freeDStream(*stream); });
+  return *pool;
+}
+
+} // unnamed namespace
 
 const std::string LZMA_INFO::name = "lzma";
 void LZMA_INFO::init_stream_decoder(stream_t* stream, char* raw_data)
 {
-  *stream = LZMA_STREAM_INIT;
+  // A stream already initialized is reinitialized, reusing its memory.
+  if (!lzmaDecoders().take(stream)) {
+    *stream = LZMA_STREAM_INIT;
+  }
   unsigned memsize = zim::envMemSize("ZIM_LZMA_MEMORY_SIZE", LZMA_MEMORY_SIZE * 1024 * 1024);
   auto errcode = lzma_stream_decoder(stream, memsize, 0);
   if (errcode != LZMA_OK) {
+    lzma_end(stream);
     throw std::runtime_error("Impossible to allocated needed memory to uncompress lzma stream");
   }
 }
@@ -24,6 +94,11 @@ void LZMA_INFO::init_stream_encoder(stream_t* stream, char* raw_data)
   }
 }
 
+void LZMA_INFO::set_content_size(stream_t* /*stream*/, zim::size_type /*size*/)
+{
+  // The xz format has no field for the content size in its stream header.
+}
+
 CompStatus LZMA_INFO::stream_run_encode(stream_t* stream, CompStep step) {
   return stream_run(stream, step);
 }
@@ -46,7 +121,8 @@ CompStatus LZMA_INFO::stream_run(stream_t* stream, CompStep step)
 
 void LZMA_INFO::stream_end_decode(stream_t* stream)
 {
-  lzma_end(stream);
+  lzmaDecoders().give(*stream);
+  *stream = LZMA_STREAM_INIT;
 }
 
 void LZMA_INFO::stream_end_encode(stream_t* stream)
@@ -78,7 +154,9 @@ ZSTD_INFO::stream_t::~stream_t()
 
 void ZSTD_INFO::init_stream_decoder(stream_t* stream, char* raw_data)
 {
-  stream->decoder_stream = ::ZSTD_createDStream();
+  if (!zstdDecoders().take(&stream->decoder_stream)) {
+    stream->decoder_stream = ::ZSTD_createDStream();
+  }
   auto ret = ::ZSTD_initDStream(stream->decoder_stream);
   if (::ZSTD_isError(ret)) {
     throw std::runtime_error("Failed to initialize Zstd decompression");
@@ -94,6 +172,14 @@ void ZSTD_INFO::init_stream_encoder(stream_t* stream, char* raw_data)
   }
 }
 
+void ZSTD_INFO::set_content_size(stream_t* stream, zim::size_type size)
+{
+  auto ret = ::ZSTD_CCtx_setPledgedSrcSize(stream->encoder_stream, size);
+  if (::ZSTD_isError(ret)) {
+    throw std::runtime_error("Failed to set the content size of Zstd compression");
+  }
+}
+
 CompStatus ZSTD_INFO::stream_run_encode(stream_t* stream, CompStep step) {
   ::ZSTD_inBuffer inBuf;
   inBuf.src = stream->next_in;
@@ -159,8 +245,37 @@ CompStatus ZSTD_INFO::stream_run_decode(stream_t* stream, CompStep /*step*/) {
 
 void ZSTD_INFO::stream_end_decode(stream_t* stream)
 {
+  if (stream->decoder_stream) {
+    zstdDecoders().give(stream->decoder_stream);
+    stream->decoder_stream = nullptr;
+  }
 }
 
 void ZSTD_INFO::stream_end_encode(stream_t* stream)
 {
 }
+
+zim::size_type ZSTD_INFO::get_frame_content_size(const char* data, zim::size_type size)
+{
+  const auto contentSize = ::ZSTD_getFrameContentSize(data, size);
+  if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR) {
+    return 0;
+  }
+  return contentSize;
+}
+
+bool ZSTD_INFO::decode_frame(char* dest, zim::size_type destSize, const char* data, zim::size_type size)
+{
+  // The input may be followed by other data, only decode the first frame.
+  const auto frameSize = ::ZSTD_findFrameCompressedSize(data, size);
+  if (::ZSTD_isError(frameSize)) {
+    return false;
+  }
+  ::ZSTD_DStream* context;
+  if (!zstdDecoders().take(&context)) {
+    context = ::ZSTD_createDStream();
+  }
+  const auto ret = ::ZSTD_decompressDCtx(context, dest, destSize, data, frameSize);
+  zstdDecoders().give(context);
+  return !::ZSTD_isError(ret) && ret == destSize;
+}
@@ -40,6 +40,7 @@ struct LZMA_INFO {
   static const std::string name;
   static void init_stream_decoder(stream_t* stream, char* raw_data);
   static void init_stream_encoder(stream_t* stream, char* raw_data);
+  static void set_content_size(stream_t* stream, zim::size_type size);
   static CompStatus stream_run_encode(stream_t* stream, CompStep step);
   static CompStatus stream_run_decode(stream_t* stream, CompStep step);
   static CompStatus stream_run(stream_t* stream, CompStep step);
@@ -70,10 +71,17 @@ struct ZSTD_INFO {
   static const std::string name;
   static void init_stream_decoder(stream_t* stream, char* raw_data);
   static void init_stream_encoder(stream_t* stream, char* raw_data);
+  static void set_content_size(stream_t* stream, zim::size_type size);
   static CompStatus stream_run_encode(stream_t* stream, CompStep step);
   static CompStatus stream_run_decode(stream_t* stream, CompStep step);
   static void stream_end_encode(stream_t* stream);
   static void stream_end_decode(stream_t* stream);
+
+  // One-shot decoding of a frame fully loaded in memory.
+  // `get_frame_content_size` returns 0 if the frame header doesn't give
+  // the size of the content.
+  static zim::size_type get_frame_content_size(const char* data, zim::size_type size);
+  static bool decode_frame(char* dest, zim::size_type destSize, const char* data, zim::size_type size);
 };
 
 
@@ -212,6 +220,12 @@ class Compressor
       stream.avail_out = ret_size;
     }
 
+    // Must be called just after init(), if the size of the data to compress
+    // is known. Some encoders record it in the compressed stream.
+    void set_content_size(zim::zsize_t size) {
+      INFO::set_content_size(&stream, size.v);
+    }
+
     RunnerStatus feed(const char* data, size_t size, CompStep step=CompStep::STEP) {
       stream.next_in = (unsigned char*)data;
       stream.avail_in = size;
@@ -20,14 +20,27 @@
 #ifndef ZIM_CONCURRENT_CACHE_H
 #define ZIM_CONCURRENT_CACHE_H
 
-#include "lrucache.h"
+#include "clockcache.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <future>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace zim
 {
 
+// Default cost of a cache entry: the size of the cache is a number of entries.
+struct UnitCostEstimation
+{
+  template<typename Value>
+  static size_t cost(const Value& ) { return 1; }
+};
+
 /**
    ConcurrentCache implements a concurrent thread-safe cache
 
@@ -36,45 +49,173 @@ namespace zim
    with minimal blocking. Concurrent access to the same element is also
    safe, and, in case of a cache miss, will block until that element becomes
    available.
+
+   The cache is split in shards, each one with its own lock. A key always
+   goes to the same shard (selected by the hash of the key), so that
+   accesses to different shards never contend.
+
+   The capacity is a maximum total cost of the cached values, the cost of
+   a value being given by CostEstimation::cost(value). It is shared by all
+   the shards: the total cost is kept in an atomic counter and, when it
+   goes over the capacity, the shards evict their own entries in turn
+   (each one with its CLOCK hand) until it fits again. A single value may
+   take the whole capacity.
  */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename CostEstimation = UnitCostEstimation>
 class ConcurrentCache
 {
 private: // types
   typedef std::shared_future<Value> ValuePlaceholder;
-  typedef lru_cache<Key, ValuePlaceholder> Impl;
+  typedef clock_cache<Key, ValuePlaceholder> Impl;
+
+  // The shards don't evict on their own (their capacity is unbounded),
+  // the eviction is driven by the total cost of the cache.
+  struct Shard
+  {
+    Shard() : impl_(std::numeric_limits<size_t>::max()) {}
+
+    Impl impl_;
+    std::mutex lock_;
+  };
+
+  enum { DEFAULT_SHARD_COUNT = 16 };
 
 public: // types
-  explicit ConcurrentCache(size_t maxEntries)
-    : impl_(maxEntries)
-  {}
+  explicit ConcurrentCache(size_t maxCost, size_t shardCount = DEFAULT_SHARD_COUNT)
+    : cost_(0),
+      maxCost_(maxCost),
+      nextEvictingShard_(0)
+  {
+    shardCount = std::max<size_t>(shardCount, 1);
+    shards_.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; ++i) {
+      shards_.emplace_back(new Shard());
+    }
+  }
 
   // Gets the entry corresponding to the given key. If the entry is not in the
   // cache, it is obtained by calling f() (without any arguments) and the
   // result is put into the cache.
   //
-  // The cache as a whole is locked only for the duration of accessing
-  // the respective slot. If, in the case of the a cache miss, the generation
-  // of the missing element takes a long time, only attempts to access that
-  // element will block - the rest of the cache remains open to concurrent
-  // access.
+  // Only the shard of the key is locked, and only for the duration of
+  // accessing the respective slot. If, in the case of the a cache miss, the
+  // generation of the missing element takes a long time, only attempts to
+  // access that element will block - the rest of the cache remains open to
+  // concurrent access.
+  //
+  // If f() throws, the exception is propagated to all the threads waiting
+  // for that element and the element is not kept in the cache.
   template<class F>
   Value getOrPut(const Key& key, F f)
   {
+    Shard& shard = getShard(key);
     std::promise<Value> valuePromise;
-    std::unique_lock<std::mutex> l(lock_);
-    const auto x = impl_.getOrPut(key, valuePromise.get_future().share());
+    std::unique_lock<std::mutex> l(shard.lock_);
+    auto shardCost = shard.impl_.cost();
+    const auto x = shard.impl_.getOrPut(key, valuePromise.get_future().share());
+    addCost(shardCost, shard.impl_.cost());
     l.unlock();
     if ( x.miss() ) {
-      valuePromise.set_value(f());
+      try {
+        const Value value = f();
+        valuePromise.set_value(value);
+        // The cost of the value is only known now.
+        const auto cost = CostEstimation::cost(value);
+        l.lock();
+        shardCost = shard.impl_.cost();
+        shard.impl_.setCost(key, cost);
+        addCost(shardCost, shard.impl_.cost());
+        l.unlock();
+        evictOverCapacity();
+      } catch (...) {
+        l.lock();
+        shardCost = shard.impl_.cost();
+        shard.impl_.drop(key);
+        addCost(shardCost, shard.impl_.cost());
+        l.unlock();
+        valuePromise.set_exception(std::current_exception());
+      }
     }
 
     return x.value().get();
   }
 
+  bool exists(const Key& key) const
+  {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> l(shard.lock_);
+    return shard.impl_.exists(key);
+  }
+
+  size_t size() const
+  {
+    size_t result = 0;
+    for (const auto& shard: shards_) {
+      std::lock_guard<std::mutex> l(shard->lock_);
+      result += shard->impl_.size();
+    }
+    return result;
+  }
+
+  size_t cost() const
+  {
+    return cost_.load();
+  }
+
+  size_t maxCost() const
+  {
+    return maxCost_.load();
+  }
+
+  // Entries are evicted if needed to fit in the new capacity.
+  void setMaxCost(size_t maxCost)
+  {
+    maxCost_ = maxCost;
+    evictOverCapacity();
+  }
+
+  size_t shardCount() const { return shards_.size(); }
+
+private: // functions
+  // Accounts for the change of the cost of a shard (from `before` to
+  // `after`), done under the lock of the shard.
+  void addCost(size_t before, size_t after)
+  {
+    if (after >= before) {
+      cost_ += after - before;
+    } else {
+      cost_ -= before - after;
+    }
+  }
+
+  // The shards evict one entry each in turn, until the total cost fits in
+  // the capacity. Only one shard is locked at a time.
+  void evictOverCapacity()
+  {
+    size_t emptyShards = 0;
+    while (cost_.load() > maxCost_.load() && emptyShards < shards_.size()) {
+      Shard& shard = *shards_[nextEvictingShard_++ % shards_.size()];
+      std::lock_guard<std::mutex> l(shard.lock_);
+      size_t evictedCost;
+      if (shard.impl_.evictOne(evictedCost)) {
+        cost_ -= evictedCost;
+        emptyShards = 0;
+      } else {
+        ++emptyShards;
+      }
+    }
+  }
+
+  Shard& getShard(const Key& key) const
+  {
+    return *shards_[std::hash<Key>()(key) % shards_.size()];
+  }
+
 private: // data
-  Impl impl_;
-  std::mutex lock_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<size_t> cost_;
+  std::atomic<size_t> maxCost_;
+  std::atomic<size_t> nextEvictingShard_;
 };
 
 } // namespace zim
@@ -43,6 +43,19 @@ public: // functions
     readNextChunk();
   }
 
+  // Decode encoded data already loaded in memory, avoiding the chunked
+  // reads from an input reader.
+  explicit DecoderStreamReader(const Buffer& encodedData)
+    : m_currentInputOffset(0),
+      m_inputBytesLeft(0),
+      m_encodedDataChunk(encodedData)
+  {
+    Decoder::init_stream_decoder(&m_decoderState, nullptr);
+    // XXX: ugly C-style cast (casting away constness) on the next line
+    m_decoderState.next_in  = (unsigned char*)m_encodedDataChunk.data();
+    m_decoderState.avail_in = m_encodedDataChunk.size().v;
+  }
+
   ~DecoderStreamReader()
   {
     Decoder::stream_end_decode(&m_decoderState);
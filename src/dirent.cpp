@@ -22,11 +22,13 @@
 #include <zim/zim.h>
 #include <zim/error.h>
 #include "buffer.h"
+#include "buffer_reader.h"
 #include "bufferstreamer.h"
 #include "endian_tools.h"
 #include "log.h"
 #include <algorithm>
 #include <cstring>
+#include <vector>
 
 log_define("zim.dirent")
 
@@ -113,7 +115,66 @@ namespace zim
     return true;
   }
 
-  std::shared_ptr<const Dirent> DirentReader::readDirent(offset_t offset)
+  bool DirentReader::initTitleKey(std::string& key, const Buffer& direntData) const
+  {
+    BufferStreamer reader(direntData);
+    uint16_t mimeType = reader.read<uint16_t>();
+    uint8_t extraLen = reader.read<uint8_t>();
+    char ns = reader.read<char>();
+    reader.skip(zsize_t(sizeof(uint32_t))); // version
+
+    if (mimeType == Dirent::redirectMimeType) {
+      reader.skip(zsize_t(sizeof(entry_index_type)));
+    } else if (mimeType != Dirent::linktargetMimeType
+            && mimeType != Dirent::deletedMimeType) {
+      reader.skip(zsize_t(2 * sizeof(uint32_t)));
+    }
+
+    const char* const url = reader.current();
+    size_type url_size = strnlen(url, reader.left().v - extraLen);
+    if (url_size >= reader.left().v) {
+      return false;
+    }
+    reader.skip(zsize_t(url_size+1));
+
+    size_type title_size = strnlen(reader.current(), reader.left().v - extraLen);
+    if (title_size >= reader.left().v) {
+      return false;
+    }
+
+    // An empty title means that the title is the url.
+    key.assign(1, ns);
+    if (title_size == 0) {
+      key.append(url, url_size);
+    } else {
+      key.append(reader.current(), title_size);
+    }
+    return true;
+  }
+
+  DirentReader::DirentReader(std::shared_ptr<const Reader> zimReader)
+    : mp_zimReader(zimReader),
+      m_inMemory(dynamic_cast<const BufferReader*>(zimReader.get()) != nullptr)
+  {}
+
+  Buffer DirentReader::getDirentData(offset_t offset, zsize_t size) const
+  {
+    if (m_inMemory) {
+      return mp_zimReader->get_buffer(offset, size);
+    }
+
+    // The buffer is only used while the dirent is parsed, a scratch buffer
+    // per thread avoids an allocation for each dirent.
+    static thread_local std::vector<char> scratchBuffer;
+    if (scratchBuffer.size() < size.v) {
+      scratchBuffer.resize(size.v);
+    }
+    mp_zimReader->read(scratchBuffer.data(), offset, size);
+    return Buffer::makeBuffer(scratchBuffer.data(), size);
+  }
+
+  template<typename Init>
+  void DirentReader::readWithInit(offset_t offset, Init init) const
   {
     const auto totalSize = mp_zimReader->size();
     if (offset.v >= totalSize.v) {
@@ -129,17 +190,30 @@ namespace zim
     // == 16) without extra parameters. Let's hope that url + title size will
     // be < 256 and if not try again with a bigger size.
 
-    size_t bufferSize(std::min(size_type(256), mp_zimReader->size().v-offset.v));
-    auto dirent = std::make_shared<Dirent>();
-    std::lock_guard<std::mutex> lock(m_bufferMutex);
-    for ( ; ; bufferSize += 256 ) {
-      m_buffer.reserve(bufferSize);
-      mp_zimReader->read(m_buffer.data(), offset, zsize_t(bufferSize));
-      if ( initDirent(*dirent, Buffer::makeBuffer(m_buffer.data(), zsize_t(bufferSize))) )
-        return dirent;
+    const size_type maxSize = totalSize.v - offset.v;
+    size_type bufferSize(std::min(size_type(256), maxSize));
+    while ( !init(getDirentData(offset, zsize_t(bufferSize))) ) {
+      if ( bufferSize == maxSize ) {
+        throw ZimFileFormatError("Invalid dirent");
+      }
+      bufferSize = std::min(2 * bufferSize, maxSize);
     }
   }
 
+  std::shared_ptr<const Dirent> DirentReader::readDirent(offset_t offset) const
+  {
+    auto dirent = std::make_shared<Dirent>();
+    readWithInit(offset, [&](const Buffer& data) { return initDirent(*dirent, data); });
+    return dirent;
+  }
+
+  std::string DirentReader::readTitleKey(offset_t offset) const
+  {
+    std::string key;
+    readWithInit(offset, [&](const Buffer& data) { return initTitleKey(key, data); });
+    return key;
+  }
+
   std::string Dirent::getLongUrl() const
   {
     log_trace("Dirent::getLongUrl()");
@@ -20,10 +20,10 @@
 #include "dirent_accessor.h"
 
 #include "direntreader.h"
+#include "dirent_table.h"
 #include "_dirent.h"
 #include "envvalue.h"
 
-#include <mutex>
 
 #include <zim/error.h>
 
@@ -34,25 +34,20 @@ DirectDirentAccessor::DirectDirentAccessor(std::shared_ptr<DirentReader> direntR
     mp_urlPtrReader(std::move(urlPtrReader)),
     m_direntCount(direntCount),
     m_direntCache(envValue("ZIM_DIRENTCACHE", DIRENT_CACHE_SIZE)),
-    m_bufferDirentZone(256)
+    mp_preloadedTable(nullptr)
 {}
 
+DirectDirentAccessor::~DirectDirentAccessor() = default;
+
 std::shared_ptr<const Dirent> DirectDirentAccessor::getDirent(entry_index_t idx) const
 {
-  {
-    std::lock_guard<std::mutex> l(m_direntCacheLock);
-    auto v = m_direntCache.get(idx.v);
-    if (v.hit()) {
-      return v.value();
+  if (const auto table = getPreloadedTable()) {
+    if (idx >= m_direntCount) {
+      throw std::out_of_range("entry index out of range");
     }
+    return table->getDirent(idx);
   }
-
-  auto direntOffset = getOffset(idx);
-  auto dirent = readDirent(direntOffset);
-  std::lock_guard<std::mutex> l(m_direntCacheLock);
-  m_direntCache.put(idx.v, dirent);
-
-  return dirent;
+  return m_direntCache.getOrPut(idx.v, [=](){ return readDirent(getOffset(idx)); });
 }
 
 offset_t DirectDirentAccessor::getOffset(entry_index_t idx) const
@@ -69,6 +64,39 @@ std::shared_ptr<const Dirent> DirectDirentAccessor::readDirent(offset_t offset)
   return mp_direntReader->readDirent(offset);
 }
 
+std::string DirectDirentAccessor::getTitleKey(entry_index_t idx) const
+{
+  if (const auto table = getPreloadedTable()) {
+    if (idx >= m_direntCount) {
+      throw std::out_of_range("entry index out of range");
+    }
+    return table->getTitleKey(idx);
+  }
+  // Don't go through the dirent cache, the keys are read once.
+  return mp_direntReader->readTitleKey(getOffset(idx));
+}
+
+void DirectDirentAccessor::preload() const
+{
+  std::call_once(m_preloadOnce, [this](){
+    mp_direntTable.reset(new DirentTable(*this, *mp_direntReader));
+    mp_preloadedTable.store(mp_direntTable.get(), std::memory_order_release);
+    // The cached dirents will not be used anymore.
+    m_direntCache.setMaxCost(0);
+  });
+}
+
+int zim::compareWithDirentPath(const DirectDirentAccessor& accessor, entry_index_t idx, char ns, const std::string& url)
+{
+  if (const auto table = accessor.getPreloadedTable()) {
+    return table->compareWithPath(idx, ns, url);
+  }
+  const auto d = accessor.getDirent(idx);
+  return ns < d->getNamespace() ? -1
+       : ns > d->getNamespace() ? 1
+       : url.compare(d->getUrl());
+}
+
 
 IndirectDirentAccessor::IndirectDirentAccessor(std::shared_ptr<const DirectDirentAccessor> direntAccessor, std::unique_ptr<const Reader> indexReader, title_index_t direntCount)
   : mp_direntAccessor(direntAccessor),
@@ -90,3 +118,8 @@ std::shared_ptr<const Dirent> IndirectDirentAccessor::getDirent(title_index_t id
   auto directIndex = getDirectIndex(idx);
   return mp_direntAccessor->getDirent(directIndex);
 }
+
+std::string IndirectDirentAccessor::getTitleKey(title_index_t idx) const
+{
+  return mp_direntAccessor->getTitleKey(getDirectIndex(idx));
+}
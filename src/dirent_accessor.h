@@ -22,10 +22,12 @@
 
 #include "zim_types.h"
 #include "debug.h"
-#include "lrucache.h"
+#include "concurrent_cache.h"
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 namespace zim
@@ -34,6 +36,7 @@ namespace zim
 class Dirent;
 class Reader;
 class DirentReader;
+class DirentTable;
 
 /**
  * DirectDirentAccessor is used to access a dirent from its index.
@@ -47,11 +50,21 @@ class DirectDirentAccessor
 {
 public: // functions
   DirectDirentAccessor(std::shared_ptr<DirentReader> direntReader, std::unique_ptr<const Reader> urlPtrReader, entry_index_t direntCount);
+  ~DirectDirentAccessor();
 
   offset_t    getOffset(entry_index_t idx) const;
   std::shared_ptr<const Dirent> getDirent(entry_index_t idx) const;
   entry_index_t getDirentCount() const  {  return m_direntCount; }
 
+  // The key of the dirent `idx` in the title index (namespace followed by
+  // the title), read without creating a Dirent.
+  std::string getTitleKey(entry_index_t idx) const;
+
+  // Decodes all the dirents in memory (see DirentTable). Once done, dirents
+  // are read from the table and the dirent cache is not used anymore.
+  void preload() const;
+  const DirentTable* getPreloadedTable() const { return mp_preloadedTable.load(std::memory_order_acquire); }
+
 private: // functions
   std::shared_ptr<const Dirent> readDirent(offset_t) const;
 
@@ -60,13 +73,17 @@ private: // data
   std::unique_ptr<const Reader>  mp_urlPtrReader;
   entry_index_t                  m_direntCount;
 
-  mutable lru_cache<entry_index_type, std::shared_ptr<const Dirent>> m_direntCache;
-  mutable std::mutex m_direntCacheLock;
+  mutable ConcurrentCache<entry_index_type, std::shared_ptr<const Dirent>> m_direntCache;
 
-  mutable std::vector<char>  m_bufferDirentZone;
-  mutable std::mutex         m_bufferDirentLock;
+  mutable std::once_flag                        m_preloadOnce;
+  mutable std::unique_ptr<const DirentTable>    mp_direntTable;
+  mutable std::atomic<const DirentTable*>       mp_preloadedTable;
 };
 
+// Compares (ns, url) with the path of the dirent `idx`, without creating
+// a Dirent if the dirents are preloaded. Used by DirentLookup::find().
+int compareWithDirentPath(const DirectDirentAccessor& accessor, entry_index_t idx, char ns, const std::string& url);
+
 class IndirectDirentAccessor
 {
   public:
@@ -74,6 +91,7 @@ class IndirectDirentAccessor
 
     entry_index_t getDirectIndex(title_index_t idx) const;
     std::shared_ptr<const Dirent> getDirent(title_index_t idx) const;
+    std::string getTitleKey(title_index_t idx) const;
     title_index_t getDirentCount() const { return m_direntCount; }
 
   private: // data
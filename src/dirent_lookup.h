@@ -23,31 +23,47 @@
 #include "zim_types.h"
 #include "debug.h"
 #include "narrowdown.h"
+#include "path_hash_index.h"
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace zim
 {
 
+class Dirent;
+
 template<class Impl>
 class DirentLookup
 {
 public: // types
   typedef std::pair<bool, entry_index_t> Result;
+  typedef std::pair<char, std::string> Key;
 
 public: // functions
   DirentLookup(const Impl* _impl, entry_index_type cacheEntryCount);
+  // Uses a lookup grid built beforehand (stored in the archive).
+  DirentLookup(const Impl* _impl, NarrowDown&& grid);
 
   entry_index_t getNamespaceRangeBegin(char ns) const;
   entry_index_t getNamespaceRangeEnd(char ns) const;
 
   Result find(char ns, const std::string& url);
+  std::vector<Result> find(const std::vector<Key>& keys);
+
+  // Uses the path hash index of the archive to find the existing paths.
+  // Must be called before any concurrent lookup.
+  void setHashIndex(std::unique_ptr<const PathHashIndex> hashIndex)
+  { mp_hashIndex = std::move(hashIndex); }
 
 private: // functions
   std::string getDirentKey(entry_index_type i) const;
+  bool findWithHashIndex(char ns, const std::string& url, entry_index_t& idx) const;
 
 private: // types
   typedef std::map<char, entry_index_t> NamespaceBoundaryCache;
@@ -60,6 +76,7 @@ private: // data
 
   entry_index_type direntCount = 0;
   NarrowDown lookupGrid;
+  std::unique_ptr<const PathHashIndex> mp_hashIndex;
 };
 
 template<class Impl>
@@ -87,6 +104,34 @@ DirentLookup<Impl>::DirentLookup(const Impl* _impl, entry_index_type cacheEntryC
   }
 }
 
+template<class Impl>
+DirentLookup<Impl>::DirentLookup(const Impl* _impl, NarrowDown&& grid)
+  : impl(_impl),
+    direntCount(entry_index_type(_impl->getDirentCount())),
+    lookupGrid(std::move(grid))
+{
+  // Only the ends of the grid are checked against the dirents (2 reads),
+  // checking all the keys would cost as much as building the grid.
+  if (direntCount == 0
+   || lookupGrid.getFirstIndex() != 0
+   || lookupGrid.getLastIndex() != direntCount - 1
+   || lookupGrid.getFirstKey() != getDirentKey(0)
+   || lookupGrid.getLastKey() != getDirentKey(direntCount - 1)) {
+    throw ZimFileFormatError("The lookup grid doesn't match the dirents");
+  }
+}
+
+// Compares (ns, url) with the path of the dirent `idx`. Accessors which
+// can do it without creating a Dirent provide an overload of this function.
+template<typename IMPL>
+int compareWithDirentPath(const IMPL& impl, entry_index_t idx, char ns, const std::string& url)
+{
+  const auto d = impl.getDirent(idx);
+  return ns < d->getNamespace() ? -1
+       : ns > d->getNamespace() ? 1
+       : url.compare(d->getUrl());
+}
+
 template<typename IMPL>
 entry_index_t getNamespaceBeginOffset(IMPL& impl, char ch)
 {
@@ -148,10 +193,26 @@ DirentLookup<Impl>::getNamespaceRangeEnd(char ns) const
   return getNamespaceRangeBegin(ns+1);
 }
 
+// The hash index only knows the existing paths: a path which is not found
+// this way still needs the binary search to get its insertion position.
+template<typename Impl>
+bool
+DirentLookup<Impl>::findWithHashIndex(char ns, const std::string& url, entry_index_t& idx) const
+{
+  return mp_hashIndex
+      && mp_hashIndex->lookup(ns, url, idx)
+      && idx.v < direntCount
+      && compareWithDirentPath(*impl, idx, ns, url) == 0;
+}
+
 template<typename Impl>
 typename DirentLookup<Impl>::Result
 DirentLookup<Impl>::find(char ns, const std::string& url)
 {
+  entry_index_t idx(0);
+  if (findWithHashIndex(ns, url, idx))
+    return {true, idx};
+
   const auto r = lookupGrid.getRange(ns + url);
   entry_index_type l(r.begin);
   entry_index_type u(r.end);
@@ -162,11 +223,7 @@ DirentLookup<Impl>::find(char ns, const std::string& url)
   while (true)
   {
     entry_index_type p = l + (u - l) / 2;
-    const auto d = impl->getDirent(entry_index_t(p));
-
-    const int c = ns < d->getNamespace() ? -1
-                : ns > d->getNamespace() ? 1
-                : url.compare(d->getUrl());
+    const int c = compareWithDirentPath(*impl, entry_index_t(p), ns, url);
 
     if (c < 0)
       u = p;
@@ -181,6 +238,81 @@ DirentLookup<Impl>::find(char ns, const std::string& url)
   }
 }
 
+// Looks up several keys at once. The keys are searched in sorted order:
+// the position found for a key is a lower bound for the following ones,
+// and the dirents read in a range of the lookup grid are kept to be
+// compared with the next keys falling in the same range.
+// The keys found with the hash index are not searched.
+template<typename Impl>
+std::vector<typename DirentLookup<Impl>::Result>
+DirentLookup<Impl>::find(const std::vector<Key>& keys)
+{
+  std::vector<Result> results(keys.size());
+  std::vector<size_t> order;
+  order.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    entry_index_t idx(0);
+    if (findWithHashIndex(keys[i].first, keys[i].second, idx))
+      results[i] = {true, idx};
+    else
+      order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    return keys[a] < keys[b];
+  });
+
+  // The paths of the dirents probed in the current range of the grid (the
+  // next keys fall in the same range or in a following one).
+  std::unordered_map<entry_index_type, std::string> direntKeys;
+  entry_index_type direntKeysRangeBegin = 0;
+  entry_index_type lowest = 0;
+  for (const auto i : order) {
+    const char ns = keys[i].first;
+    const std::string& url = keys[i].second;
+    const std::string key = ns + url;
+    const auto r = lookupGrid.getRange(key);
+    if (r.begin == r.end) {
+      results[i] = {false, entry_index_t(r.begin)};
+      continue;
+    }
+    if (r.begin != direntKeysRangeBegin) {
+      direntKeys.clear();
+      direntKeysRangeBegin = r.begin;
+    }
+    entry_index_type l = std::max(r.begin, lowest);
+    entry_index_type u(r.end);
+    while (true)
+    {
+      entry_index_type p = l + (u - l) / 2;
+      auto it = direntKeys.find(p);
+      if (it == direntKeys.end()) {
+        it = direntKeys.emplace(p, getDirentKey(p)).first;
+      }
+      const int c = key.compare(it->second);
+
+      if (c < 0)
+        u = p;
+      else if (c > 0)
+      {
+        if ( l == p ) {
+          results[i] = {false, entry_index_t(u)};
+          // The dirent before the insertion point is lower than the next keys.
+          lowest = u - 1;
+          break;
+        }
+        l = p;
+      }
+      else
+      {
+        results[i] = {true, entry_index_t(p)};
+        lowest = p;
+        break;
+      }
+    }
+  }
+  return results;
+}
+
 } // namespace zim
 
 #endif // ZIM_DIRENT_LOOKUP_H
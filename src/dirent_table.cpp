@@ -0,0 +1,118 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "dirent_table.h"
+
+#include "_dirent.h"
+#include "dirent_accessor.h"
+#include "direntreader.h"
+
+using namespace zim;
+
+DirentTable::DirentTable(const DirectDirentAccessor& accessor, const DirentReader& direntReader)
+{
+  const entry_index_type count = accessor.getDirentCount().v;
+  m_namespaces.reserve(count);
+  m_mimeTypes.reserve(count);
+  m_clusterOrRedirect.reserve(count);
+  m_blobNumbers.reserve(count);
+  m_urlOffsets.reserve(count + 1);
+  m_titleOffsets.reserve(count);
+  m_parameterOffsets.reserve(count);
+
+  for (entry_index_type i = 0; i < count; ++i) {
+    // Don't go through the dirent cache of the accessor, we would only
+    // evict useful entries from it.
+    const auto dirent = direntReader.readDirent(accessor.getOffset(entry_index_t(i)));
+    m_namespaces.push_back(dirent->getNamespace());
+    m_mimeTypes.push_back(dirent->getMimeType());
+    if (dirent->isRedirect()) {
+      m_clusterOrRedirect.push_back(dirent->getRedirectIndex().v);
+      m_blobNumbers.push_back(0);
+    } else {
+      m_clusterOrRedirect.push_back(dirent->getClusterNumber().v);
+      m_blobNumbers.push_back(dirent->getBlobNumber().v);
+    }
+
+    const auto& url = dirent->getUrl();
+    const auto& title = dirent->getTitle();
+    const auto& parameter = dirent->getParameter();
+    m_urlOffsets.push_back(m_arena.size());
+    m_arena.insert(m_arena.end(), url.begin(), url.end());
+    m_titleOffsets.push_back(m_arena.size());
+    // An empty title means that the title is the url, keep it that way.
+    if (title != url) {
+      m_arena.insert(m_arena.end(), title.begin(), title.end());
+    }
+    m_parameterOffsets.push_back(m_arena.size());
+    m_arena.insert(m_arena.end(), parameter.begin(), parameter.end());
+  }
+  m_urlOffsets.push_back(m_arena.size());
+  m_arena.shrink_to_fit();
+}
+
+int DirentTable::compareWithPath(entry_index_t idx, char ns, const std::string& url) const
+{
+  const char direntNs = m_namespaces[idx.v];
+  if (ns != direntNs) {
+    return ns < direntNs ? -1 : 1;
+  }
+  const auto begin = m_urlOffsets[idx.v];
+  const auto size = m_titleOffsets[idx.v] - begin;
+  return url.compare(0, url.size(), m_arena.data() + begin, size);
+}
+
+std::string DirentTable::getTitleKey(entry_index_t idx) const
+{
+  const auto i = idx.v;
+  const char* const arena = m_arena.data();
+  std::string key(1, m_namespaces[i]);
+  if (m_titleOffsets[i] == m_parameterOffsets[i]) {
+    // The title is the url.
+    key.append(arena + m_urlOffsets[i], arena + m_titleOffsets[i]);
+  } else {
+    key.append(arena + m_titleOffsets[i], arena + m_parameterOffsets[i]);
+  }
+  return key;
+}
+
+std::shared_ptr<const Dirent> DirentTable::getDirent(entry_index_t idx) const
+{
+  const auto i = idx.v;
+  const char* const arena = m_arena.data();
+  auto dirent = std::make_shared<Dirent>();
+  dirent->setUrl(m_namespaces[i],
+                 std::string(arena + m_urlOffsets[i], arena + m_titleOffsets[i]));
+  dirent->setTitle(std::string(arena + m_titleOffsets[i], arena + m_parameterOffsets[i]));
+  dirent->setParameter(std::string(arena + m_parameterOffsets[i], arena + m_urlOffsets[i+1]));
+  if (m_mimeTypes[i] == Dirent::redirectMimeType) {
+    dirent->setRedirect(entry_index_t(m_clusterOrRedirect[i]));
+  } else {
+    dirent->setItem(m_mimeTypes[i], cluster_index_t(m_clusterOrRedirect[i]), blob_index_t(m_blobNumbers[i]));
+  }
+  return dirent;
+}
+
+size_t DirentTable::getMemorySize() const
+{
+  return m_namespaces.capacity() * sizeof(char)
+       + m_mimeTypes.capacity() * sizeof(uint16_t)
+       + m_clusterOrRedirect.capacity() * sizeof(uint32_t)
+       + m_blobNumbers.capacity() * sizeof(blob_index_type)
+       + (m_urlOffsets.capacity() + m_titleOffsets.capacity() + m_parameterOffsets.capacity()) * sizeof(size_t)
+       + m_arena.capacity();
+}
@@ -0,0 +1,86 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_DIRENT_TABLE_H
+#define ZIM_DIRENT_TABLE_H
+
+#include "zim_types.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zim
+{
+
+class Dirent;
+class DirentReader;
+class DirectDirentAccessor;
+
+/**
+ * DirentTable is an in-memory copy of all the dirents of an archive.
+ *
+ * The dirents are decoded once and stored as a struct of arrays: one array
+ * per field, indexed by the entry index, and a single string arena for the
+ * urls, titles and parameters. Reading a field is a plain array access, no
+ * file read, cache lookup or allocation is needed.
+ *
+ * The table is immutable once built and can be used from several threads.
+ * The version field of the dirents is not kept (it is always 0).
+ */
+class DirentTable
+{
+public: // functions
+  DirentTable(const DirectDirentAccessor& accessor, const DirentReader& direntReader);
+
+  entry_index_t getDirentCount() const { return entry_index_t(m_namespaces.size()); }
+
+  char getNamespace(entry_index_t idx) const { return m_namespaces[idx.v]; }
+  uint16_t getMimeType(entry_index_t idx) const { return m_mimeTypes[idx.v]; }
+
+  // Compares (ns, url) with the path of the dirent `idx`, in the same way
+  // as std::string::compare.
+  int compareWithPath(entry_index_t idx, char ns, const std::string& url) const;
+
+  // The key of the dirent `idx` in the title index: its namespace
+  // followed by its title.
+  std::string getTitleKey(entry_index_t idx) const;
+
+  // Builds a Dirent object with the data of the dirent `idx`.
+  std::shared_ptr<const Dirent> getDirent(entry_index_t idx) const;
+
+  // The memory used by the table, in bytes.
+  size_t getMemorySize() const;
+
+private: // data
+  std::vector<char>             m_namespaces;
+  std::vector<uint16_t>         m_mimeTypes;
+  // The cluster number of an item or the redirect index of a redirection.
+  std::vector<uint32_t>         m_clusterOrRedirect;
+  std::vector<blob_index_type>  m_blobNumbers;
+
+  // The strings of the dirent `i` are stored in m_arena as url, title
+  // and parameter, from m_urlOffsets[i] to m_urlOffsets[i+1].
+  std::vector<size_t>           m_urlOffsets;
+  std::vector<size_t>           m_titleOffsets;
+  std::vector<size_t>           m_parameterOffsets;
+  std::vector<char>             m_arena;
+};
+
+} // namespace zim
+
+#endif // ZIM_DIRENT_TABLE_H
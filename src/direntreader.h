@@ -24,8 +24,7 @@
 #include "reader.h"
 
 #include <memory>
-#include <mutex>
-#include <vector>
+#include <string>
 
 namespace zim
 {
@@ -33,22 +32,34 @@ namespace zim
 // Unlke FileReader and MemoryReader (which read data from a file and memory,
 // respectively), DirentReader is a helper class that reads Dirents (rather
 // than from a Dirent).
+//
+// DirentReader has no mutable state and can be used from several threads
+// without locking: dirents are parsed directly from the data when it is in
+// memory, or from a thread local copy otherwise.
 class DirentReader
 {
 public: // functions
-  explicit DirentReader(std::shared_ptr<const Reader> zimReader)
-    : mp_zimReader(zimReader)
-  {}
+  explicit DirentReader(std::shared_ptr<const Reader> zimReader);
 
-  std::shared_ptr<const Dirent> readDirent(offset_t offset);
+  std::shared_ptr<const Dirent> readDirent(offset_t offset) const;
+
+  // Reads only the namespace and the title of the dirent at `offset`, as
+  // the key of the title index (namespace followed by the title).
+  std::string readTitleKey(offset_t offset) const;
 
 private: // functions
   bool initDirent(Dirent& dirent, const Buffer& direntData) const;
-  
+  bool initTitleKey(std::string& key, const Buffer& direntData) const;
+  // Calls init on the data at `offset`, with a bigger buffer as long as
+  // init fails.
+  template<typename Init>
+  void readWithInit(offset_t offset, Init init) const;
+  Buffer getDirentData(offset_t offset, zsize_t size) const;
+
 private: // data
   std::shared_ptr<const Reader> mp_zimReader;
-  std::vector<char> m_buffer;
-  std::mutex m_bufferMutex;
+  // Whether mp_zimReader gives buffers without copying the data.
+  const bool m_inMemory;
 };
 
 } // namespace zim
@@ -33,7 +33,7 @@ namespace zim
     return def;
   }
 
-  unsigned envMemSize(const char* env, unsigned def)
+  size_t envMemSize(const char* env, size_t def)
   {
     const char* v = ::getenv(env);
     if (v)
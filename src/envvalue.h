@@ -20,10 +20,12 @@
 #ifndef ZIM_ENVVALUE_H
 #define ZIM_ENVVALUE_H
 
+#include <cstddef>
+
 namespace zim
 {
   unsigned envValue(const char* env, unsigned def);
-  unsigned envMemSize(const char* env, unsigned def);
+  size_t envMemSize(const char* env, size_t def);
 }
 
 #endif // ZIM_ENVVALUE_H
@@ -33,11 +33,11 @@
 
 namespace zim {
 
-void FileCompound::addPart(FilePart* fpart)
+void FileCompound::addPart(std::shared_ptr<const FilePart> fpart)
 {
   const Range newRange(offset_t(_fsize.v), offset_t((_fsize+fpart->size()).v));
-  emplace(newRange, fpart);
   _fsize += fpart->size();
+  emplace(newRange, std::move(fpart));
 }
 
 FileCompound::FileCompound(const std::string& filename):
@@ -45,7 +45,7 @@ FileCompound::FileCompound(const std::string& filename):
   _fsize(0)
 {
   try {
-    addPart(new FilePart(filename));
+    addPart(std::make_shared<FilePart>(filename));
   } catch(...) {
     int errnoSave = errno;
     _fsize = zsize_t(0);
@@ -55,7 +55,7 @@ FileCompound::FileCompound(const std::string& filename):
         const std::string fname0 = filename + ch0;
         for (char ch1 = 'a'; ch1 <= 'z'; ++ch1)
         {
-          addPart(new FilePart(fname0 + ch1));
+          addPart(std::make_shared<FilePart>(fname0 + ch1));
         }
       }
     } catch (...) { }
@@ -74,17 +74,10 @@ FileCompound::FileCompound(int fd):
   _filename(),
   _fsize(0)
 {
-  addPart(new FilePart(fd));
+  addPart(std::make_shared<FilePart>(fd));
 }
 #endif
 
-FileCompound::~FileCompound() {
-  for(auto it=begin(); it!=end(); it++) {
-    auto filepart = it->second;
-    delete filepart;
-  }
-}
-
 time_t FileCompound::getMTime() const {
   if (mtime || empty())
     return mtime;
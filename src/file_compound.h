@@ -47,8 +47,8 @@ struct less_range : public std::binary_function< Range, Range, bool>
   }
 };
 
-class FileCompound : private std::map<Range, FilePart*, less_range> {
-    typedef std::map<Range, FilePart*, less_range> ImplType;
+class FileCompound : private std::map<Range, std::shared_ptr<const FilePart>, less_range> {
+    typedef std::map<Range, std::shared_ptr<const FilePart>, less_range> ImplType;
 
   public: // types
     typedef const_iterator PartIterator;
@@ -61,8 +61,6 @@ class FileCompound : private std::map<Range, FilePart*, less_range> {
     explicit FileCompound(int fd);
 #endif
 
-    ~FileCompound();
-
     using ImplType::begin;
     using ImplType::end;
 
@@ -96,7 +94,7 @@ class FileCompound : private std::map<Range, FilePart*, less_range> {
     }
 
   private: // functions
-    void addPart(FilePart* fpart);
+    void addPart(std::shared_ptr<const FilePart> fpart);
 
   private: // data
     std::string _filename;
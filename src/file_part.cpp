@@ -0,0 +1,199 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "file_part.h"
+#include "envvalue.h"
+
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace zim {
+
+// The parts with an open file, in a circular list. When too many files are
+// open, a hand goes over the list (the "clock" approximation of a least
+// recently used list): a part used since the last visit of the hand is
+// given a second chance, the file of the first other part is closed.
+// The parts which cannot be reopened are not in the list, only counted.
+class FilePart::OpenFiles
+{
+  public:
+    // Never destroyed: parts may be destroyed by static destructors.
+    static OpenFiles& instance()
+    {
+      static OpenFiles* const openFiles = new OpenFiles();
+      return *openFiles;
+    }
+
+    // `reopen` is true if the file has been closed to respect the limit.
+    FDSharedPtr open(const FilePart& part, bool reopen)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      // The file may have been reopened by another thread.
+      if (auto fd = std::atomic_load(&part.m_fhandle)) {
+        return fd;
+      }
+      FDSharedPtr fd = std::make_shared<FS::FD>(FS::openFile(part.m_filename));
+      if (reopen) {
+        // The path must still name the same, unchanged, file.
+        if (fd->getFileId() != part.m_fileId || fd->getSize() != part.m_size) {
+          std::ostringstream msg;
+          msg << "The file " << part.m_filename
+              << " has been replaced or modified since it was opened";
+          throw std::runtime_error(msg.str());
+        }
+      }
+      std::atomic_store(&part.m_fhandle, fd);
+      if (!part.m_closable) {
+        ++m_unclosableCount;
+      } else {
+        // Just behind the hand, so visited last.
+        part.m_openFilesPos = m_parts.insert(m_hand, &part);
+      }
+      part.m_isOpen = true;
+      closeFiles(&part);
+      return fd;
+    }
+
+    void remove(const FilePart& part)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!part.m_isOpen) {
+        return;
+      }
+      if (!part.m_closable) {
+        --m_unclosableCount;
+      } else {
+        erase(part);
+      }
+    }
+
+    void setMaxOpenFiles(size_t count)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_maxOpenFiles = count;
+      closeFiles(nullptr);
+    }
+
+    size_t getMaxOpenFiles()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_maxOpenFiles;
+    }
+
+    size_t getOpenFileCount()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_parts.size() + m_unclosableCount;
+    }
+
+  private:
+    OpenFiles()
+      : m_hand(m_parts.end()),
+        m_maxOpenFiles(envValue("ZIM_MAXOPENFILES", 0)),
+        m_unclosableCount(0)
+    {}
+
+    // Closes files until the limit is respected (if possible), except the
+    // one of `keep`.
+    void closeFiles(const FilePart* keep)
+    {
+      if (m_maxOpenFiles == 0) {
+        return;
+      }
+      const size_t keptCount = keep && keep->m_closable ? 1 : 0;
+      while (m_parts.size() + m_unclosableCount > m_maxOpenFiles
+          && m_parts.size() > keptCount) {
+        if (m_hand == m_parts.end()) {
+          m_hand = m_parts.begin();
+        }
+        const FilePart* part = *m_hand;
+        if (part == keep || part->m_used.exchange(false)) {
+          ++m_hand;
+          continue;
+        }
+        // The file is closed when the readers using it release it.
+        std::atomic_store(&part->m_fhandle, FDSharedPtr());
+        erase(*part);
+      }
+    }
+
+    void erase(const FilePart& part)
+    {
+      if (m_hand == part.m_openFilesPos) {
+        ++m_hand;
+      }
+      m_parts.erase(part.m_openFilesPos);
+      part.m_isOpen = false;
+    }
+
+    std::mutex m_mutex;
+    std::list<const FilePart*> m_parts;
+    std::list<const FilePart*>::iterator m_hand;
+    size_t m_maxOpenFiles;
+    // The open files of the parts which cannot be closed.
+    size_t m_unclosableCount;
+};
+
+FilePart::FilePart(const std::string& filename, bool closable) :
+    m_filename(filename),
+    m_closable(closable),
+    m_size(0),
+    m_fileId{0, 0},
+    m_used(true),
+    m_isOpen(false)
+{
+  const auto fd = OpenFiles::instance().open(*this, false);
+  try {
+    m_size = fd->getSize();
+    m_fileId = fd->getFileId();
+  } catch (...) {
+    OpenFiles::instance().remove(*this);
+    throw;
+  }
+}
+
+FilePart::~FilePart()
+{
+  OpenFiles::instance().remove(*this);
+}
+
+FilePart::FDSharedPtr FilePart::fhandle() const
+{
+  m_used.store(true, std::memory_order_relaxed);
+  if (auto fd = std::atomic_load(&m_fhandle)) {
+    return fd;
+  }
+  return OpenFiles::instance().open(*this, true);
+}
+
+void FilePart::setMaxOpenFiles(size_t count)
+{
+  OpenFiles::instance().setMaxOpenFiles(count);
+}
+
+size_t FilePart::getMaxOpenFiles()
+{
+  return OpenFiles::instance().getMaxOpenFiles();
+}
+
+size_t FilePart::getOpenFileCount()
+{
+  return OpenFiles::instance().getOpenFileCount();
+}
+
+} // zim
@@ -20,6 +20,8 @@
 #ifndef ZIM_FILE_PART_H_
 #define ZIM_FILE_PART_H_
 
+#include <atomic>
+#include <list>
 #include <string>
 #include <cstdio>
 #include <memory>
@@ -35,32 +37,62 @@ class FilePart {
   typedef DEFAULTFS FS;
 
   public:
-    using FDSharedPtr = std::shared_ptr<FS::FD>;
+    using FDSharedPtr = std::shared_ptr<const FS::FD>;
+
+    // The number of files kept open by all the file parts of the process
+    // is limited (0 means no limit). When the limit is reached, opening a
+    // file closes the file of a part which has not been used recently.
+    // The files of the parts opened from a file descriptor are never
+    // closed (they cannot be reopened), but they count in the limit.
+    static void setMaxOpenFiles(size_t count);
+    static size_t getMaxOpenFiles();
+    static size_t getOpenFileCount();
 
   public:
-    FilePart(const std::string& filename) :
-        m_filename(filename),
-        m_fhandle(std::make_shared<FS::FD>(FS::openFile(filename))),
-        m_size(m_fhandle->getSize()) {}
+    explicit FilePart(const std::string& filename) :
+        FilePart(filename, true) {}
 
 #ifndef _WIN32
-    FilePart(int fd) :
-        FilePart(getFilePathFromFD(fd)) {}
+    explicit FilePart(int fd) :
+        FilePart(getFilePathFromFD(fd), false) {}
 #endif
 
-    ~FilePart() = default;
+    ~FilePart();
+    FilePart(const FilePart&) = delete;
+    FilePart& operator=(const FilePart&) = delete;
+
     const std::string& filename() const { return m_filename; };
-    const FS::FD& fhandle() const { return *m_fhandle; };
-    const FDSharedPtr& shareable_fhandle() const { return m_fhandle; };
+
+    // The descriptor of the file, reopened if it has been closed. It is not
+    // closed while the returned pointer is held (even beyond the limit of
+    // open files), so it must not be kept longer than needed.
+    // Throws if the path names another file (or a file of another size)
+    // than the one first opened.
+    FDSharedPtr fhandle() const;
 
     zsize_t size() const { return m_size; };
     bool fail() const { return !m_size; };
     bool good() const { return bool(m_size); };
 
-  private:
+  private: // types
+    class OpenFiles;
+
+  private: // functions
+    FilePart(const std::string& filename, bool closable);
+
+  private: // data
     const std::string m_filename;
-    FDSharedPtr m_fhandle;
+    // False if the file cannot be reopened by its path.
+    const bool m_closable;
+    mutable FDSharedPtr m_fhandle;
     zsize_t m_size;
+    FS::FD::FileId m_fileId;
+
+    // Used by OpenFiles (and protected by its mutex), except m_used which is
+    // set by each access.
+    mutable std::atomic<bool> m_used;
+    mutable bool m_isOpen;
+    mutable std::list<const FilePart*>::iterator m_openFilesPos;
 };
 
 };
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <system_error>
 #include <algorithm>
+#include <atomic>
 
 
 #ifndef _WIN32
@@ -44,6 +45,46 @@
 
 namespace zim {
 
+namespace
+{
+
+class MmapPolicies
+{
+  public:
+    MmapPolicies()
+    {
+      set(MemoryRegion::POINTER_TABLES, MmapPolicy::RANDOM);
+      set(MemoryRegion::CLUSTERS, MmapPolicy::POPULATE);
+      set(MemoryRegion::BLOBS, MmapPolicy::LAZY);
+    }
+
+    void set(MemoryRegion region, MmapPolicy policy) { m_policies[size_t(region)] = policy; }
+    MmapPolicy get(MemoryRegion region) const { return m_policies[size_t(region)]; }
+
+  private:
+    std::atomic<MmapPolicy> m_policies[size_t(MemoryRegion::COUNT)];
+};
+
+MmapPolicies& mmapPolicies()
+{
+  static MmapPolicies policies;
+  return policies;
+}
+
+} // unnamed namespace
+
+void setMmapPolicy(MemoryRegion region, MmapPolicy policy)
+{
+  ASSERT(size_t(region), <, size_t(MemoryRegion::COUNT));
+  mmapPolicies().set(region, policy);
+}
+
+MmapPolicy getMmapPolicy(MemoryRegion region)
+{
+  ASSERT(size_t(region), <, size_t(MemoryRegion::COUNT));
+  return mmapPolicies().get(region);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // MultiPartFileReader
 ////////////////////////////////////////////////////////////////////////////////
@@ -64,12 +105,11 @@ char MultiPartFileReader::read(offset_t offset) const {
   ASSERT(offset.v, <, _size.v);
   offset += _offset;
   auto part_pair = source->locate(offset);
-  auto& fhandle = part_pair->second->fhandle();
   offset_t local_offset = offset - part_pair->first.min;
   ASSERT(local_offset, <=, part_pair->first.max);
   char ret;
   try {
-    fhandle.readAt(&ret, zsize_t(1), local_offset);
+    part_pair->second->fhandle()->readAt(&ret, zsize_t(1), local_offset);
   } catch (std::runtime_error& e) {
     //Error while reading.
     std::ostringstream s;
@@ -101,7 +141,7 @@ void MultiPartFileReader::read(char* dest, offset_t offset, zsize_t size) const
     ASSERT(size.v, >, 0U);
     zsize_t size_to_get = zsize_t(std::min(size.v, part->size().v-local_offset.v));
     try {
-      part->fhandle().readAt(dest, size_to_get, local_offset);
+      part->fhandle()->readAt(dest, size_to_get, local_offset);
     } catch (std::runtime_error& e) {
       std::ostringstream s;
       s << "Cannot read chars.\n";
@@ -124,24 +164,89 @@ void MultiPartFileReader::read(char* dest, offset_t offset, zsize_t size) const
   ASSERT(size.v, ==, 0U);
 }
 
+void MultiPartFileReader::readBatch(const std::vector<ReadRequest>& requests) const {
+  // A request over several parts is split in a read per part.
+  std::vector<DEFAULTFS::ReadRequest> fsRequests;
+  // Keeps the files open until the reads are done.
+  std::vector<FilePart::FDSharedPtr> fhandles;
+  for (const auto& request: requests) {
+    ASSERT(request.offset.v+request.size.v, <=, _size.v);
+    if (! request.size ) {
+      continue;
+    }
+    char* dest = request.dest;
+    offset_t offset = _offset + request.offset;
+    zsize_t size = request.size;
+    auto found_range = source->locate(offset, size);
+    for(auto current = found_range.first; current!=found_range.second; current++){
+      auto part = current->second;
+      offset_t local_offset = offset-current->first.min;
+      zsize_t size_to_get = zsize_t(std::min(size.v, part->size().v-local_offset.v));
+      fhandles.push_back(part->fhandle());
+      fsRequests.push_back({fhandles.back().get(), dest, local_offset, size_to_get});
+      dest += size_to_get.v;
+      size -= size_to_get;
+      offset += size_to_get;
+    }
+    ASSERT(size.v, ==, 0U);
+  }
+  if (!DEFAULTFS::readBatch(fsRequests)) {
+    std::ostringstream s;
+    s << "Cannot read chars.\n";
+    s << " - File is " << source->filename() << "\n";
+    s << " - Batch of " << fsRequests.size() << " reads\n";
+    s << " - error is " << strerror(errno) << "\n";
+    std::error_code ec(errno, std::generic_category());
+    throw std::system_error(ec, s.str());
+  }
+}
+
 #ifdef ENABLE_USE_MMAP
 namespace
 {
 
 class MMapException : std::exception {};
 
-char*
-mmapReadOnly(int fd, offset_type offset, size_type size)
+int
+mmapFlags(MmapPolicy policy)
 {
+  if (policy != MmapPolicy::POPULATE) {
+    return MAP_PRIVATE;
+  }
 #if defined(__APPLE__) || defined(__OpenBSD__)
-  const auto MAP_FLAGS = MAP_PRIVATE;
+  return MAP_PRIVATE;
 #elif defined(__FreeBSD__)
-  const auto MAP_FLAGS = MAP_PRIVATE|MAP_PREFAULT_READ;
+  return MAP_PRIVATE|MAP_PREFAULT_READ;
 #else
-  const auto MAP_FLAGS = MAP_PRIVATE|MAP_POPULATE;
+  return MAP_PRIVATE|MAP_POPULATE;
+#endif
+}
+
+// The advice is only a hint, it is not an error if it is not followed.
+void
+adviseMmap(char* address, size_type size, MmapPolicy policy)
+{
+  switch (policy) {
+    case MmapPolicy::RANDOM:
+      madvise(address, size, MADV_RANDOM);
+      break;
+    case MmapPolicy::WILLNEED:
+      madvise(address, size, MADV_WILLNEED);
+      break;
+    case MmapPolicy::HUGEPAGE:
+#ifdef MADV_HUGEPAGE
+      madvise(address, size, MADV_HUGEPAGE);
 #endif
+      break;
+    default:
+      break;
+  }
+}
 
-  const auto p = (char*)mmap(NULL, size, PROT_READ, MAP_FLAGS, fd, offset);
+char*
+mmapReadOnly(int fd, offset_type offset, size_type size, MmapPolicy policy)
+{
+  const auto p = (char*)mmap(NULL, size, PROT_READ, mmapFlags(policy), fd, offset);
   if (p == MAP_FAILED )
   {
     std::ostringstream s;
@@ -149,11 +254,12 @@ mmapReadOnly(int fd, offset_type offset, size_type size)
       << " : " << strerror(errno);
     throw std::runtime_error(s.str());
   }
+  adviseMmap(p, size, policy);
   return p;
 }
 
 Buffer::DataPtr
-makeMmappedBuffer(int fd, offset_t offset, zsize_t size)
+makeMmappedBuffer(int fd, offset_t offset, zsize_t size, MmapPolicy policy)
 {
   const offset_type pageAlignedOffset(offset.v & ~(sysconf(_SC_PAGE_SIZE) - 1));
   const size_t alignmentAdjustment = offset.v - pageAlignedOffset;
@@ -164,7 +270,7 @@ makeMmappedBuffer(int fd, offset_t offset, zsize_t size)
     throw MMapException();
   }
 #endif
-  char* const mmappedAddress = mmapReadOnly(fd, pageAlignedOffset, size.v);
+  char* const mmappedAddress = mmapReadOnly(fd, pageAlignedOffset, size.v, policy);
   const auto munmapDeleter = [mmappedAddress, size](char* ) {
                                munmap(mmappedAddress, size.v);
                              };
@@ -172,30 +278,89 @@ makeMmappedBuffer(int fd, offset_t offset, zsize_t size)
   return Buffer::DataPtr(mmappedAddress+alignmentAdjustment, munmapDeleter);
 }
 
+// Maps a range over several parts. The parts are mapped next to each other,
+// so that the range is contiguous in memory. This is only possible if the
+// parts (but the last one) are a multiple of the page size: a part must
+// start at a page boundary in memory, as it is mapped from its start.
+Buffer::DataPtr
+makeMmappedBuffer(const FileCompound::PartRange& parts, offset_t offset, zsize_t size, MmapPolicy policy)
+{
+  if (parts.first == parts.second) {
+    throw MMapException();
+  }
+  if (std::next(parts.first) == parts.second) {
+    // The range is in only one part
+    const auto range = parts.first->first;
+    const auto part = parts.first->second;
+    ASSERT(size, <=, part->size());
+    // The mapping stays valid when the file is closed.
+    const auto fhandle = part->fhandle();
+    return makeMmappedBuffer(fhandle->getNativeHandle(), offset - range.min, size, policy);
+  }
+
+  const size_type pageSize = sysconf(_SC_PAGE_SIZE);
+  for (auto it = parts.first; std::next(it) != parts.second; ++it) {
+    if (it->second->size().v % pageSize != 0) {
+      throw MMapException();
+    }
+  }
+
+  const offset_type localOffset = (offset - parts.first->first.min).v;
+  offset_type partOffset(localOffset & ~(pageSize - 1));
+  const size_t alignmentAdjustment = localOffset - partOffset;
+  const size_type mappedSize = size.v + alignmentAdjustment;
+
+  // Reserve the address range, then map the parts over it.
+  const auto address = (char*)mmap(NULL, mappedSize, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED) {
+    throw MMapException();
+  }
+  const auto munmapDeleter = [address, mappedSize](char* ) {
+                               munmap(address, mappedSize);
+                             };
+  Buffer::DataPtr data(address+alignmentAdjustment, munmapDeleter);
+
+  char* partAddress = address;
+  for (auto it = parts.first; it != parts.second; ++it) {
+#if !MMAP_SUPPORT_64
+    if(partOffset >= INT32_MAX) {
+      throw MMapException();
+    }
+#endif
+    const auto partSize = std::min(mappedSize - (partAddress - address), it->second->size().v - partOffset);
+    const auto fhandle = it->second->fhandle();
+    const auto p = mmap(partAddress, partSize, PROT_READ, mmapFlags(policy)|MAP_FIXED, fhandle->getNativeHandle(), partOffset);
+    if (p == MAP_FAILED) {
+      throw MMapException();
+    }
+    partAddress += partSize;
+    partOffset = 0;
+  }
+  adviseMmap(address, mappedSize, policy);
+  return data;
+}
+
 } // unnamed namespace
 #endif // ENABLE_USE_MMAP
 
 const Buffer MultiPartFileReader::get_buffer(offset_t offset, zsize_t size) const {
+  return mapped_buffer(offset, size, MmapPolicy::POPULATE);
+}
+
+const Buffer MultiPartFileReader::get_buffer(offset_t offset, zsize_t size, MemoryRegion region) const {
+  return mapped_buffer(offset, size, getMmapPolicy(region));
+}
+
+const Buffer MultiPartFileReader::mapped_buffer(offset_t offset, zsize_t size, MmapPolicy policy) const {
   ASSERT(size, <=, _size);
 #ifdef ENABLE_USE_MMAP
   try {
     auto found_range = source->locate(_offset+offset, size);
-    auto first_part_containing_it = found_range.first;
-    if (++first_part_containing_it != found_range.second) {
-      throw MMapException();
-    }
-
-    // The range is in only one part
-    auto range = found_range.first->first;
-    auto part = found_range.first->second;
-    auto local_offset = offset + _offset - range.min;
-    ASSERT(size, <=, part->size());
-    int fd = part->fhandle().getNativeHandle();
-    return Buffer::makeBuffer(makeMmappedBuffer(fd, local_offset, size), size);
+    return Buffer::makeBuffer(makeMmappedBuffer(found_range, _offset+offset, size, policy), size);
   } catch(MMapException& e)
 #endif
   {
-    // The range is several part, or we are on Windows.
+    // The parts can't be mapped next to each other, or we are on Windows.
     // We will have to do some memory copies :/
     // [TODO] Use Windows equivalent for mmap.
     auto ret_buffer = Buffer::makeBuffer(size);
@@ -209,12 +374,25 @@ bool Reader::can_read(offset_t offset, zsize_t size) const
     return (offset.v <= this->size().v && (offset.v+size.v) <= this->size().v);
 }
 
+void Reader::readBatch(const std::vector<ReadRequest>& requests) const
+{
+    for (const auto& request: requests) {
+      read(request.dest, request.offset, request.size);
+    }
+}
+
 
 std::unique_ptr<const Reader> MultiPartFileReader::sub_reader(offset_t offset, zsize_t size) const
 {
   ASSERT(offset.v+size.v, <=, _size.v);
-  // TODO: can use a FileReader here if the new range fully belongs to a single part
-  return std::unique_ptr<Reader>(new MultiPartFileReader(source, _offset+offset, size));
+  offset += _offset;
+  // A range in a single part is read without looking for the part.
+  const auto found_range = source->locate(offset, size);
+  if (found_range.first != found_range.second && std::next(found_range.first) == found_range.second) {
+    const auto range = found_range.first->first;
+    return std::unique_ptr<Reader>(new FileReader(found_range.first->second, offset - range.min, size));
+  }
+  return std::unique_ptr<Reader>(new MultiPartFileReader(source, offset, size));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -228,13 +406,25 @@ FileReader::FileReader(FileHandle fh, offset_t offset, zsize_t size)
 {
 }
 
+FileReader::FileReader(std::shared_ptr<const FilePart> part, offset_t offset, zsize_t size)
+  : _part(part)
+  , _offset(offset)
+  , _size(size)
+{
+}
+
+FileReader::FileHandle FileReader::fhandle() const
+{
+  return _part ? _part->fhandle() : _fhandle;
+}
+
 char FileReader::read(offset_t offset) const
 {
   ASSERT(offset.v, <, _size.v);
   offset += _offset;
   char ret;
   try {
-    _fhandle->readAt(&ret, zsize_t(1), offset);
+    fhandle()->readAt(&ret, zsize_t(1), offset);
   } catch (std::runtime_error& e) {
     //Error while reading.
     std::ostringstream s;
@@ -256,7 +446,7 @@ void FileReader::read(char* dest, offset_t offset, zsize_t size) const
   }
   offset += _offset;
   try {
-    _fhandle->readAt(dest, size, offset);
+    fhandle()->readAt(dest, size, offset);
   } catch (std::runtime_error& e) {
     std::ostringstream s;
     s << "Cannot read chars.\n";
@@ -268,13 +458,45 @@ void FileReader::read(char* dest, offset_t offset, zsize_t size) const
   };
 }
 
+void FileReader::readBatch(const std::vector<ReadRequest>& requests) const
+{
+  const auto fh = fhandle();
+  std::vector<DEFAULTFS::ReadRequest> fsRequests;
+  fsRequests.reserve(requests.size());
+  for (const auto& request: requests) {
+    ASSERT(request.offset.v+request.size.v, <=, _size.v);
+    if (request.size) {
+      fsRequests.push_back({fh.get(), request.dest, _offset + request.offset, request.size});
+    }
+  }
+  if (!DEFAULTFS::readBatch(fsRequests)) {
+    std::ostringstream s;
+    s << "Cannot read chars.\n";
+    s << " - Batch of " << fsRequests.size() << " reads\n";
+    s << " - error is " << strerror(errno) << "\n";
+    std::error_code ec(errno, std::generic_category());
+    throw std::system_error(ec, s.str());
+  }
+}
+
 const Buffer FileReader::get_buffer(offset_t offset, zsize_t size) const
+{
+  return mapped_buffer(offset, size, MmapPolicy::POPULATE);
+}
+
+const Buffer FileReader::get_buffer(offset_t offset, zsize_t size, MemoryRegion region) const
+{
+  return mapped_buffer(offset, size, getMmapPolicy(region));
+}
+
+const Buffer FileReader::mapped_buffer(offset_t offset, zsize_t size, MmapPolicy policy) const
 {
   ASSERT(size, <=, _size);
 #ifdef ENABLE_USE_MMAP
   offset += _offset;
-  int fd = _fhandle->getNativeHandle();
-  return Buffer::makeBuffer(makeMmappedBuffer(fd, offset, size), size);
+  // The mapping stays valid when the file is closed.
+  const auto fh = fhandle();
+  return Buffer::makeBuffer(makeMmappedBuffer(fh->getNativeHandle(), offset, size, policy), size);
 #else // We are on Windows. [TODO] Use Windows equivalent for mmap.
   auto ret_buffer = Buffer::makeBuffer(size);
   read(const_cast<char*>(ret_buffer.data()), offset, size);
@@ -286,6 +508,9 @@ std::unique_ptr<const Reader>
 FileReader::sub_reader(offset_t offset, zsize_t size) const
 {
   ASSERT(offset.v+size.v, <=, _size.v);
+  if (_part) {
+    return std::unique_ptr<const Reader>(new FileReader(_part, _offset + offset, size));
+  }
   return std::unique_ptr<const Reader>(new FileReader(_fhandle, _offset + offset, size));
 }
 
@@ -26,6 +26,7 @@
 namespace zim {
 
 class FileCompound;
+class FilePart;
 
 class FileReader : public Reader {
   public: // types
@@ -33,6 +34,9 @@ class FileReader : public Reader {
 
   public: // functions
     explicit FileReader(FileHandle fh, offset_t offset, zsize_t size);
+    // Reads the file of the part, which may be closed and reopened between
+    // two reads (see FilePart::fhandle()).
+    explicit FileReader(std::shared_ptr<const FilePart> part, offset_t offset, zsize_t size);
     ~FileReader() = default;
 
     zsize_t size() const { return _size; };
@@ -40,15 +44,24 @@ class FileReader : public Reader {
 
     char read(offset_t offset) const;
     void read(char* dest, offset_t offset, zsize_t size) const;
+    void readBatch(const std::vector<ReadRequest>& requests) const;
     const Buffer get_buffer(offset_t offset, zsize_t size) const;
+    const Buffer get_buffer(offset_t offset, zsize_t size, MemoryRegion region) const;
 
     std::unique_ptr<const Reader> sub_reader(offset_t offset, zsize_t size) const;
 
+  private: // functions
+    FileHandle fhandle() const;
+    // The buffers not in a region are populated (fully read when mapped).
+    const Buffer mapped_buffer(offset_t offset, zsize_t size, MmapPolicy policy) const;
+
   private: // data
     // The file handle is stored via a shared pointer so that it can be shared
     // by a sub_reader (otherwise the file handle would be invalidated by
     // FD destructor when the sub-reader is destroyed).
+    // Only one of them is set.
     FileHandle _fhandle;
+    std::shared_ptr<const FilePart> _part;
     offset_t _offset;
     zsize_t _size;
 };
@@ -63,12 +76,15 @@ class MultiPartFileReader : public Reader {
 
     char read(offset_t offset) const;
     void read(char* dest, offset_t offset, zsize_t size) const;
+    void readBatch(const std::vector<ReadRequest>& requests) const;
     const Buffer get_buffer(offset_t offset, zsize_t size) const;
+    const Buffer get_buffer(offset_t offset, zsize_t size, MemoryRegion region) const;
 
     std::unique_ptr<const Reader> sub_reader(offset_t offset, zsize_t size) const;
 
   private:
     MultiPartFileReader(std::shared_ptr<const FileCompound> source, offset_t offset, zsize_t size);
+    const Buffer mapped_buffer(offset_t offset, zsize_t size, MmapPolicy policy) const;
 
     std::shared_ptr<const FileCompound> source;
     offset_t _offset;
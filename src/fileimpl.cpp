@@ -22,12 +22,18 @@
 #include "_dirent.h"
 #include "file_compound.h"
 #include "buffer_reader.h"
+#include "path_hash_index.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sstream>
 #include <errno.h>
 #include <cstring>
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "config.h"
 #include "log.h"
 #include "envvalue.h"
@@ -42,24 +48,95 @@ namespace zim
 namespace
 {
 
+// Default number of threads prefetching the entries of an archive.
+const unsigned PREFETCH_THREADS = 2;
+// Older prefetch requests are dropped when there are too many of them.
+const size_t MAX_PENDING_PREFETCH_TASKS = 64;
+const unsigned MAX_PREFETCH_REDIRECTS = 32;
+// The clusters prefetched together are read by batches of this size.
+const size_type MAX_PREFETCH_BATCH_SIZE = 32*1024*1024;
+// Size of the blocks read when verifying the checksum of an archive.
+const size_t VERIFY_BLOCK_SIZE = 4*1024*1024;
+// Number of entries (or cluster pointers) checked by a task of checkIntegrity().
+const uint64_t CHECK_ENTRIES_PER_TASK = 4096;
+// Number of clusters read by a task of checkIntegrity().
+const uint64_t CHECK_CLUSTERS_PER_TASK = 16;
+// Minimum number of dirents read by a thread sorting the entries by cluster.
+const entry_index_type MIN_ENTRIES_PER_ORDER_THREAD = 64*1024;
+// Estimated memory of a cluster, to convert a cache size given as a number
+// of clusters (deprecated) in bytes.
+const size_t CLUSTER_MEMORY_ESTIMATE = 4*1024*1024;
+
+// ZIM_CLUSTERCACHE, the number of cached clusters, is still accepted but
+// ZIM_CLUSTERCACHE_BYTES takes precedence.
+size_t defaultClusterCacheSize()
+{
+  const size_t clusterCount = envValue("ZIM_CLUSTERCACHE", 0);
+  const size_t defaultSize = clusterCount
+                           ? clusterCount * CLUSTER_MEMORY_ESTIMATE
+                           : size_t(CLUSTER_CACHE_BYTES);
+  return envMemSize("ZIM_CLUSTERCACHE_BYTES", defaultSize);
+}
+
 offset_t readOffset(const Reader& reader, entry_index_type idx)
 {
   offset_t offset(reader.read_uint<offset_type>(offset_t(sizeof(offset_type)*idx)));
   return offset;
 }
 
+#ifdef ENABLE_USE_BUFFER_HEADER
+// A BufferReader of a section of the archive, created by the first read.
+class LazyBufferReader : public Reader
+{
+  public:
+    LazyBufferReader(std::shared_ptr<const Reader> source, offset_t offset, zsize_t size)
+      : mp_source(std::move(source)),
+        m_offset(offset),
+        m_size(size)
+    {}
+
+    zsize_t size() const { return m_size; }
+    offset_t offset() const { return reader().offset(); }
+
+    void read(char* dest, offset_t offset, zsize_t size) const { reader().read(dest, offset, size); }
+    char read(offset_t offset) const { return reader().read(offset); }
+    const Buffer get_buffer(offset_t offset, zsize_t size) const { return reader().get_buffer(offset, size); }
+    std::unique_ptr<const Reader> sub_reader(offset_t offset, zsize_t size) const { return reader().sub_reader(offset, size); }
+
+  private:
+    const Reader& reader() const
+    {
+      std::call_once(m_onceFlag, [this]() {
+        mp_reader.reset(new BufferReader(mp_source->get_buffer(m_offset, m_size, MemoryRegion::POINTER_TABLES)));
+      });
+      return *mp_reader;
+    }
+
+    std::shared_ptr<const Reader> mp_source;
+    const offset_t m_offset;
+    const zsize_t m_size;
+    mutable std::once_flag m_onceFlag;
+    mutable std::unique_ptr<const Reader> mp_reader;
+};
+#endif
+
+// With OpenMode::LAZY, the section is only checked to be in the archive,
+// it is read on first use.
 std::unique_ptr<const Reader>
-sectionSubReader(const Reader& zimReader, const std::string& sectionName,
-                 offset_t offset, zsize_t size)
+sectionSubReader(const std::shared_ptr<const Reader>& zimReader, const std::string& sectionName,
+                 offset_t offset, zsize_t size, OpenMode mode = OpenMode::EAGER)
 {
-  if (!zimReader.can_read(offset, size)) {
+  if (!zimReader->can_read(offset, size)) {
     throw ZimFileFormatError(sectionName + " outside (or not fully inside) ZIM file.");
   }
 #ifdef ENABLE_USE_BUFFER_HEADER
-  const auto buf = zimReader.get_buffer(offset, size);
+  if (mode == OpenMode::LAZY) {
+    return std::unique_ptr<Reader>(new LazyBufferReader(zimReader, offset, size));
+  }
+  const auto buf = zimReader->get_buffer(offset, size, MemoryRegion::POINTER_TABLES);
   return std::unique_ptr<Reader>(new BufferReader(buf));
 #else
-  return zimReader.sub_reader(offset, size);
+  return zimReader->sub_reader(offset, size);
 #endif
 }
 
@@ -74,7 +151,7 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     return std::make_shared<MultiPartFileReader>(zimFile);
   } else {
     const auto& firstAndOnlyPart = zimFile->begin()->second;
-    return std::make_shared<FileReader>(firstAndOnlyPart->shareable_fhandle(), offset, size);
+    return std::make_shared<FileReader>(firstAndOnlyPart, offset, size);
   }
 }
 
@@ -83,33 +160,35 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
   //////////////////////////////////////////////////////////////////////
   // FileImpl
   //
-  FileImpl::FileImpl(const std::string& fname)
-    : FileImpl(std::make_shared<FileCompound>(fname))
+  FileImpl::FileImpl(const std::string& fname, OpenMode mode)
+    : FileImpl(std::make_shared<FileCompound>(fname), mode)
   {}
 
 #ifndef _WIN32
-  FileImpl::FileImpl(int fd)
-    : FileImpl(std::make_shared<FileCompound>(fd))
+  FileImpl::FileImpl(int fd, OpenMode mode)
+    : FileImpl(std::make_shared<FileCompound>(fd), mode)
   {}
 
-  FileImpl::FileImpl(int fd, offset_t offset, zsize_t size)
-    : FileImpl(std::make_shared<FileCompound>(fd), offset, size)
+  FileImpl::FileImpl(int fd, offset_t offset, zsize_t size, OpenMode mode)
+    : FileImpl(std::make_shared<FileCompound>(fd), offset, size, mode)
   {}
 #endif
 
-  FileImpl::FileImpl(std::shared_ptr<FileCompound> _zimFile)
-    : FileImpl(_zimFile, offset_t(0), _zimFile->fsize())
+  FileImpl::FileImpl(std::shared_ptr<FileCompound> _zimFile, OpenMode mode)
+    : FileImpl(_zimFile, offset_t(0), _zimFile->fsize(), mode)
   {}
 
-  FileImpl::FileImpl(std::shared_ptr<FileCompound> _zimFile, offset_t offset, zsize_t size)
+  FileImpl::FileImpl(std::shared_ptr<FileCompound> _zimFile, offset_t offset, zsize_t size, OpenMode mode)
     : zimFile(_zimFile),
       archiveStartOffset(offset),
       zimReader(makeFileReader(zimFile, offset, size)),
       direntReader(new DirentReader(zimReader)),
-      clusterCache(envValue("ZIM_CLUSTERCACHE", CLUSTER_CACHE_SIZE)),
+      clusterCache(defaultClusterCacheSize()),
+      m_clusterDecodeSize(envMemSize("ZIM_CLUSTERDECODE_BYTES", 0)),
       m_newNamespaceScheme(false),
       m_startUserEntry(0),
-      m_endUserEntry(0)
+      m_endUserEntry(0),
+      prefetcher(envValue("ZIM_PREFETCHTHREADS", PREFETCH_THREADS), MAX_PENDING_PREFETCH_TASKS)
   {
     log_trace("read file \"" << zimFile->filename() << '"');
 
@@ -128,38 +207,44 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
       throw ZimFileFormatError("error reading zim-file header.");
     }
 
-    auto urlPtrReader = sectionSubReader(*zimReader,
+    auto urlPtrReader = sectionSubReader(zimReader,
                                          "Dirent pointer table",
                                          offset_t(header.getUrlPtrPos()),
-                                         zsize_t(sizeof(offset_type)*header.getArticleCount()));
+                                         zsize_t(sizeof(offset_type)*header.getArticleCount()),
+                                         mode);
 
     mp_urlDirentAccessor.reset(
         new DirectDirentAccessor(direntReader, std::move(urlPtrReader), entry_index_t(header.getArticleCount())));
 
 
-    clusterOffsetReader = sectionSubReader(*zimReader,
+    clusterOffsetReader = sectionSubReader(zimReader,
                                            "Cluster pointer table",
                                            offset_t(header.getClusterPtrPos()),
-                                           zsize_t(sizeof(offset_type)*header.getClusterCount()));
+                                           zsize_t(sizeof(offset_type)*header.getClusterCount()),
+                                           mode);
 
     quickCheckForCorruptFile();
 
-    mp_titleDirentAccessor = getTitleAccessor("listing/titleOrdered/v1");
+    const_cast<bool&>(m_newNamespaceScheme) = header.getMinorVersion() >= 1;
 
-    if (!mp_titleDirentAccessor) {
-      offset_t titleOffset(header.getTitleIdxPos());
-      zsize_t  titleSize(sizeof(entry_index_type)*header.getArticleCount());
-      mp_titleDirentAccessor = getTitleAccessor(titleOffset, titleSize, "Title index table");
+    // Otherwise, these parts of the archive are read on first use.
+    if (mode == OpenMode::EAGER) {
+      load();
     }
+  }
 
-    readMimeTypes();
+  void FileImpl::load()
+  {
+    titleDirentAccessor();
+    getMimeTypes();
+    readUserEntryRange();
   }
 
-  std::unique_ptr<IndirectDirentAccessor> FileImpl::getTitleAccessor(const std::string& path)
+  bool FileImpl::getUncompressedXItemData(DirentLookup& lookup, const std::string& path, offset_t& offset, zsize_t& size)
   {
-    auto result = direntLookup().find('X', path);
+    auto result = lookup.find('X', path);
     if (!result.first) {
-      return nullptr;
+      return false;
     }
 
     auto dirent = mp_urlDirentAccessor->getDirent(result.second);
@@ -167,16 +252,62 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     if (cluster->isCompressed()) {
       // This is a ZimFileFormatError.
       // Let's be tolerent and skip the entry
+      return false;
+    }
+    offset = getClusterOffset(dirent->getClusterNumber()) + cluster->getBlobOffset(dirent->getBlobNumber());
+    size = cluster->getBlobSize(dirent->getBlobNumber());
+    return true;
+  }
+
+  std::unique_ptr<IndirectDirentAccessor> FileImpl::getTitleAccessor(const std::string& path)
+  {
+    offset_t titleOffset;
+    zsize_t titleSize;
+    if (!getUncompressedXItemData(direntLookup(), path, titleOffset, titleSize)) {
       return nullptr;
     }
-    auto titleOffset = getClusterOffset(dirent->getClusterNumber()) + cluster->getBlobOffset(dirent->getBlobNumber());
-    auto titleSize = cluster->getBlobSize(dirent->getBlobNumber());
     return getTitleAccessor(titleOffset, titleSize, "Title index table" + path);
   }
 
+  const IndirectDirentAccessor& FileImpl::titleDirentAccessor() const
+  {
+    std::call_once(m_titleDirentAccessorOnceFlag, [this]() {
+      // Reading the title listing item may need any part of the archive.
+      auto self = const_cast<FileImpl*>(this);
+      mp_titleDirentAccessor = self->getTitleAccessor("listing/titleOrdered/v1");
+
+      if (!mp_titleDirentAccessor) {
+        offset_t titleOffset(header.getTitleIdxPos());
+        zsize_t  titleSize(sizeof(entry_index_type)*header.getArticleCount());
+        mp_titleDirentAccessor = self->getTitleAccessor(titleOffset, titleSize, "Title index table");
+      }
+    });
+    return *mp_titleDirentAccessor;
+  }
+
+  void FileImpl::readPathHashIndex(DirentLookup& lookup)
+  {
+    offset_t offset;
+    zsize_t size;
+    if (!getUncompressedXItemData(lookup, "index/pathHash/v0", offset, size)) {
+      return;
+    }
+    try {
+      std::unique_ptr<const PathHashIndex> index(
+        new PathHashIndex(sectionSubReader(zimReader, "Path hash index", offset, size)));
+      if (!index->empty()) {
+        lookup.setHashIndex(std::move(index));
+      }
+    } catch (ZimFileFormatError& e) {
+      // The index is only used to speed up the lookups.
+      // Let's be tolerent and do without it.
+      log_warn("ignoring the path hash index: " << e.what());
+    }
+  }
+
   std::unique_ptr<IndirectDirentAccessor> FileImpl::getTitleAccessor(const offset_t offset, const zsize_t size, const std::string& name)
   {
-      auto titleIndexReader = sectionSubReader(*zimReader,
+      auto titleIndexReader = sectionSubReader(zimReader,
                                                name,
                                                offset,
                                                size);
@@ -187,20 +318,100 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
 
   FileImpl::DirentLookup& FileImpl::direntLookup()
   {
-    if ( ! m_direntLookup ) {
-      const auto cacheSize = envValue("ZIM_DIRENTLOOKUPCACHE", DIRENT_LOOKUP_CACHE_SIZE);
-      m_direntLookup.reset(new DirentLookup(mp_urlDirentAccessor.get(), cacheSize));
-    }
+    std::call_once(m_direntLookupOnceFlag, [this]() {
+      // Old archives don't have a stored lookup grid.
+      std::unique_ptr<DirentLookup> lookup;
+      if (header.getMinorVersion() >= 1) {
+        lookup = readStoredDirentLookup();
+      }
+      if (!lookup) {
+        const auto cacheSize = envValue("ZIM_DIRENTLOOKUPCACHE", DIRENT_LOOKUP_CACHE_SIZE);
+        lookup.reset(new DirentLookup(mp_urlDirentAccessor.get(), cacheSize));
+      }
+      readPathHashIndex(*lookup);
+      m_direntLookup = std::move(lookup);
+    });
     return *m_direntLookup;
   }
 
+  std::unique_ptr<FileImpl::DirentLookup> FileImpl::readStoredDirentLookup()
+  {
+    // The lookup grid stored in the archive is located with a minimal
+    // grid (a plain binary search): about log2(n) dirent reads, 21 for an
+    // archive of 1M entries, against 2x1024 to build the full grid.
+    // The archive format has no place to store the position of the grid.
+    DirentLookup minimalLookup(mp_urlDirentAccessor.get(), 1);
+    offset_t offset;
+    zsize_t size;
+    if (!getUncompressedXItemData(minimalLookup, "index/lookupGrid/v0", offset, size)
+     || size.v == 0
+     || !zimReader->can_read(offset, size)) {
+      return nullptr;
+    }
+    try {
+      // Mapped in memory (if possible), the grid is not copied.
+      NarrowDown grid(zimReader->get_buffer(offset, size));
+      return std::unique_ptr<DirentLookup>(new DirentLookup(mp_urlDirentAccessor.get(), std::move(grid)));
+    } catch (ZimFileFormatError& e) {
+      log_warn("ignoring the stored lookup grid: " << e.what());
+      return nullptr;
+    }
+  }
+
+  const NarrowDown* FileImpl::titleLookupGrid()
+  {
+    std::call_once(m_titleLookupGridOnceFlag, [this]() {
+      const auto direntCount = entry_index_type(titleDirentAccessor().getDirentCount());
+      if (direntCount == 0) {
+        return;
+      }
+      const auto titleKey = [this](entry_index_type i) {
+        return titleDirentAccessor().getTitleKey(title_index_t(i));
+      };
+      const auto cacheSize = envValue("ZIM_DIRENTLOOKUPCACHE", DIRENT_LOOKUP_CACHE_SIZE);
+      const entry_index_type step = std::max(1u, direntCount/cacheSize);
+      // If the title index is not sorted as we expect, don't build the grid
+      // and do the lookups on the whole index. The order is checked here,
+      // NarrowDown would report it as an error of the dirent table.
+      const auto notSorted = [](entry_index_type i) {
+        log_warn("no lookup grid: the title index is not properly sorted"
+                 " (title #" << i << ")");
+      };
+      std::unique_ptr<NarrowDown> grid(new NarrowDown());
+      try {
+        std::string prevKey;
+        for (entry_index_type i = 0; i < direntCount-1; i += step) {
+          const auto key = titleKey(i);
+          auto nextKey = titleKey(i+1);
+          if (key < prevKey || key > nextKey) {
+            return notSorted(i);
+          }
+          grid->add(key, i, nextKey);
+          prevKey = std::move(nextKey);
+        }
+        const auto lastKey = titleKey(direntCount-1);
+        if (lastKey < prevKey) {
+          return notSorted(direntCount-1);
+        }
+        grid->close(lastKey, direntCount-1);
+      } catch (ZimFileFormatError& e) {
+        log_warn("no lookup grid for the title index: " << e.what());
+        return;
+      }
+      mp_titleLookupGrid = std::move(grid);
+    });
+    return mp_titleLookupGrid.get();
+  }
+
   void FileImpl::quickCheckForCorruptFile()
   {
     if (!getCountClusters())
       log_warn("no clusters found");
     else
     {
-      offset_t lastOffset = getClusterOffset(cluster_index_t(cluster_index_type(getCountClusters()) - 1));
+      // Read from the file: the cluster pointer table may not be loaded yet.
+      const auto lastPtrPos = header.getClusterPtrPos() + sizeof(offset_type)*(getCountClusters().v - 1);
+      const offset_t lastOffset(zimReader->read_uint<offset_type>(offset_t(lastPtrPos)));
       log_debug("last offset=" << lastOffset.v << " file size=" << getFilesize().v);
       if (lastOffset.v > getFilesize().v)
       {
@@ -224,14 +435,22 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
       // order as the corresponding entries in the dirent pointer table
       result = std::min(result, mp_urlDirentAccessor->getOffset(entry_index_t(0)).v);
 
-      // assuming that clusters are placed in the zim file in the same
-      // order as the corresponding entries in the cluster pointer table
+    }
+    if ( getCountClusters().v != 0 ) {
+      // Even if the clusters are not stored in index order, the mime list
+      // is before all of them.
       result = std::min(result, readOffset(*clusterOffsetReader, 0).v);
     }
     return result;
   }
 
-  void FileImpl::readMimeTypes()
+  const FileImpl::MimeTypes& FileImpl::getMimeTypes() const
+  {
+    std::call_once(m_mimeTypesOnceFlag, [this]() { readMimeTypes(); });
+    return mimeTypes;
+  }
+
+  void FileImpl::readMimeTypes() const
   {
     // read mime types
     // libzim write zims files two ways :
@@ -263,15 +482,19 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
 
       p = zp+1;
     }
+  }
 
-    const_cast<bool&>(m_newNamespaceScheme) = header.getMinorVersion() >= 1;
-    if (m_newNamespaceScheme) {
-      const_cast<entry_index_t&>(m_startUserEntry) = getNamespaceBeginOffset('C');
-      const_cast<entry_index_t&>(m_endUserEntry) = getNamespaceEndOffset('C');
-    } else {
-      const_cast<entry_index_t&>(m_endUserEntry) = getCountArticles();
-    }
-
+  void FileImpl::readUserEntryRange() const
+  {
+    std::call_once(m_userEntryRangeOnceFlag, [this]() {
+      if (m_newNamespaceScheme) {
+        auto self = const_cast<FileImpl*>(this);
+        m_startUserEntry = self->getNamespaceBeginOffset('C');
+        m_endUserEntry = self->getNamespaceEndOffset('C');
+      } else {
+        m_endUserEntry = getCountArticles();
+      }
+    });
   }
 
   FileImpl::FindxResult FileImpl::findx(char ns, const std::string& url)
@@ -279,6 +502,11 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     return direntLookup().find(ns, url);
   }
 
+  std::vector<FileImpl::FindxResult> FileImpl::findx(const std::vector<FindxKey>& keys)
+  {
+    return direntLookup().find(keys);
+  }
+
   FileImpl::FindxResult FileImpl::findx(const std::string& url)
   {
     char ns;
@@ -307,7 +535,12 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     log_debug("find article by title " << ns << " \"" << title << "\", in file \"" << getFilename() << '"');
 
     entry_index_type l = 0;
-    entry_index_type u = entry_index_type(mp_titleDirentAccessor->getDirentCount());
+    entry_index_type u = entry_index_type(titleDirentAccessor().getDirentCount());
+    if (const auto grid = titleLookupGrid()) {
+      const auto r = grid->getRange(ns + title);
+      l = r.begin;
+      u = r.end;
+    }
 
     if (l == u)
     {
@@ -361,48 +594,293 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
 
   std::shared_ptr<const Dirent> FileImpl::getDirentByTitle(title_index_t idx)
   {
-    return mp_titleDirentAccessor->getDirent(idx);
+    return titleDirentAccessor().getDirent(idx);
   }
 
   entry_index_t FileImpl::getIndexByTitle(title_index_t idx) const
   {
-    return mp_titleDirentAccessor->getDirectIndex(idx);
+    return titleDirentAccessor().getDirectIndex(idx);
   }
 
   entry_index_t FileImpl::getIndexByClusterOrder(entry_index_t idx) const
   {
       std::call_once(orderOnceFlag, [this]
       {
-          articleListByCluster.reserve(getUserEntryCount().v);
-
-          auto endIdx = getEndUserEntry().v;
-          for(auto i = getStartUserEntry().v; i < endIdx; i++)
-          {
-              // This is the offset of the dirent in the zimFile
-              auto indexOffset = mp_urlDirentAccessor->getOffset(entry_index_t(i));
-              // Get the mimeType of the dirent (offset 0) to know the type of the dirent
-              uint16_t mimeType = zimReader->read_uint<uint16_t>(indexOffset);
-              if (mimeType==Dirent::redirectMimeType || mimeType==Dirent::linktargetMimeType || mimeType == Dirent::deletedMimeType) {
-                articleListByCluster.push_back(std::make_pair(0, i));
-              } else {
-                // If it is a classic article, get the clusterNumber (at offset 8)
-                auto clusterNumber = zimReader->read_uint<zim::cluster_index_type>(indexOffset+offset_t(8));
-                articleListByCluster.push_back(std::make_pair(clusterNumber, i));
-              }
+          const_cast<FileImpl*>(this)->readClusterOrderListing();
+          if (mp_clusterOrderListing && !isValidClusterOrderListing()) {
+            log_warn("ignoring the invalid cluster ordered listing");
+            mp_clusterOrderListing.reset();
+          }
+          if (!mp_clusterOrderListing) {
+            prepareArticleListByCluster();
           }
-          std::sort(articleListByCluster.begin(), articleListByCluster.end());
       });
 
+      if (mp_clusterOrderListing) {
+        if (idx.v >= getUserEntryCount().v)
+          throw std::out_of_range("entry index out of range");
+        return entry_index_t(mp_clusterOrderListing->read_uint<entry_index_type>(offset_t(sizeof(entry_index_type)*idx.v)));
+      }
       if (idx.v >= articleListByCluster.size())
         throw std::out_of_range("entry index out of range");
       return entry_index_t(articleListByCluster[idx.v].second);
   }
 
+  void FileImpl::readClusterOrderListing()
+  {
+    offset_t offset;
+    zsize_t size;
+    if (!getUncompressedXItemData(direntLookup(), "listing/clusterOrdered/v0", offset, size)
+     || getUserEntryCount().v == 0) {
+      return;
+    }
+    if (size.v != sizeof(entry_index_type)*getUserEntryCount().v
+     || !zimReader->can_read(offset, size)) {
+      log_warn("ignoring the cluster ordered listing of " << size.v << " bytes");
+      return;
+    }
+    // Mapped in memory (if possible), the listing is not copied.
+    mp_clusterOrderListing.reset(new BufferReader(zimReader->get_buffer(offset, size)));
+  }
+
+  // The listing must be a permutation of the user entries.
+  bool FileImpl::isValidClusterOrderListing() const
+  {
+    const auto begin = getStartUserEntry().v;
+    const auto count = getUserEntryCount().v;
+    std::vector<bool> seen(count, false);
+    for (entry_index_type i = 0; i < count; ++i) {
+      const auto idx = mp_clusterOrderListing->read_uint<entry_index_type>(offset_t(sizeof(entry_index_type)*i));
+      if (idx < begin || idx - begin >= count || seen[idx - begin]) {
+        return false;
+      }
+      seen[idx - begin] = true;
+    }
+    return true;
+  }
+
+  // The dirents are read by several threads, each one sorting its own
+  // part of the list. The sorted parts are then merged.
+  void FileImpl::prepareArticleListByCluster() const
+  {
+    const auto begin = getStartUserEntry().v;
+    const auto count = getUserEntryCount().v;
+    articleListByCluster.resize(count);
+
+    const unsigned nbThreads = std::max(1U,
+      std::min<unsigned>(std::thread::hardware_concurrency(), count / MIN_ENTRIES_PER_ORDER_THREAD));
+    std::vector<entry_index_type> partStarts;
+    for (unsigned t = 0; t <= nbThreads; ++t) {
+      partStarts.push_back(entry_index_type(uint64_t(count) * t / nbThreads));
+    }
+
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    const auto worker = [&](unsigned t) {
+      try {
+        for (auto i = partStarts[t]; i < partStarts[t+1]; ++i) {
+          cluster_index_type clusterNumber;
+          blob_index_type blobNumber;
+          if (!readItemLocation(entry_index_t(begin + i), clusterNumber, blobNumber)) {
+            clusterNumber = 0;
+          }
+          articleListByCluster[i] = std::make_pair(clusterNumber, begin + i);
+        }
+        std::sort(articleListByCluster.begin() + partStarts[t],
+                  articleListByCluster.begin() + partStarts[t+1]);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nbThreads; ++t) {
+      threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread: threads) {
+      thread.join();
+    }
+    if (error) {
+      articleListByCluster.clear();
+      std::rethrow_exception(error);
+    }
+
+    const auto first = articleListByCluster.begin();
+    for (unsigned width = 1; width < nbThreads; width *= 2) {
+      for (unsigned t = 0; t + width < nbThreads; t += 2 * width) {
+        std::inplace_merge(first + partStarts[t],
+                           first + partStarts[t + width],
+                           first + partStarts[std::min(t + 2 * width, nbThreads)]);
+      }
+    }
+  }
+  // Reads the location of an item directly from its dirent in the file
+  // (without parsing the whole dirent). Returns false if the entry is not
+  // an item.
+  bool FileImpl::readItemLocation(entry_index_t idx, cluster_index_type& clusterNumber, blob_index_type& blobNumber) const
+  {
+    // This is the offset of the dirent in the zimFile
+    const auto direntOffset = mp_urlDirentAccessor->getOffset(idx);
+    // Get the mimeType of the dirent (offset 0) to know the type of the dirent
+    const uint16_t mimeType = zimReader->read_uint<uint16_t>(direntOffset);
+    if (mimeType==Dirent::redirectMimeType || mimeType==Dirent::linktargetMimeType || mimeType == Dirent::deletedMimeType) {
+      return false;
+    }
+    // If it is a classic article, get the clusterNumber (at offset 8) and the blobNumber (at offset 12)
+    clusterNumber = zimReader->read_uint<cluster_index_type>(direntOffset+offset_t(8));
+    blobNumber = zimReader->read_uint<blob_index_type>(direntOffset+offset_t(12));
+    return true;
+  }
+
+  void FileImpl::forEachItem(const ItemVisitor& visitor, unsigned nbThreads)
+  {
+    struct ItemLocation
+    {
+      cluster_index_type cluster;
+      blob_index_type blob;
+      entry_index_type entry;
+
+      bool operator<(const ItemLocation& other) const
+      {
+        if (cluster != other.cluster) {
+          return cluster < other.cluster;
+        }
+        return blob != other.blob ? blob < other.blob : entry < other.entry;
+      }
+    };
+
+    std::vector<ItemLocation> items;
+    items.reserve(getUserEntryCount().v);
+    for (auto i = getStartUserEntry().v; i < getEndUserEntry().v; ++i) {
+      ItemLocation item;
+      item.entry = i;
+      if (readItemLocation(entry_index_t(i), item.cluster, item.blob)) {
+        items.push_back(item);
+      }
+    }
+    std::sort(items.begin(), items.end());
+
+    // The items of a cluster are items[clusterStarts[k]] to items[clusterStarts[k+1]-1]
+    std::vector<size_t> clusterStarts;
+    for (size_t i = 0; i < items.size(); ++i) {
+      if (i == 0 || items[i].cluster != items[i-1].cluster) {
+        clusterStarts.push_back(i);
+      }
+    }
+    clusterStarts.push_back(items.size());
+    const size_t clusterCount = clusterStarts.size() - 1;
+
+    if (nbThreads == 0) {
+      nbThreads = std::thread::hardware_concurrency();
+    }
+    nbThreads = std::max(1U, std::min<unsigned>(nbThreads, clusterCount));
+
+    // Clusters are given to the threads one at a time, in order: their sizes
+    // vary too much for a static split of the range.
+    std::atomic<size_t> nextCluster(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    const auto worker = [&]() {
+      try {
+        while (!failed) {
+          const size_t k = nextCluster++;
+          if (k >= clusterCount) {
+            break;
+          }
+          const cluster_index_t clusterIdx(items[clusterStarts[k]].cluster);
+          if (clusterIdx >= getCountClusters()) {
+            throw ZimFileFormatError("cluster index out of range");
+          }
+          const auto cluster = readCluster(clusterIdx);
+          for (size_t i = clusterStarts[k]; i < clusterStarts[k+1] && !failed; ++i) {
+            visitor(entry_index_t(items[i].entry), cluster->getBlob(blob_index_t(items[i].blob)));
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nbThreads; ++t) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread: threads) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+
   FileImpl::ClusterHandle FileImpl::readCluster(cluster_index_t idx)
   {
     offset_t clusterOffset(getClusterOffset(idx));
     log_debug("read cluster " << idx << " from offset " << clusterOffset);
-    return Cluster::read(*zimReader, clusterOffset);
+    return Cluster::read(*zimReader, clusterOffset, getMaxClusterSize(idx), m_clusterDecodeSize);
+  }
+
+  const std::vector<offset_type>& FileImpl::getSortedClusterOffsets() const
+  {
+    std::call_once(m_sortedClusterOffsetsOnceFlag, [this]() {
+      const auto count = getCountClusters().v;
+      m_sortedClusterOffsets.reserve(count);
+      for (cluster_index_type i = 0; i < count; ++i) {
+        m_sortedClusterOffsets.push_back(readOffset(*clusterOffsetReader, i).v);
+      }
+      std::sort(m_sortedClusterOffsets.begin(), m_sortedClusterOffsets.end());
+    });
+    return m_sortedClusterOffsets;
+  }
+
+  zsize_t FileImpl::getMaxClusterSize(cluster_index_t idx) const
+  {
+    // Clusters are not overlapping, but they may be stored in any order
+    // (see Creator::configClusterCompletionOrder()). A cluster cannot go
+    // past any cluster stored after it, nor past the next section of the
+    // archive. The next cluster (by index) is usually stored right after
+    // it: all the cluster offsets are only read and sorted otherwise.
+    const offset_type clusterOffset = getClusterOffset(idx).v;
+    offset_type end = getFilesize().v;
+    if (idx.v + 1 < getCountClusters().v) {
+      const offset_type nextOffset = getClusterOffset(cluster_index_t(idx.v + 1)).v;
+      if (nextOffset > clusterOffset) {
+        end = nextOffset;
+      } else {
+        const auto& sortedOffsets = getSortedClusterOffsets();
+        const auto next = std::upper_bound(sortedOffsets.begin(), sortedOffsets.end(), clusterOffset);
+        if (next != sortedOffsets.end()) {
+          end = *next;
+        }
+      }
+    }
+
+    std::vector<offset_type> sections{header.getUrlPtrPos(), header.getClusterPtrPos()};
+    if (header.hasChecksum()) {
+      sections.push_back(header.getChecksumPos());
+    }
+    if (getCountArticles().v != 0) {
+      // assuming that dirents are placed in the zim file in the same
+      // order as the corresponding entries in the dirent pointer table
+      sections.push_back(mp_urlDirentAccessor->getOffset(entry_index_t(0)).v);
+    }
+    for (const auto sectionOffset: sections) {
+      if (sectionOffset > clusterOffset) {
+        end = std::min(end, sectionOffset);
+      }
+    }
+    return clusterOffset < end ? zsize_t(end - clusterOffset) : zsize_t(0);
   }
 
   std::shared_ptr<const Cluster> FileImpl::getCluster(cluster_index_t idx)
@@ -413,6 +891,125 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     return clusterCache.getOrPut(idx.v, [=](){ return readCluster(idx); });
   }
 
+  void FileImpl::prefetchEntries(const std::vector<entry_index_t>& indexes, bool decompress)
+  {
+    std::vector<cluster_index_type> clusters;
+    for (auto idx: indexes) {
+      if (idx >= getCountArticles()) {
+        continue;
+      }
+      auto dirent = getDirent(idx);
+      // Don't loop forever on (invalid) redirection cycles.
+      for (unsigned i = 0; dirent->isRedirect() && i < MAX_PREFETCH_REDIRECTS; ++i) {
+        dirent = getDirent(dirent->getRedirectIndex());
+      }
+      if (dirent->isArticle()) {
+        clusters.push_back(dirent->getClusterNumber().v);
+      }
+    }
+    std::sort(clusters.begin(), clusters.end());
+    clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+
+    if (!decompress) {
+      for (auto idx: clusters) {
+        readAheadCluster(cluster_index_t(idx));
+      }
+      return;
+    }
+
+    std::vector<cluster_index_type> toRead;
+    for (auto idx: clusters) {
+      const cluster_index_t clusterIdx(idx);
+      if (clusterIdx >= getCountClusters() || clusterCache.exists(idx)) {
+        continue;
+      }
+      if (getMaxClusterSize(clusterIdx).v == 0) {
+        // We don't know how much to read.
+        getCluster(clusterIdx);
+        continue;
+      }
+      toRead.push_back(idx);
+    }
+
+    // The info bytes of the clusters are read first (with one batch of
+    // reads), to know which clusters are compressed.
+    std::vector<char> infoBytes(toRead.size());
+    std::vector<Reader::ReadRequest> infoRequests;
+    for (size_t i = 0; i < toRead.size(); ++i) {
+      infoRequests.push_back({&infoBytes[i], getClusterOffset(cluster_index_t(toRead[i])), zsize_t(1)});
+    }
+    zimReader->readBatch(infoRequests);
+
+    // The compressed clusters are read with batches of reads submitted at
+    // once, then decompressed from memory. The blobs of the uncompressed
+    // clusters are read from the archive when needed: they are only read
+    // ahead, not copied in memory.
+    std::vector<cluster_index_type> batch;
+    zsize_t batchSize(0);
+    for (size_t i = 0; i < toRead.size(); ++i) {
+      const auto idx = toRead[i];
+      const cluster_index_t clusterIdx(idx);
+      const auto comp = static_cast<CompressionType>(infoBytes[i] & 0x0F);
+      if (comp != zimcompLzma && comp != zimcompZstd && comp != zimcompZstdSeekable) {
+        readAheadCluster(clusterIdx);
+        getCluster(clusterIdx);
+        continue;
+      }
+      const auto size = getMaxClusterSize(clusterIdx);
+      batch.push_back(idx);
+      batchSize += size;
+      if (batchSize.v >= MAX_PREFETCH_BATCH_SIZE) {
+        readClusterBatch(batch);
+        batch.clear();
+        batchSize = zsize_t(0);
+      }
+    }
+    readClusterBatch(batch);
+  }
+
+  void FileImpl::readClusterBatch(const std::vector<cluster_index_type>& clusters)
+  {
+    std::vector<Buffer> clusterData;
+    std::vector<Reader::ReadRequest> requests;
+    clusterData.reserve(clusters.size());
+    for (auto idx: clusters) {
+      const auto size = getMaxClusterSize(cluster_index_t(idx));
+      clusterData.push_back(Buffer::makeBuffer(size));
+      requests.push_back({const_cast<char*>(clusterData.back().data()), getClusterOffset(cluster_index_t(idx)), size});
+    }
+    zimReader->readBatch(requests);
+
+    for (size_t i = 0; i < clusters.size(); ++i) {
+      const auto& data = clusterData[i];
+      // A seekable cluster keeps the batched buffer to decode its frames.
+      clusterCache.getOrPut(clusters[i], [this, &data]() {
+        return ClusterHandle(Cluster::read(BufferReader(data), offset_t(0), data.size(), m_clusterDecodeSize));
+      });
+    }
+  }
+
+  void FileImpl::readAheadCluster(cluster_index_t idx)
+  {
+    if (idx >= getCountClusters() || clusterCache.exists(idx.v)) {
+      return;
+    }
+    const auto size = getMaxClusterSize(idx);
+    if (size.v == 0) {
+      return;
+    }
+    const offset_type begin = archiveStartOffset.v + getClusterOffset(idx).v;
+    const offset_type end = begin + size.v;
+    const auto parts = getFileParts(offset_t(begin), size);
+    for (auto it = parts.first; it != parts.second; ++it) {
+      const auto& range = it->first;
+      const offset_type partBegin = std::max(begin, range.min.v);
+      const offset_type partEnd = std::min(end, range.max.v);
+      if (partBegin < partEnd) {
+        it->second->fhandle()->readAhead(offset_t(partBegin - range.min.v), zsize_t(partEnd - partBegin));
+      }
+    }
+  }
+
   offset_t FileImpl::getClusterOffset(cluster_index_t idx) const
   {
     return readOffset(*clusterOffsetReader, idx.v);
@@ -440,14 +1037,15 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
 
   const std::string& FileImpl::getMimeType(uint16_t idx) const
   {
-    if (idx >= mimeTypes.size())
+    const auto& types = getMimeTypes();
+    if (idx >= types.size())
     {
       std::ostringstream msg;
       msg << "unknown mime type code " << idx;
       throw ZimFileFormatError(msg.str());
     }
 
-    return mimeTypes[idx];
+    return types[idx];
   }
 
   std::string FileImpl::getChecksum()
@@ -477,40 +1075,110 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     }
   }
 
-  bool FileImpl::verify()
+  bool FileImpl::verify(const ProgressCallback& progress)
   {
     if (!header.hasChecksum())
       return false;
 
+    const offset_type checksumPos = header.getChecksumPos();
+    if (!zimReader->can_read(offset_t(checksumPos), zsize_t(16))) {
+      return false;
+    }
+
     struct zim_MD5_CTX md5ctx;
     zim_MD5Init(&md5ctx);
 
-    offset_type checksumPos = header.getChecksumPos();
-    offset_type currentPos = 0;
-    for(auto part = zimFile->begin();
-        part != zimFile->end();
-        part++) {
-      std::ifstream stream(part->second->filename(), std::ios_base::in|std::ios_base::binary);
-
-      char ch;
-      for(/*NOTHING*/ ; currentPos < checksumPos && stream.get(ch).good(); currentPos++) {
-        zim_MD5Update(&md5ctx, reinterpret_cast<const uint8_t*>(&ch), 1);
+    // The archive is read in big blocks by a reader thread, while the
+    // previous block is hashed. The two blocks are used in turn: a block is
+    // owned by the reader until it is ready, then by the hashing thread.
+    struct Block
+    {
+      std::vector<char> data;
+      bool ready = false;
+      std::exception_ptr error;
+    };
+    Block blocks[2];
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopped = false;
+
+    std::thread reader([&]() {
+      unsigned current = 0;
+      for (offset_type pos = 0; pos < checksumPos; current ^= 1) {
+        auto& block = blocks[current];
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&]() { return !block.ready || stopped; });
+          if (stopped) {
+            return;
+          }
+        }
+        try {
+          block.data.resize(std::min<offset_type>(VERIFY_BLOCK_SIZE, checksumPos - pos));
+          zimReader->read(block.data.data(), offset_t(pos), zsize_t(block.data.size()));
+        } catch (...) {
+          block.error = std::current_exception();
+        }
+        pos += block.data.size();
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          block.ready = true;
+        }
+        cond.notify_all();
+        if (block.error) {
+          return;
+        }
       }
-      if (stream.bad()) {
-        perror("error while reading file");
-        return false;
+    });
+    const auto stopReader = [&]() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
       }
-      if (currentPos == checksumPos) {
-        break;
+      cond.notify_all();
+      reader.join();
+    };
+
+    bool readFailed = false;
+    try {
+      unsigned current = 0;
+      for (offset_type pos = 0; pos < checksumPos; current ^= 1) {
+        auto& block = blocks[current];
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&]() { return block.ready; });
+        }
+        if (block.error) {
+          try {
+            std::rethrow_exception(block.error);
+          } catch (std::exception& e) {
+            log_warn("error while reading file: " << e.what());
+          }
+          readFailed = true;
+          break;
+        }
+        zim_MD5Update(&md5ctx, reinterpret_cast<const uint8_t*>(block.data.data()), block.data.size());
+        pos += block.data.size();
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          block.ready = false;
+        }
+        cond.notify_all();
+        if (progress) {
+          progress(pos, checksumPos);
+        }
       }
+    } catch (...) {
+      stopReader();
+      throw;
     }
-
-    if (currentPos != checksumPos) {
+    stopReader();
+    if (readFailed) {
       return false;
     }
 
     unsigned char chksumCalc[16];
-    auto chksumFile = zimReader->get_buffer(offset_t(header.getChecksumPos()), zsize_t(16));
+    auto chksumFile = zimReader->get_buffer(offset_t(checksumPos), zsize_t(16));
 
     zim_MD5Final(chksumCalc, &md5ctx);
     if (std::memcmp(chksumFile.data(), chksumCalc, 16) != 0)
@@ -533,81 +1201,284 @@ makeFileReader(std::shared_ptr<const FileCompound> zimFile, offset_t offset, zsi
     return zimFile->is_multiPart();
   }
 
-  bool FileImpl::checkIntegrity(IntegrityCheck checkType) {
-    switch(checkType) {
-      case IntegrityCheck::CHECKSUM: return FileImpl::checkChecksum();
-      case IntegrityCheck::DIRENT_PTRS: return FileImpl::checkDirentPtrs();
-      case IntegrityCheck::DIRENT_ORDER: return FileImpl::checkDirentOrder();
-      case IntegrityCheck::TITLE_INDEX: return FileImpl::checkTitleIndex();
-      case IntegrityCheck::CLUSTER_PTRS: return FileImpl::checkClusterPtrs();
-      case IntegrityCheck::DIRENT_MIMETYPES: return FileImpl::checkDirentMimeTypes();
-      case IntegrityCheck::COUNT: ASSERT("shouldn't have reached here", ==, "");
+  bool FileImpl::checkIntegrity(IntegrityCheck checkType, unsigned nbThreads) {
+    if (checkType == IntegrityCheck::COUNT) {
+      ASSERT("shouldn't have reached here", ==, "");
+      return false;
     }
-    return false;
+    IntegrityChecks checks;
+    checks.set(size_t(checkType));
+    return checkIntegrity(checks, nbThreads);
   }
 
-  bool FileImpl::checkChecksum() {
-    if ( ! verify() ) {
-        std::cerr << "Checksum doesn't match" << std::endl;
-        return false;
+  // Keeps the first failure (the one with the lowest position) of each check.
+  // Failures may be found by several threads, in any order.
+  class IntegrityReport
+  {
+    public:
+      explicit IntegrityReport(const FileImpl::IntegrityChecks& checks)
+        : m_checks(checks)
+      {
+        for (auto& position: m_firstFailures) {
+          position = NO_FAILURE;
+        }
+      }
+
+      bool isRun(IntegrityCheck check) const { return m_checks.test(size_t(check)); }
+
+      // Only the first failure of the first failing check is reported, so a
+      // check may stop as soon as it cannot find an earlier one.
+      bool isNeeded(IntegrityCheck check, uint64_t position) const
+      {
+        if (!isRun(check)) {
+          return false;
+        }
+        for (size_t c = 0; c < size_t(check); ++c) {
+          if (m_firstFailures[c] != NO_FAILURE) {
+            return false;
+          }
+        }
+        return position < m_firstFailures[size_t(check)];
+      }
+
+      void fail(IntegrityCheck check, uint64_t position, const std::string& message)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (position < m_firstFailures[size_t(check)]) {
+          m_firstFailures[size_t(check)] = position;
+          m_messages[size_t(check)] = message;
+        }
+      }
+
+      // Prints the first failure, if any. Returns true if all the checks passed.
+      bool print() const
+      {
+        for (size_t c = 0; c < m_checks.size(); ++c) {
+          if (m_firstFailures[c] != NO_FAILURE) {
+            std::cerr << m_messages[c] << std::endl;
+            return false;
+          }
+        }
+        return true;
+      }
+
+    private:
+      static const uint64_t NO_FAILURE = UINT64_MAX;
+
+      const FileImpl::IntegrityChecks m_checks;
+      std::atomic<uint64_t> m_firstFailures[size_t(IntegrityCheck::CLUSTER_DATA) + 1];
+      std::string m_messages[size_t(IntegrityCheck::CLUSTER_DATA) + 1];
+      std::mutex m_mutex;
+  };
+
+  bool FileImpl::checkIntegrity(const IntegrityChecks& checks, unsigned nbThreads) {
+    IntegrityReport report(checks);
+
+    // The checks are split in tasks, run in this order by the threads.
+    std::vector<std::function<void()>> tasks;
+    if (report.isRun(IntegrityCheck::CHECKSUM)) {
+      tasks.push_back([this, &report]() {
+        if (!verify()) {
+          report.fail(IntegrityCheck::CHECKSUM, 0, "Checksum doesn't match");
+        }
+      });
     }
-    return true;
+
+    const uint64_t articleCount = getCountArticles().v;
+    if (report.isRun(IntegrityCheck::DIRENT_PTRS)
+     || report.isRun(IntegrityCheck::DIRENT_ORDER)
+     || report.isRun(IntegrityCheck::DIRENT_MIMETYPES)) {
+      for (uint64_t begin = 0; begin < articleCount; begin += CHECK_ENTRIES_PER_TASK) {
+        const uint64_t end = std::min(articleCount, begin + CHECK_ENTRIES_PER_TASK);
+        tasks.push_back([this, &report, begin, end]() {
+          checkDirents(report, entry_index_type(begin), entry_index_type(end));
+        });
+      }
+    }
+
+    std::vector<std::unique_ptr<IndirectDirentAccessor>> titleListings;
+    if (report.isRun(IntegrityCheck::TITLE_INDEX)) {
+      try {
+        offset_t titleOffset(header.getTitleIdxPos());
+        zsize_t  titleSize(sizeof(entry_index_type)*header.getArticleCount());
+        titleListings.push_back(getTitleAccessor(titleOffset, titleSize, "Full Title index table"));
+        auto titleListing = getTitleAccessor("listing/titleOrdered/v1");
+        if (titleListing) {
+          titleListings.push_back(std::move(titleListing));
+        }
+      } catch (ZimFileFormatError& e) {
+        report.fail(IntegrityCheck::TITLE_INDEX, 0, e.what());
+        titleListings.clear();
+      }
+      // The listings are checked one after the other.
+      uint64_t firstPosition = 0;
+      for (const auto& titleListing: titleListings) {
+        const IndirectDirentAccessor* listing = titleListing.get();
+        const uint64_t direntCount = listing->getDirentCount().v;
+        for (uint64_t begin = 0; begin < direntCount; begin += CHECK_ENTRIES_PER_TASK) {
+          const uint64_t end = std::min(direntCount, begin + CHECK_ENTRIES_PER_TASK);
+          tasks.push_back([this, &report, listing, firstPosition, begin, end]() {
+            checkTitleListing(report, *listing, firstPosition, entry_index_type(begin), entry_index_type(end));
+          });
+        }
+        firstPosition += direntCount;
+      }
+    }
+
+    const uint64_t clusterCount = getCountClusters().v;
+    if (report.isRun(IntegrityCheck::CLUSTER_PTRS)) {
+      for (uint64_t begin = 0; begin < clusterCount; begin += CHECK_ENTRIES_PER_TASK) {
+        const uint64_t end = std::min(clusterCount, begin + CHECK_ENTRIES_PER_TASK);
+        tasks.push_back([this, &report, begin, end]() {
+          checkClusterPtrs(report, cluster_index_type(begin), cluster_index_type(end));
+        });
+      }
+    }
+
+    if (report.isRun(IntegrityCheck::CLUSTER_DATA)) {
+      for (uint64_t begin = 0; begin < clusterCount; begin += CHECK_CLUSTERS_PER_TASK) {
+        const uint64_t end = std::min(clusterCount, begin + CHECK_CLUSTERS_PER_TASK);
+        tasks.push_back([this, &report, begin, end]() {
+          checkClusterData(report, cluster_index_type(begin), cluster_index_type(end));
+        });
+      }
+    }
+
+    if (nbThreads == 0) {
+      nbThreads = std::thread::hardware_concurrency();
+    }
+    nbThreads = std::max<size_t>(1, std::min<size_t>(nbThreads, tasks.size()));
+
+    std::atomic<size_t> nextTask(0);
+    const auto worker = [&]() {
+      for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+        tasks[i]();
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nbThreads; ++t) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread: threads) {
+      thread.join();
+    }
+    return report.print();
   }
 
-  bool FileImpl::checkDirentPtrs() {
-    const entry_index_type articleCount = getCountArticles().v;
+  void FileImpl::checkDirents(IntegrityReport& report, entry_index_type begin, entry_index_type end) const {
     const offset_t validDirentRangeStart(80); // XXX: really???
     const offset_t validDirentRangeEnd = header.hasChecksum()
                                        ? offset_t(header.getChecksumPos())
                                        : offset_t(zimReader->size().v);
     const zsize_t direntMinSize(11);
-    for ( entry_index_type i = 0; i < articleCount; ++i )
+    // A dirent that cannot be read fails the first check that reads it.
+    const IntegrityCheck readCheck = report.isRun(IntegrityCheck::DIRENT_ORDER)
+                                   ? IntegrityCheck::DIRENT_ORDER
+                                   : IntegrityCheck::DIRENT_MIMETYPES;
+
+    // The first dirent is compared with the last one of the previous task.
+    std::shared_ptr<const Dirent> prevDirent;
+    for ( entry_index_type i = (begin == 0 ? 0 : begin - 1); i < end; ++i )
     {
+      const entry_index_type position = std::max(i, begin);
+      const bool ownEntry = (i >= begin);
+      const bool checkPtr = ownEntry && report.isNeeded(IntegrityCheck::DIRENT_PTRS, position);
+      const bool checkOrder = report.isNeeded(IntegrityCheck::DIRENT_ORDER, position);
+      const bool checkMimeType = ownEntry && report.isNeeded(IntegrityCheck::DIRENT_MIMETYPES, position);
+      if ( ownEntry && !checkPtr && !checkOrder && !checkMimeType ) {
+        break;
+      }
+
       const auto offset = mp_urlDirentAccessor->getOffset(entry_index_t(i));
       if ( offset < validDirentRangeStart ||
            offset + direntMinSize > validDirentRangeEnd ) {
-        std::cerr << "Invalid dirent pointer" << std::endl;
-        return false;
+        if ( checkPtr ) {
+          report.fail(IntegrityCheck::DIRENT_PTRS, i, "Invalid dirent pointer");
+        }
+        prevDirent.reset();
+        continue;
+      }
+      if ( !checkOrder && !checkMimeType ) {
+        continue;
       }
-    }
-    return true;
-  }
 
-  bool FileImpl::checkDirentOrder() {
-    const entry_index_type articleCount = getCountArticles().v;
-    std::shared_ptr<const Dirent> prevDirent;
-    for ( entry_index_type i = 0; i < articleCount; ++i )
-    {
-      const std::shared_ptr<const Dirent> dirent = mp_urlDirentAccessor->getDirent(entry_index_t(i));
-      if ( prevDirent && !(prevDirent->getLongUrl() < dirent->getLongUrl()) )
+      std::shared_ptr<const Dirent> dirent;
+      try {
+        dirent = direntReader->readDirent(offset);
+      } catch (std::exception& e) {
+        if ( ownEntry ) {
+          std::ostringstream msg;
+          msg << "Invalid dirent #" << i << ": " << e.what();
+          report.fail(readCheck, i, msg.str());
+        }
+        prevDirent.reset();
+        continue;
+      }
+
+      if ( ownEntry && checkOrder && prevDirent && !(prevDirent->getLongUrl() < dirent->getLongUrl()) )
       {
-        std::cerr << "Dirent table is not properly sorted:\n"
-                  << "  #" << i-1 << ": " << prevDirent->getLongUrl() << "\n"
-                  << "  #" << i   << ": " << dirent->getLongUrl() << std::endl;
-        return false;
+        std::ostringstream msg;
+        msg << "Dirent table is not properly sorted:\n"
+            << "  #" << i-1 << ": " << prevDirent->getLongUrl() << "\n"
+            << "  #" << i   << ": " << dirent->getLongUrl();
+        report.fail(IntegrityCheck::DIRENT_ORDER, i, msg.str());
+      }
+      if ( checkMimeType && dirent->isArticle() && dirent->getMimeType() >= getMimeTypes().size() ) {
+        std::ostringstream msg;
+        msg << "Entry " << dirent->getLongUrl()
+            << " has invalid MIME-type value " << dirent->getMimeType()
+            << ".";
+        report.fail(IntegrityCheck::DIRENT_MIMETYPES, i, msg.str());
       }
       prevDirent = dirent;
     }
-    return true;
   }
 
-  bool FileImpl::checkClusterPtrs() {
-    const cluster_index_type clusterCount = getCountClusters().v;
+  bool FileImpl::isValidClusterOffset(offset_t offset) const {
     const offset_t validClusterRangeStart(80); // XXX: really???
     const offset_t validClusterRangeEnd = header.hasChecksum()
                                        ? offset_t(header.getChecksumPos())
                                        : offset_t(zimReader->size().v);
     const zsize_t clusterMinSize(1); // XXX
-    for ( cluster_index_type i = 0; i < clusterCount; ++i )
+    return offset >= validClusterRangeStart &&
+           offset + clusterMinSize <= validClusterRangeEnd;
+  }
+
+  void FileImpl::checkClusterPtrs(IntegrityReport& report, cluster_index_type begin, cluster_index_type end) const {
+    for ( cluster_index_type i = begin; i < end; ++i )
     {
-      const auto offset = readOffset(*clusterOffsetReader, i);
-      if ( offset < validClusterRangeStart ||
-           offset + clusterMinSize > validClusterRangeEnd ) {
-        std::cerr << "Invalid cluster pointer" << std::endl;
-        return false;
+      if ( !report.isNeeded(IntegrityCheck::CLUSTER_PTRS, i) ) {
+        break;
+      }
+      if ( !isValidClusterOffset(readOffset(*clusterOffsetReader, i)) ) {
+        report.fail(IntegrityCheck::CLUSTER_PTRS, i, "Invalid cluster pointer");
+      }
+    }
+  }
+
+  void FileImpl::checkClusterData(IntegrityReport& report, cluster_index_type begin, cluster_index_type end) {
+    for ( cluster_index_type i = begin; i < end; ++i )
+    {
+      if ( !report.isNeeded(IntegrityCheck::CLUSTER_DATA, i) ) {
+        break;
+      }
+      if ( !isValidClusterOffset(getClusterOffset(cluster_index_t(i))) ) {
+        // Reported by the CLUSTER_PTRS check
+        continue;
+      }
+      try {
+        // Read outside of the cluster cache: each cluster is only read once.
+        const auto cluster = readCluster(cluster_index_t(i));
+        for ( blob_index_type b = 0; b < cluster->count().v; ++b ) {
+          cluster->getBlob(blob_index_t(b));
+        }
+      } catch (std::exception& e) {
+        std::ostringstream msg;
+        msg << "Cluster #" << i << " is invalid: " << e.what();
+        report.fail(IntegrityCheck::CLUSTER_DATA, i, msg.str());
       }
     }
-    return true;
   }
 
 namespace
@@ -618,55 +1489,50 @@ std::string pseudoTitle(const Dirent& d)
   return std::string(1, d.getNamespace()) + '/' + d.getTitle();
 }
 
-bool checkTitleListing(const IndirectDirentAccessor& accessor, entry_index_type totalCount) {
-  const entry_index_type direntCount = accessor.getDirentCount().v;
-  std::shared_ptr<const Dirent> prevDirent;
-  for ( entry_index_type i = 0; i < direntCount; ++i ) {
-    if (accessor.getDirectIndex(title_index_t(i)).v >= totalCount) {
-      std::cerr << "Invalid title index entry." << std::endl;
-      return false;
-    }
-
-    const std::shared_ptr<const Dirent> dirent = accessor.getDirent(title_index_t(i));
-    if ( prevDirent && !(pseudoTitle(*prevDirent) <= pseudoTitle(*dirent)) ) {
-      std::cerr << "Title index is not properly sorted." << std::endl;
-      return false;
-    }
-    prevDirent = dirent;
-  }
-  return true;
-}
-
 } // unnamed namespace
 
-  bool FileImpl::checkTitleIndex() {
+  void FileImpl::checkTitleListing(IntegrityReport& report, const IndirectDirentAccessor& listing,
+                                   uint64_t firstPosition, entry_index_type begin, entry_index_type end) const {
     const entry_index_type articleCount = getCountArticles().v;
+    // The first title is compared with the last one of the previous task.
+    std::string prevTitle;
+    bool hasPrevTitle = false;
+    for ( entry_index_type i = (begin == 0 ? 0 : begin - 1); i < end; ++i ) {
+      const uint64_t position = firstPosition + std::max(i, begin);
+      const bool ownEntry = (i >= begin);
+      if ( !report.isNeeded(IntegrityCheck::TITLE_INDEX, position) ) {
+        break;
+      }
 
-    offset_t titleOffset(header.getTitleIdxPos());
-    zsize_t  titleSize(sizeof(entry_index_type)*header.getArticleCount());
-    auto titleDirentAccessor = getTitleAccessor(titleOffset, titleSize, "Full Title index table");
-    auto ret = checkTitleListing(*titleDirentAccessor, articleCount);
+      const entry_index_type direntIndex = listing.getDirectIndex(title_index_t(i)).v;
+      if (direntIndex >= articleCount) {
+        if ( ownEntry ) {
+          report.fail(IntegrityCheck::TITLE_INDEX, position, "Invalid title index entry.");
+        }
+        hasPrevTitle = false;
+        continue;
+      }
 
-    titleDirentAccessor = getTitleAccessor("listing/titleOrdered/v1");
-    if (titleDirentAccessor) {
-      ret &= checkTitleListing(*titleDirentAccessor, articleCount);
-    }
-    return ret;
-  }
+      std::string title;
+      try {
+        const auto offset = mp_urlDirentAccessor->getOffset(entry_index_t(direntIndex));
+        title = pseudoTitle(*direntReader->readDirent(offset));
+      } catch (std::exception& e) {
+        if ( ownEntry ) {
+          std::ostringstream msg;
+          msg << "Invalid dirent #" << direntIndex << ": " << e.what();
+          report.fail(IntegrityCheck::TITLE_INDEX, position, msg.str());
+        }
+        hasPrevTitle = false;
+        continue;
+      }
 
-  bool FileImpl::checkDirentMimeTypes() {
-    const entry_index_type articleCount = getCountArticles().v;
-    for ( entry_index_type i = 0; i < articleCount; ++i )
-    {
-      const auto dirent = mp_urlDirentAccessor->getDirent(entry_index_t(i));
-      if ( dirent->isArticle() && dirent->getMimeType() >= mimeTypes.size() ) {
-        std::cerr << "Entry " << dirent->getLongUrl()
-                  << " has invalid MIME-type value " << dirent->getMimeType()
-                  << "." << std::endl;
-        return false;
+      if ( ownEntry && hasPrevTitle && !(prevTitle <= title) ) {
+        report.fail(IntegrityCheck::TITLE_INDEX, position, "Title index is not properly sorted.");
       }
+      prevTitle = std::move(title);
+      hasPrevTitle = true;
     }
-    return true;
   }
 
 }
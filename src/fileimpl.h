@@ -24,6 +24,8 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
+#include <bitset>
 #include <zim/zim.h>
 #include <mutex>
 #include "lrucache.h"
@@ -38,10 +40,13 @@
 #include "fileheader.h"
 #include "zim_types.h"
 #include "direntreader.h"
+#include "prefetcher.h"
 
 
 namespace zim
 {
+  class IntegrityReport;
+
   class FileImpl
   {
       std::shared_ptr<FileCompound> zimFile;
@@ -51,37 +56,73 @@ namespace zim
       Fileheader header;
 
       std::unique_ptr<const Reader> clusterOffsetReader;
+      // The cluster offsets in increasing order: the clusters are not
+      // necessarily stored in the order of their index.
+      mutable std::once_flag m_sortedClusterOffsetsOnceFlag;
+      mutable std::vector<offset_type> m_sortedClusterOffsets;
 
       std::shared_ptr<const DirectDirentAccessor> mp_urlDirentAccessor;
-      std::unique_ptr<const IndirectDirentAccessor> mp_titleDirentAccessor;
+      mutable std::once_flag m_titleDirentAccessorOnceFlag;
+      mutable std::unique_ptr<const IndirectDirentAccessor> mp_titleDirentAccessor;
 
       typedef std::shared_ptr<const Cluster> ClusterHandle;
-      ConcurrentCache<cluster_index_type, ClusterHandle> clusterCache;
+
+      // The cluster cache is sized in bytes of decompressed data, the budget
+      // being shared by its shards (a big cluster may take all of it).
+      struct ClusterMemorySize
+      {
+        static size_t cost(const ClusterHandle& cluster) { return cluster->getMemorySize(); }
+      };
+      ConcurrentCache<cluster_index_type, ClusterHandle, ClusterMemorySize> clusterCache;
+      // The compressed clusters up to this size are decoded at once
+      // (see Cluster::read()). 0, the default, decodes them on demand.
+      const zsize_t m_clusterDecodeSize;
 
       const bool m_newNamespaceScheme;
-      const entry_index_t m_startUserEntry;
-      const entry_index_t m_endUserEntry;
+      mutable std::once_flag m_userEntryRangeOnceFlag;
+      mutable entry_index_t m_startUserEntry;
+      mutable entry_index_t m_endUserEntry;
 
       typedef std::vector<std::string> MimeTypes;
-      MimeTypes mimeTypes;
+      mutable std::once_flag m_mimeTypesOnceFlag;
+      mutable MimeTypes mimeTypes;
 
       using pair_type = std::pair<cluster_index_type, entry_index_type>;
       mutable std::vector<pair_type> articleListByCluster;
       mutable std::once_flag orderOnceFlag;
+      // The X/listing/clusterOrdered/v0 item. If it is missing (or invalid),
+      // articleListByCluster is built from the dirents.
+      mutable std::unique_ptr<const Reader> mp_clusterOrderListing;
 
       using DirentLookup = zim::DirentLookup<DirectDirentAccessor>;
-      mutable std::unique_ptr<DirentLookup> m_direntLookup;
+      std::once_flag m_direntLookupOnceFlag;
+      std::unique_ptr<DirentLookup> m_direntLookup;
+
+      // The lookup grid of the title index, built by the first lookup by title.
+      std::once_flag m_titleLookupGridOnceFlag;
+      std::unique_ptr<const NarrowDown> mp_titleLookupGrid;
+
+      // Declared last: its threads must be stopped before the other
+      // members are destroyed.
+      Prefetcher prefetcher;
 
     public:
       using FindxResult = std::pair<bool, entry_index_t>;
+      using FindxKey = std::pair<char, std::string>;
+      using ItemVisitor = std::function<void(entry_index_t, const Blob&)>;
+      using ProgressCallback = std::function<void(size_type done, size_type total)>;
       using FindxTitleResult = std::pair<bool, title_index_t>;
 
-      explicit FileImpl(const std::string& fname);
+      explicit FileImpl(const std::string& fname, OpenMode mode = OpenMode::EAGER);
 #ifndef _WIN32
-      explicit FileImpl(int fd);
-      FileImpl(int fd, offset_t offset, zsize_t size);
+      explicit FileImpl(int fd, OpenMode mode = OpenMode::EAGER);
+      FileImpl(int fd, offset_t offset, zsize_t size, OpenMode mode = OpenMode::EAGER);
 #endif
 
+      // Reads (once) all the parts of the archive which are otherwise read
+      // on first use.
+      void load();
+
       offset_t getArchiveStartOffset() const { return archiveStartOffset; }
       time_t getMTime() const;
 
@@ -95,13 +136,28 @@ namespace zim
       std::shared_ptr<const Dirent> getDirentByTitle(title_index_t idx);
       entry_index_t getIndexByTitle(title_index_t idx) const;
       entry_index_t getIndexByClusterOrder(entry_index_t idx) const;
+      // Calls visitor for all the user items, from nbThreads threads, each
+      // thread reading whole clusters (without using the cluster cache).
+      void forEachItem(const ItemVisitor& visitor, unsigned nbThreads);
       entry_index_t getCountArticles() const { return entry_index_t(header.getArticleCount()); }
 
       FindxResult findx(char ns, const std::string& url);
       FindxResult findx(const std::string& url);
+      std::vector<FindxResult> findx(const std::vector<FindxKey>& keys);
       FindxTitleResult findxByTitle(char ns, const std::string& title);
 
       std::shared_ptr<const Cluster> getCluster(cluster_index_t idx);
+      size_t getClusterCacheMaxSize() const { return clusterCache.maxCost(); }
+      size_t getClusterCacheCurrentSize() const { return clusterCache.cost(); }
+      void setClusterCacheMaxSize(size_t nbBytes) { clusterCache.setMaxCost(nbBytes); }
+
+      // Runs a task in the background threads of the archive.
+      void addPrefetchTask(Prefetcher::Task task) { prefetcher.add(std::move(task)); }
+      void waitPrefetchTasks() { prefetcher.wait(); }
+      // Asks the system to read the clusters of the entries (following the
+      // redirections) and, if decompress is true, puts them in the cluster cache.
+      void prefetchEntries(const std::vector<entry_index_t>& indexes, bool decompress);
+      void preloadDirents() { mp_urlDirentAccessor->preload(); }
       cluster_index_t getCountClusters() const       { return cluster_index_t(header.getClusterCount()); }
       offset_t getClusterOffset(cluster_index_t idx) const;
       offset_t getBlobOffset(cluster_index_t clusterIdx, blob_index_t blobIdx);
@@ -109,38 +165,66 @@ namespace zim
       entry_index_t getNamespaceBeginOffset(char ch);
       entry_index_t getNamespaceEndOffset(char ch);
 
-      entry_index_t getStartUserEntry() const { return m_startUserEntry; }
-      entry_index_t getEndUserEntry() const { return m_endUserEntry; }
-      entry_index_t getUserEntryCount() const { return m_endUserEntry - m_startUserEntry; }
+      entry_index_t getStartUserEntry() const { readUserEntryRange(); return m_startUserEntry; }
+      entry_index_t getEndUserEntry() const { readUserEntryRange(); return m_endUserEntry; }
+      entry_index_t getUserEntryCount() const { readUserEntryRange(); return m_endUserEntry - m_startUserEntry; }
 
       bool hasNamespace(char ch) const;
 
       const std::string& getMimeType(uint16_t idx) const;
 
       std::string getChecksum();
-      bool verify();
+      bool verify(const ProgressCallback& progress = ProgressCallback());
       bool is_multiPart() const;
 
-      bool checkIntegrity(IntegrityCheck checkType);
+      // All the checks, including the ones which are not part of
+      // IntegrityCheckList.
+      typedef std::bitset<size_t(IntegrityCheck::CLUSTER_DATA) + 1> IntegrityChecks;
+
+      bool checkIntegrity(IntegrityCheck checkType, unsigned nbThreads = 1);
+      // Runs the checks from nbThreads threads and prints the first failure.
+      bool checkIntegrity(const IntegrityChecks& checks, unsigned nbThreads);
   private:
-      explicit FileImpl(std::shared_ptr<FileCompound> zimFile);
-      FileImpl(std::shared_ptr<FileCompound> zimFile, offset_t offset, zsize_t size);
+      FileImpl(std::shared_ptr<FileCompound> zimFile, OpenMode mode);
+      FileImpl(std::shared_ptr<FileCompound> zimFile, offset_t offset, zsize_t size, OpenMode mode);
 
+      // Gets the location of the data of the item X/<path>, found with
+      // `lookup`. Returns false if there is no such item or if its data is
+      // compressed.
+      bool getUncompressedXItemData(DirentLookup& lookup, const std::string& path, offset_t& offset, zsize_t& size);
       std::unique_ptr<IndirectDirentAccessor> getTitleAccessor(const std::string& path);
       std::unique_ptr<IndirectDirentAccessor> getTitleAccessor(const offset_t offset, const zsize_t size, const std::string& name);
 
+      // The parts of the archive read on first use.
+      const IndirectDirentAccessor& titleDirentAccessor() const;
+      const MimeTypes& getMimeTypes() const;
+      void readUserEntryRange() const;
       DirentLookup& direntLookup();
+      std::unique_ptr<DirentLookup> readStoredDirentLookup();
+      const NarrowDown* titleLookupGrid();
       ClusterHandle readCluster(cluster_index_t idx);
+      bool readItemLocation(entry_index_t idx, cluster_index_type& clusterNumber, blob_index_type& blobNumber) const;
+      zsize_t getMaxClusterSize(cluster_index_t idx) const;
+      const std::vector<offset_type>& getSortedClusterOffsets() const;
+      void readAheadCluster(cluster_index_t idx);
+      // Reads the (compressed) clusters with a single batch of reads and puts
+      // them in the cache.
+      void readClusterBatch(const std::vector<cluster_index_type>& clusters);
       offset_type getMimeListEndUpperLimit() const;
-      void readMimeTypes();
+      void readMimeTypes() const;
+      void readPathHashIndex(DirentLookup& lookup);
+      void readClusterOrderListing();
+      bool isValidClusterOrderListing() const;
+      void prepareArticleListByCluster() const;
       void quickCheckForCorruptFile();
 
-      bool checkChecksum();
-      bool checkDirentPtrs();
-      bool checkDirentOrder();
-      bool checkTitleIndex();
-      bool checkClusterPtrs();
-      bool checkDirentMimeTypes();
+      // Each of these checks the items [begin, end) of a table.
+      void checkDirents(IntegrityReport& report, entry_index_type begin, entry_index_type end) const;
+      void checkTitleListing(IntegrityReport& report, const IndirectDirentAccessor& listing,
+                             uint64_t firstPosition, entry_index_type begin, entry_index_type end) const;
+      void checkClusterPtrs(IntegrityReport& report, cluster_index_type begin, cluster_index_type end) const;
+      void checkClusterData(IntegrityReport& report, cluster_index_type begin, cluster_index_type end);
+      bool isValidClusterOffset(offset_t offset) const;
   };
 
 }
@@ -20,6 +20,7 @@
 #include "fs_unix.h"
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
 #include <sstream>
 
 #include <sys/types.h>
@@ -29,11 +30,177 @@
 #include <dirent.h>
 #include <errno.h>
 
+#include "config.h"
+
+#ifdef ENABLE_IO_URING
+# include <liburing.h>
+#endif
+
 namespace zim
 {
 
 namespace unix {
 
+#ifdef ENABLE_IO_URING
+namespace
+{
+
+// Number of reads submitted at once to a ring.
+const unsigned IO_URING_ENTRIES = 64;
+// Bigger reads are split, the end being read with pread.
+const size_type MAX_IO_URING_READ_SIZE = 1 << 30;
+
+// An io_uring instance, used by one thread.
+// If the system doesn't allow io_uring (old kernel, seccomp...), the ring
+// is not usable and the reads are done with pread.
+class IoUring
+{
+  public:
+    IoUring()
+      : m_usable(io_uring_queue_init(IO_URING_ENTRIES, &m_ring, 0) == 0),
+        m_initialized(m_usable)
+    {}
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring()
+    {
+      close();
+    }
+
+    bool usable() const { return m_usable; }
+    void disable() { m_usable = false; }
+    // Tears down the ring. No read must be in flight anymore.
+    void close()
+    {
+      m_usable = false;
+      if (m_initialized) {
+        io_uring_queue_exit(&m_ring);
+        m_initialized = false;
+      }
+    }
+    struct io_uring* get() { return &m_ring; }
+
+  private:
+    struct io_uring m_ring;
+    bool m_usable;
+    bool m_initialized;
+};
+
+// Submits the SQEs queued in the ring. Returns the number of SQEs taken by
+// the kernel (each one will give a CQE).
+unsigned submitQueued(struct io_uring* r)
+{
+  int ret;
+  do {
+    ret = io_uring_submit(r);
+  } while (ret == -EINTR);
+  return ret > 0 ? ret : 0;
+}
+
+// Cancels the submitted reads which are not completed yet. Returns the
+// number of SQEs taken by the kernel (the completions to wait for).
+unsigned cancelReads(struct io_uring* r, const FS::ReadRequest* begin,
+                     const std::vector<bool>& completed, unsigned submitted)
+{
+  for (unsigned i = 0; i < submitted; ++i) {
+    if (completed[i]) {
+      continue;
+    }
+    struct io_uring_sqe* sqe = io_uring_get_sqe(r);
+    if (!sqe) {
+      break;
+    }
+    io_uring_prep_cancel(sqe, const_cast<FS::ReadRequest*>(begin + i), 0);
+    io_uring_sqe_set_data(sqe, nullptr);
+  }
+  return submitQueued(r);
+}
+
+// Reads at most IO_URING_ENTRIES requests with io_uring.
+// The reads io_uring fails to do (or only does partly) are finished with pread.
+bool readWithIoUring(IoUring& ring, const FS::ReadRequest* begin, const FS::ReadRequest* end)
+{
+  struct io_uring* r = ring.get();
+  const unsigned count = end - begin;
+  std::vector<struct io_uring_sqe*> sqes;
+  sqes.reserve(count);
+  for (auto request = begin; request != end; ++request) {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(r);
+    const auto size = std::min(request->size.v, MAX_IO_URING_READ_SIZE);
+    io_uring_prep_read(sqe, request->fd->getNativeHandle(), request->dest, size, request->offset.v);
+    io_uring_sqe_set_data(sqe, const_cast<FS::ReadRequest*>(request));
+    sqes.push_back(sqe);
+  }
+
+  unsigned submitted = 0;
+  while (submitted < count) {
+    const unsigned ret = submitQueued(r);
+    if (ret == 0) {
+      // The SQEs not taken by the kernel stay in the submission queue:
+      // they are turned into no-ops, which must not read into the buffers
+      // of the caller if they are submitted later on.
+      for (unsigned i = submitted; i < count; ++i) {
+        io_uring_prep_nop(sqes[i]);
+        io_uring_sqe_set_data(sqes[i], nullptr);
+      }
+      ring.disable();
+      break;
+    }
+    submitted += ret;
+  }
+
+  // All the CQEs must be reaped before returning: the reads in flight still
+  // write to the buffers of the caller.
+  std::vector<size_type> readSizes(count, 0);
+  std::vector<bool> completed(count, false);
+  unsigned pending = submitted;
+  bool cancelled = false;
+  while (pending > 0) {
+    struct io_uring_cqe* cqe;
+    const int ret = io_uring_wait_cqe(r, &cqe);
+    if (ret == -EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      // The reads not completed yet are cancelled (and read with pread),
+      // their CQEs are still waited for.
+      if (!cancelled) {
+        pending += cancelReads(r, begin, completed, submitted);
+        cancelled = true;
+        ring.disable();
+      }
+      continue;
+    }
+    // The CQEs of the cancellations (and no-ops) have no request.
+    const auto request = static_cast<const FS::ReadRequest*>(io_uring_cqe_get_data(cqe));
+    if (request) {
+      completed[request - begin] = true;
+      if (cqe->res > 0) {
+        readSizes[request - begin] = cqe->res;
+      }
+    }
+    io_uring_cqe_seen(r, cqe);
+    --pending;
+  }
+  if (!ring.usable()) {
+    ring.close();
+  }
+
+  for (auto request = begin; request != end; ++request) {
+    const zsize_t readSize(readSizes[request - begin]);
+    if (readSize < request->size) {
+      const zsize_t remaining = request->size - readSize;
+      if (request->fd->readAt(request->dest + readSize.v, remaining, request->offset + readSize) != remaining) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // unnamed namespace
+#endif // ENABLE_IO_URING
+
 zsize_t FD::readAt(char* dest, zsize_t size, offset_t offset) const
 {
 #if defined(__APPLE__) || defined(__OpenBSD__) || defined(__FreeBSD__)
@@ -58,6 +225,19 @@ zsize_t FD::readAt(char* dest, zsize_t size, offset_t offset) const
 #undef PREAD
 }
 
+void FD::readAhead(offset_t offset, zsize_t size) const
+{
+  // Only a hint to the kernel, errors are ignored.
+#if defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(m_fd, offset.v, size.v, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+  struct radvisory advice;
+  advice.ra_offset = offset.v;
+  advice.ra_count = size.v;
+  fcntl(m_fd, F_RDADVISE, &advice);
+#endif
+}
+
 zsize_t FD::getSize() const
 {
   struct stat sb;
@@ -65,6 +245,15 @@ zsize_t FD::getSize() const
   return zsize_t(sb.st_size);
 }
 
+FD::FileId FD::getFileId() const
+{
+  struct stat sb;
+  if (fstat(m_fd, &sb) != 0) {
+    return FileId{0, 0};
+  }
+  return FileId{uint64_t(sb.st_dev), uint64_t(sb.st_ino)};
+}
+
 bool FD::seek(offset_t offset)
 {
     return static_cast<int64_t>(offset.v) == lseek(m_fd, offset.v, SEEK_SET);
@@ -132,6 +321,29 @@ bool FS::removeFile(path_t path) {
   return ::remove(path.c_str());
 }
 
+bool FS::readBatch(const std::vector<ReadRequest>& requests)
+{
+  size_t done = 0;
+#ifdef ENABLE_IO_URING
+  // Set up at the first batch of the thread.
+  thread_local IoUring ring;
+  while (done < requests.size() && ring.usable()) {
+    const size_t count = std::min<size_t>(IO_URING_ENTRIES, requests.size() - done);
+    if (!readWithIoUring(ring, requests.data() + done, requests.data() + done + count)) {
+      return false;
+    }
+    done += count;
+  }
+#endif
+  for (; done < requests.size(); ++done) {
+    const auto& request = requests[done];
+    if (request.fd->readAt(request.dest, request.size, request.offset) != request.size) {
+      return false;
+    }
+  }
+  return true;
+}
+
 
 }; // unix namespace
 
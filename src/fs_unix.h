@@ -22,7 +22,9 @@
 
 #include "zim_types.h"
 
+#include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -40,6 +42,15 @@ class FD {
   public:
     using fd_t = int;
 
+    // Identifies a file (as long as it exists), to check that a path
+    // still names the file opened before.
+    struct FileId {
+      uint64_t device;
+      uint64_t index;
+      bool operator==(const FileId& o) const { return device == o.device && index == o.index; }
+      bool operator!=(const FileId& o) const { return !(*this == o); }
+    };
+
   private:
     fd_t m_fd = -1;
 
@@ -57,7 +68,9 @@ class FD {
     }
     ~FD() { close(); }
     zsize_t readAt(char* dest, zsize_t size, offset_t offset) const;
+    void    readAhead(offset_t offset, zsize_t size) const;
     zsize_t getSize() const;
+    FileId  getFileId() const;
     fd_t    getNativeHandle() const
     {
         return m_fd;
@@ -74,6 +87,13 @@ class FD {
 
 struct FS {
     using FD = zim::unix::FD;
+    // A read of `size` bytes at `offset` in `fd`, done by readBatch().
+    struct ReadRequest {
+      const FD* fd;
+      char* dest;
+      offset_t offset;
+      zsize_t size;
+    };
     static std::string join(path_t base, path_t name);
     static FD    openFile(path_t filepath);
     static bool  makeDirectory(path_t path);
@@ -81,6 +101,9 @@ struct FS {
     static bool  remove(path_t path);
     static bool  removeDir(path_t path);
     static bool  removeFile(path_t path);
+    // Submits all the reads at once (with io_uring when available).
+    // Returns false (with errno set) if a read fails.
+    static bool  readBatch(const std::vector<ReadRequest>& requests);
 };
 
 }; // unix namespace
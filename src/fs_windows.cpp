@@ -100,6 +100,11 @@ bool FD::seek(offset_t offset)
   return SetFilePointerEx(mp_impl->m_handle, off, NULL, FILE_BEGIN);
 }
 
+void FD::readAhead(offset_t offset, zsize_t size) const
+{
+  // No read ahead hint on Windows, the data will be read when needed.
+}
+
 zsize_t FD::getSize() const
 {
   if(!mp_impl)
@@ -111,6 +116,15 @@ zsize_t FD::getSize() const
   return zsize_t(size.QuadPart);
 }
 
+FD::FileId FD::getFileId() const
+{
+  BY_HANDLE_FILE_INFORMATION info;
+  if(!mp_impl || !GetFileInformationByHandle(mp_impl->m_handle, &info))
+    return FileId{0, 0};
+  return FileId{info.dwVolumeSerialNumber,
+                (uint64_t(info.nFileIndexHigh) << 32) | info.nFileIndexLow};
+}
+
 int FD::release()
 {
   if(!mp_impl)
@@ -195,6 +209,17 @@ bool FS::removeFile(path_t path)
   return DeleteFileW(toWideChar(path).get());
 }
 
+bool FS::readBatch(const std::vector<ReadRequest>& requests)
+{
+  // No batched reads on Windows, the requests are read one by one.
+  for (const auto& request: requests) {
+    if (request.fd->readAt(request.dest, request.size, request.offset) != request.size) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }; // windows namespace
 
 }; // zim namespace
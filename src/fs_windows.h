@@ -22,8 +22,10 @@
 
 #include "zim_types.h"
 
+#include <cstdint>
 #include <stdexcept>
 #include <memory>
+#include <vector>
 
 typedef void* HANDLE;
 
@@ -38,6 +40,15 @@ struct ImplFD;
 class FD {
   public:
     typedef HANDLE fd_t;
+
+    // Identifies a file (as long as it exists), to check that a path
+    // still names the file opened before.
+    struct FileId {
+      uint64_t device;
+      uint64_t index;
+      bool operator==(const FileId& o) const { return device == o.device && index == o.index; }
+      bool operator!=(const FileId& o) const { return !(*this == o); }
+    };
   private:
     std::unique_ptr<ImplFD> mp_impl;
 
@@ -50,7 +61,9 @@ class FD {
     FD& operator=(const FD& o) = delete;
     ~FD();
     zsize_t readAt(char* dest, zsize_t size, offset_t offset) const;
+    void    readAhead(offset_t offset, zsize_t size) const;
     zsize_t getSize() const;
+    FileId  getFileId() const;
     int     release();
     bool    seek(offset_t offset);
     bool    close();
@@ -58,6 +71,13 @@ class FD {
 
 struct FS {
     using FD = zim::windows::FD;
+    // A read of `size` bytes at `offset` in `fd`, done by readBatch().
+    struct ReadRequest {
+      const FD* fd;
+      char* dest;
+      offset_t offset;
+      zsize_t size;
+    };
     static std::string join(path_t base, path_t name);
     static std::unique_ptr<wchar_t[]> toWideChar(path_t path);
     static FD   openFile(path_t filepath);
@@ -66,6 +86,7 @@ struct FS {
     static bool remove(path_t path);
     static bool removeDir(path_t path);
     static bool removeFile(path_t path);
+    static bool readBatch(const std::vector<ReadRequest>& requests);
 };
 
 }; // windows namespace
@@ -19,6 +19,7 @@
 
 #include "istreamreader.h"
 #include "buffer_reader.h"
+#include "buffer_pool.h"
 
 namespace zim
 {
@@ -30,7 +31,7 @@ namespace zim
 std::unique_ptr<const Reader>
 IStreamReader::sub_reader(zsize_t size)
 {
-  auto buffer = Buffer::makeBuffer(size);
+  auto buffer = BufferPool::instance().makeBuffer(size);
   readImpl(const_cast<char*>(buffer.data()), size);
   return std::unique_ptr<Reader>(new BufferReader(buffer));
 }
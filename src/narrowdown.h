@@ -21,9 +21,15 @@
 #define ZIM_NARROWDOWN_H
 
 #include "zim_types.h"
+#include "buffer.h"
 #include "debug.h"
+#include "endian_tools.h"
 
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <zim/error.h>
@@ -94,9 +100,32 @@ public: // types
 
 public: // functions
   NarrowDown()
-    : pred(&keyContentArea)
   {}
 
+  // Uses a grid serialized by serialize(). The serialized data is used in
+  // place, it is not copied.
+  explicit NarrowDown(const Buffer& serialized)
+  {
+    const size_t size = serialized.size().v;
+    const char* data = serialized.data();
+    const uint64_t count = size < COUNT_SIZE ? 0 : fromLittleEndian<uint32_t>(data);
+    if (count == 0 || COUNT_SIZE + count*ENTRY_SIZE >= size || data[size-1] != '\0') {
+      throw ZimFileFormatError("Invalid lookup grid");
+    }
+    mp_serialized.reset(new Buffer(serialized));
+    m_serializedEntryCount = count;
+    mp_serializedEntries = data + COUNT_SIZE;
+    mp_serializedKeyContent = mp_serializedEntries + count*ENTRY_SIZE;
+    const size_t keyContentSize = size - COUNT_SIZE - count*ENTRY_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+      if (fromLittleEndian<uint32_t>(getEntryData(i)) >= keyContentSize
+       || (i > 0 && (getLindex(i) <= getLindex(i-1)
+                  || std::strcmp(getKeyContent(i), getKeyContent(i-1)) < 0))) {
+        throw ZimFileFormatError("Invalid lookup grid");
+      }
+    }
+  }
+
   // Add another entry to the search index. The key of the next item is used
   // to derive and store a shorter pseudo-key as explained in the long comment
   // above the class.
@@ -113,42 +142,90 @@ public: // functions
       ss << "  #" << i+1 << ": " << nextKey[0] << "/" << nextKey.substr(1);
       throw ZimFileFormatError(ss.str());
     }
-    if ( entries.empty() ) {
+    if ( getEntryCount() == 0 ) {
       addEntry(key, i);
     }
     else
     {
       const std::string pseudoKey = shortestStringInBetween(key, nextKey);
-      if (pred(pseudoKey, entries.back())) {
+      const size_t last = getEntryCount() - 1;
+      if (pseudoKey.compare(getKeyContent(last)) < 0) {
         std::stringstream ss;
         ss << "Dirent table is not properly sorted:\n";
-        ss << "PseudoKey " << pseudoKey << " should be after (or equal) previously generated " << pred.getKeyContent(entries.back()) << "\n";
+        ss << "PseudoKey " << pseudoKey << " should be after (or equal) previously generated " << getKeyContent(last) << "\n";
         throw ZimFileFormatError(ss.str());
       }
-      ASSERT(entries.back().lindex, <, i);
+      ASSERT(getLindex(last), <, i);
       addEntry(pseudoKey, i);
     }
   }
 
   void close(const std::string& key, index_type i)
   {
-    ASSERT(entries.empty() || pred(entries.back(), key), ==, true);
-    ASSERT(entries.empty() || entries.back().lindex < i, ==, true);
+    ASSERT(getEntryCount() == 0 || key.compare(getKeyContent(getEntryCount()-1)) >= 0, ==, true);
+    ASSERT(getEntryCount() == 0 || getLindex(getEntryCount()-1) < i, ==, true);
     addEntry(key, i);
   }
 
   Range getRange(const std::string& key) const
   {
-    auto it = std::upper_bound(entries.begin(), entries.end(), key, pred);
-    if ( it == entries.begin() )
+    // Index of the first entry whose pseudo-key is greater than key.
+    size_t l = 0;
+    size_t u = getEntryCount();
+    while (l < u) {
+      const size_t m = l + (u - l) / 2;
+      if (key.compare(getKeyContent(m)) < 0)
+        u = m;
+      else
+        l = m + 1;
+    }
+    if ( l == 0 )
       return {0, 0};
 
-    const index_type prevEntryLindex = (it-1)->lindex;
+    const index_type prevEntryLindex = getLindex(l-1);
 
-    if ( it == entries.end() )
+    if ( l == getEntryCount() )
       return {prevEntryLindex, prevEntryLindex+1};
 
-    return {prevEntryLindex, it->lindex+1};
+    return {prevEntryLindex, getLindex(l)+1};
+  }
+
+  // The index of the last item (the one given to close()).
+  index_type getLastIndex() const
+  {
+    ASSERT(getEntryCount(), >, 0u);
+    return getLindex(getEntryCount()-1);
+  }
+
+  // The index and the (full) key of the first item, and the key of the last
+  // one: the keys of the other items may be pseudo-keys.
+  index_type getFirstIndex() const
+  {
+    ASSERT(getEntryCount(), >, 0u);
+    return getLindex(0);
+  }
+
+  std::string getFirstKey() const
+  {
+    ASSERT(getEntryCount(), >, 0u);
+    return getKeyContent(0);
+  }
+
+  std::string getLastKey() const
+  {
+    ASSERT(getEntryCount(), >, 0u);
+    return getKeyContent(getEntryCount()-1);
+  }
+
+  // The serialized grid: the entry count (uint32), the entries (see Entry
+  // below) and the key content area.
+  std::string serialize() const
+  {
+    std::string data(COUNT_SIZE, '\0');
+    toLittleEndian(uint32_t(getEntryCount()), &data[0]);
+    data.append(entries.begin(), entries.end());
+    data.append(keyContentArea.begin(), keyContentArea.end());
+    return data;
   }
 
   static std::string shortestStringInBetween(const std::string& a, const std::string& b)
@@ -163,73 +240,70 @@ public: // functions
     return std::string(b.begin(), std::min(b.end(), m.second+1));
   }
 
+private: // types
+  // Each entry is stored as two little endian uint32:
+  //
+  //  - pseudoKeyOffset: the offset of the pseudo-key in the key content area.
+  //    This is mostly a truncated version of a key from the input sequence.
+  //    The exceptions are
+  //      - the first item
+  //      - the last item
+  //      - keys that differ from their preceding key only in the last character
+  //    (std::string has too much memory overhead, we densely pack the key
+  //    contents into keyContentArea instead)
+  //
+  //  - lindex: the index of the item in the input sequence right after which
+  //    pseudoKey might be inserted without breaking the sequence order.
+  //    In other words, the condition
+  //
+  //      sequence[lindex] <= pseudoKey <= sequence[lindex+1]
+  //
+  //    must be true.
+  enum { ENTRY_SIZE = 8, COUNT_SIZE = 4 };
+
 private: // functions
   void addEntry(const std::string& s, index_type i)
   {
-    entries.push_back({uint32_t(keyContentArea.size()), i});
+    char entry[ENTRY_SIZE];
+    toLittleEndian(uint32_t(keyContentArea.size()), entry);
+    toLittleEndian(uint32_t(i), entry + 4);
+    entries.insert(entries.end(), entry, entry + ENTRY_SIZE);
     keyContentArea.insert(keyContentArea.end(), s.begin(), s.end());
     keyContentArea.push_back('\0');
   }
 
-private: // types
-  typedef std::vector<char> KeyContentArea;
-
-  struct Entry
-  {
-    // This is mostly a truncated version of a key from the input sequence.
-    // The exceptions are
-    //   - the first item
-    //   - the last item
-    //   - keys that differ from their preceding key only in the last character
-    //
-    // std::string pseudoKey; // std::string has too much memory overhead.
-    uint32_t pseudoKeyOffset; // Instead we densely pack the key contents
-                              // into keyContentArea and store in the entry
-                              // the offset into that container.
-
-    // This represents the index of the item in the input sequence right
-    // after which pseudoKey might be inserted without breaking the sequence
-    // order. In other words, the condition
-    //
-    //    sequence[lindex] <= pseudoKey <= sequence[lindex+1]
-    //
-    // must be true.
-    index_type  lindex;
-  };
-
-  struct LookupPred
+  size_t getEntryCount() const
   {
-    const KeyContentArea& keyContentArea;
-
-    explicit LookupPred(const KeyContentArea* kca)
-      : keyContentArea(*kca)
-    {}
-
-    const char* getKeyContent(const Entry& entry) const
-    {
-      return &keyContentArea[entry.pseudoKeyOffset];
-    }
+    return mp_serialized ? m_serializedEntryCount : entries.size() / ENTRY_SIZE;
+  }
 
-    bool operator()(const Entry& entry, const std::string& key) const
-    {
-      return key.compare(getKeyContent(entry)) >= 0;
-    }
+  const char* getEntryData(size_t i) const
+  {
+    return (mp_serialized ? mp_serializedEntries : entries.data()) + i*ENTRY_SIZE;
+  }
 
-    bool operator()(const std::string& key, const Entry& entry) const
-    {
-      return key.compare(getKeyContent(entry)) < 0;
-    }
-  };
+  const char* getKeyContent(size_t i) const
+  {
+    const auto offset = fromLittleEndian<uint32_t>(getEntryData(i));
+    return (mp_serialized ? mp_serializedKeyContent : keyContentArea.data()) + offset;
+  }
 
-  typedef std::vector<Entry> EntryCollection;
+  index_type getLindex(size_t i) const
+  {
+    return fromLittleEndian<uint32_t>(getEntryData(i) + 4);
+  }
 
 private: // data
-  // Used to store the (shortened) keys as densely packed C-style strings
-  KeyContentArea keyContentArea;
-
-  LookupPred pred;
+  // The entries and the (shortened) keys, as densely packed C-style strings,
+  // of a grid built with add() and close().
+  std::vector<char> entries;
+  std::vector<char> keyContentArea;
 
-  EntryCollection entries;
+  // The same data, in a grid read from its serialized form.
+  std::shared_ptr<const Buffer> mp_serialized;
+  size_t m_serializedEntryCount = 0;
+  const char* mp_serializedEntries = nullptr;
+  const char* mp_serializedKeyContent = nullptr;
 };
 
 } // namespace zim
@@ -0,0 +1,111 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "path_hash_index.h"
+
+#include "reader.h"
+#include "endian_tools.h"
+
+#include <zim/error.h>
+
+using namespace zim;
+
+namespace
+{
+
+// splitmix64 finalizer, spreads the bits of the FNV hash.
+uint64_t mix(uint64_t h)
+{
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+} // unnamed namespace
+
+const uint32_t PathHashIndex::EMPTY_SLOT;
+const size_t PathHashIndex::HEADER_SIZE;
+const size_t PathHashIndex::SEED_SIZE;
+const size_t PathHashIndex::SLOT_SIZE;
+
+PathHashIndex::PathHashIndex(std::unique_ptr<const Reader> reader)
+  : mp_reader(std::move(reader)),
+    m_slotCount(0),
+    m_bucketCount(0)
+{
+  const auto size = mp_reader->size().v;
+  if (size < HEADER_SIZE) {
+    throw ZimFileFormatError("Path hash index is too small");
+  }
+  m_slotCount = mp_reader->read_uint<uint32_t>(offset_t(0));
+  m_bucketCount = mp_reader->read_uint<uint32_t>(offset_t(4));
+  if (HEADER_SIZE + SEED_SIZE*uint64_t(m_bucketCount) + SLOT_SIZE*uint64_t(m_slotCount) != size
+   || (m_slotCount == 0) != (m_bucketCount == 0)) {
+    throw ZimFileFormatError("Invalid path hash index");
+  }
+}
+
+PathHashIndex::~PathHashIndex() = default;
+
+bool PathHashIndex::lookup(char ns, const std::string& url, entry_index_t& idx) const
+{
+  if (empty()) {
+    return false;
+  }
+  const auto hash = hashPath(ns, url);
+  const auto bucket = getBucket(hash, m_bucketCount);
+  const auto seed = mp_reader->read_uint<uint32_t>(offset_t(HEADER_SIZE + SEED_SIZE*bucket));
+  const auto slot = getSlot(hash, seed, m_slotCount);
+
+  char buf[SLOT_SIZE];
+  mp_reader->read(buf, offset_t(HEADER_SIZE + SEED_SIZE*m_bucketCount + SLOT_SIZE*uint64_t(slot)), zsize_t(SLOT_SIZE));
+  const auto entryIndex = fromLittleEndian<uint32_t>(buf);
+  if (entryIndex == EMPTY_SLOT || fromLittleEndian<uint16_t>(buf + 4) != getFingerprint(hash)) {
+    return false;
+  }
+  idx = entry_index_t(entryIndex);
+  return true;
+}
+
+uint64_t PathHashIndex::hashPath(char ns, const std::string& url)
+{
+  // FNV-1a
+  uint64_t h = 0xcbf29ce484222325ULL;
+  h = (h ^ uint8_t(ns)) * 0x100000001b3ULL;
+  for (const char c : url) {
+    h = (h ^ uint8_t(c)) * 0x100000001b3ULL;
+  }
+  return mix(h);
+}
+
+uint32_t PathHashIndex::getBucket(uint64_t hash, uint32_t bucketCount)
+{
+  return uint32_t((hash >> 32) % bucketCount);
+}
+
+uint32_t PathHashIndex::getSlot(uint64_t hash, uint32_t seed, uint32_t slotCount)
+{
+  return uint32_t(mix(hash + seed * 0x9e3779b97f4a7c15ULL) % slotCount);
+}
+
+uint16_t PathHashIndex::getFingerprint(uint64_t hash)
+{
+  return uint16_t(hash);
+}
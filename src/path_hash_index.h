@@ -0,0 +1,81 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_PATH_HASH_INDEX_H
+#define ZIM_PATH_HASH_INDEX_H
+
+#include "zim_types.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace zim
+{
+
+class Reader;
+
+/**
+ * PathHashIndex is a perfect hash of the paths of all the entries of an
+ * archive, written by the creator in the item X/index/pathHash/v0.
+ *
+ * The paths are hashed in buckets, and each bucket has a seed placing its
+ * paths in distinct slots of the table. A lookup reads one seed and one
+ * slot, and gives the only entry which may have the path. The path of
+ * this entry must still be compared to know if the path exists.
+ *
+ * Format (all the integers are little endian):
+ *  - uint32: slot count
+ *  - uint32: bucket count
+ *  - bucket count * uint32: the seeds of the buckets
+ *  - slot count * (uint32 entry index, uint16 fingerprint of the path)
+ * An empty slot has the entry index EMPTY_SLOT. An index without slot
+ * (the creator failed to build it) is valid but empty.
+ */
+class PathHashIndex
+{
+public: // types
+  static const uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+  static const size_t HEADER_SIZE = 8;
+  static const size_t SEED_SIZE = 4;
+  static const size_t SLOT_SIZE = 6;
+
+public: // functions
+  explicit PathHashIndex(std::unique_ptr<const Reader> reader);
+  ~PathHashIndex();
+
+  bool empty() const { return m_slotCount == 0; }
+
+  // Gives in `idx` the index of the entry which may have the path (ns, url).
+  // Returns false if no entry has this path.
+  bool lookup(char ns, const std::string& url, entry_index_t& idx) const;
+
+  // The hash functions, shared with the creator.
+  static uint64_t hashPath(char ns, const std::string& url);
+  static uint32_t getBucket(uint64_t hash, uint32_t bucketCount);
+  static uint32_t getSlot(uint64_t hash, uint32_t seed, uint32_t slotCount);
+  static uint16_t getFingerprint(uint64_t hash);
+
+private: // data
+  std::unique_ptr<const Reader> mp_reader;
+  uint32_t m_slotCount;
+  uint32_t m_bucketCount;
+};
+
+} // namespace zim
+
+#endif // ZIM_PATH_HASH_INDEX_H
@@ -0,0 +1,88 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "prefetcher.h"
+
+#include <algorithm>
+
+using namespace zim;
+
+Prefetcher::Prefetcher(unsigned threadCount, size_t maxPendingTasks)
+  : m_threadCount(std::max(1U, threadCount)),
+    m_maxPendingTasks(std::max<size_t>(1, maxPendingTasks)),
+    m_runningTasks(0),
+    m_stopped(false)
+{}
+
+Prefetcher::~Prefetcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+    m_tasks.clear();
+  }
+  m_taskAdded.notify_all();
+  for (auto& thread: m_threads) {
+    thread.join();
+  }
+}
+
+void Prefetcher::add(Task task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_threads.empty()) {
+      for (unsigned i = 0; i < m_threadCount; ++i) {
+        m_threads.emplace_back(&Prefetcher::run, this);
+      }
+    }
+    if (m_tasks.size() == m_maxPendingTasks) {
+      m_tasks.pop_front();
+    }
+    m_tasks.push_back(std::move(task));
+  }
+  m_taskAdded.notify_one();
+}
+
+void Prefetcher::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this](){ return m_tasks.empty() && m_runningTasks == 0; });
+}
+
+void Prefetcher::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_taskAdded.wait(lock, [this](){ return m_stopped || !m_tasks.empty(); });
+    if (m_stopped) {
+      return;
+    }
+    Task task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    ++m_runningTasks;
+    lock.unlock();
+    try {
+      task();
+    } catch (...) {}
+    lock.lock();
+    --m_runningTasks;
+    if (m_tasks.empty() && m_runningTasks == 0) {
+      m_idle.notify_all();
+    }
+  }
+}
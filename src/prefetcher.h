@@ -0,0 +1,73 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_PREFETCHER_H
+#define ZIM_PREFETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zim
+{
+
+/**
+ * Prefetcher runs prefetch tasks in a small pool of background threads.
+ *
+ * Tasks are hints: they must not throw (exceptions are ignored) and the
+ * oldest pending tasks are dropped if too many are waiting, as they are
+ * probably not useful anymore. The threads are only started by the first
+ * task and are stopped (the pending tasks being dropped) by the destructor.
+ */
+class Prefetcher
+{
+public: // types
+  typedef std::function<void()> Task;
+
+public: // functions
+  Prefetcher(unsigned threadCount, size_t maxPendingTasks);
+  ~Prefetcher();
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  void add(Task task);
+
+  // Waits until all the added tasks are done.
+  void wait();
+
+private: // functions
+  void run();
+
+private: // data
+  const unsigned m_threadCount;
+  const size_t m_maxPendingTasks;
+
+  std::mutex m_mutex;
+  std::condition_variable m_taskAdded;
+  std::condition_variable m_idle;
+  std::deque<Task> m_tasks;
+  unsigned m_runningTasks;
+  bool m_stopped;
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace zim
+
+#endif // ZIM_PREFETCHER_H
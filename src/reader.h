@@ -21,6 +21,7 @@
 #define ZIM_READER_H_
 
 #include <memory>
+#include <vector>
 
 #include "zim_types.h"
 #include "endian_tools.h"
@@ -37,6 +38,16 @@ class Reader {
     virtual ~Reader() {};
 
     virtual void read(char* dest, offset_t offset, zsize_t size) const = 0;
+
+    // A read of `size` bytes at `offset` into `dest`, done by readBatch().
+    struct ReadRequest {
+      char* dest;
+      offset_t offset;
+      zsize_t size;
+    };
+    // Does all the reads. The readers of files submit them to the system
+    // at once, the others read them one after the other.
+    virtual void readBatch(const std::vector<ReadRequest>& requests) const;
     template<typename T>
     T read_uint(offset_t offset) const {
       ASSERT(offset.v, <, size().v);
@@ -48,6 +59,11 @@ class Reader {
     virtual char read(offset_t offset) const = 0;
 
     virtual const Buffer get_buffer(offset_t offset, zsize_t size) const = 0;
+    // A buffer in a region of the given kind. The readers of files map it
+    // following the policy of the kind (see setMmapPolicy()).
+    virtual const Buffer get_buffer(offset_t offset, zsize_t size, MemoryRegion /*region*/) const {
+      return get_buffer(offset, size);
+    }
     const Buffer get_buffer(offset_t offset) const {
       return get_buffer(offset, zsize_t(size().v-offset.v));
     }
@@ -28,6 +28,7 @@ namespace zim
 {
   namespace writer {
     class Dirent;
+    class OutputStream;
     struct DirectInfo {
       DirectInfo() :
         clusterNumber(0),
@@ -156,7 +157,7 @@ namespace zim
         bool isRemoved() const { return removed; }
         void markRemoved() { removed = true; }
 
-        void write(int out_fd) const;
+        void write(OutputStream& out) const;
 
         friend bool compareUrl(const Dirent* d1, const Dirent* d2);
         friend inline bool compareTitle(const Dirent* d1, const Dirent* d2);
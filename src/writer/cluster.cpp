@@ -18,6 +18,7 @@
  */
 
 #include "cluster.h"
+#include "outputStream.h"
 #include "../log.h"
 #include "../endian_tools.h"
 #include "../debug.h"
@@ -29,16 +30,13 @@
 #include <fstream>
 
 #include <fcntl.h>
+#include <limits>
 #include <stdexcept>
+#include <cstring>
 
-#ifdef _WIN32
-# include <io.h>
-#else
-# include <unistd.h>
-# define _write(fd, addr, size) ::write((fd), (addr), (size))
-#endif
-
-const zim::size_type MAX_WRITE_SIZE(4UL*1024*1024*1024-1);
+// Minimal (uncompressed) size of a frame in a seekable cluster.
+// Blobs are never split, so a frame may be bigger.
+const zim::size_type SEEKABLE_FRAME_SIZE(128*1024);
 
 namespace zim {
 namespace writer {
@@ -82,13 +80,22 @@ void Cluster::close() {
     compress();
     clear_raw_data();
   }
-  closed = true;
+  {
+    std::lock_guard<std::mutex> l(m_closedMutex);
+    closed = true;
+  }
+  m_closedCond.notify_all();
 }
 
 bool Cluster::isClosed() const{
   return closed;
 }
 
+void Cluster::waitClosed() const {
+  std::unique_lock<std::mutex> l(m_closedMutex);
+  m_closedCond.wait(l, [this]() { return bool(closed); });
+}
+
 zsize_t Cluster::size() const
 {
   if (isClosed()) {
@@ -105,13 +112,16 @@ template<typename OFFSET_TYPE>
 void Cluster::write_offsets(writer_t writer) const
 {
   size_type delta = blobOffsets.size() * sizeof(OFFSET_TYPE);
-  char out_buf[sizeof(OFFSET_TYPE)];
+  // All the offsets in one blob, to be written or compressed at once.
+  std::unique_ptr<char[]> out_buf(new char[delta]);
+  char* p = out_buf.get();
   for (auto offset : blobOffsets)
   {
     offset.v += delta;
-    toLittleEndian(static_cast<OFFSET_TYPE>(offset.v), out_buf);
-    writer(Blob(out_buf, sizeof(OFFSET_TYPE)));
+    toLittleEndian(static_cast<OFFSET_TYPE>(offset.v), p);
+    p += sizeof(OFFSET_TYPE);
   }
+  writer(Blob(out_buf.get(), delta));
 }
 
 void Cluster::write_content(writer_t writer) const
@@ -147,6 +157,16 @@ void Cluster::compress()
         break;
       }
 
+    case zim::zimcompZstdSeekable:
+      {
+        if (isExtended) {
+          _compressSeekable<uint64_t>();
+        } else {
+          _compressSeekable<uint32_t>();
+        }
+        break;
+      }
+
     default:
       throw std::runtime_error("We cannot compress an uncompressed cluster");
   };
@@ -160,6 +180,7 @@ void Cluster::_compress()
   auto writer = [&](const Blob& data) -> void {
     if (first) {
       runner.init((char*)data.data());
+      runner.set_content_size(size());
       first = false;
     }
     runner.feed(data.data(), data.size());
@@ -170,7 +191,80 @@ void Cluster::_compress()
   compressed_data = Blob(comp.release(), size.v);
 }
 
-void Cluster::write(int out_fd) const
+// See zim::Cluster::read_seekable_header for the layout of a seekable cluster.
+template<typename OFFSET_TYPE>
+void Cluster::_compressSeekable()
+{
+  typedef std::pair<std::unique_ptr<char[]>, zsize_t> Frame;
+  std::vector<Frame> frames;
+  std::vector<blob_index_type> frameFirstBlobs;
+
+  auto provider = m_providers.begin();
+  blob_index_type blobIdx = 0;
+  while (blobIdx < m_count) {
+    frameFirstBlobs.push_back(blobIdx);
+    const auto frameStart = blobOffsets[blobIdx];
+    auto frameEnd = blobIdx;
+    do {
+      ++frameEnd;
+    } while (frameEnd < m_count && (blobOffsets[frameEnd] - frameStart).v < SEEKABLE_FRAME_SIZE);
+
+    Compressor<ZSTD_INFO> runner(SEEKABLE_FRAME_SIZE);
+    runner.init(nullptr);
+    runner.set_content_size(zsize_t((blobOffsets[frameEnd] - frameStart).v));
+    for (; blobIdx < frameEnd; ++blobIdx) {
+      if (getBlobSize(blob_index_t(blobIdx)).v) {
+        while (true) {
+          auto blob = (*provider)->feed();
+          if (blob.size() == 0) {
+            break;
+          }
+          runner.feed(blob.data(), blob.size());
+        }
+        ++provider;
+      }
+    }
+    zsize_t frameSize;
+    auto frameData = runner.get_data(&frameSize);
+    frames.push_back(Frame(std::move(frameData), frameSize));
+  }
+  frameFirstBlobs.push_back(m_count);
+
+  const size_type headerSize = sizeof(OFFSET_TYPE) * (2 + blobOffsets.size() + 2 * frameFirstBlobs.size());
+  size_type totalSize = headerSize;
+  for (const auto& frame: frames) {
+    totalSize += frame.second.v;
+  }
+
+  std::unique_ptr<char[]> data(new char[totalSize]);
+  char* p = data.get();
+  const auto writeOffset = [&p](size_type value) {
+    ASSERT(value, <=, std::numeric_limits<OFFSET_TYPE>::max());
+    toLittleEndian(static_cast<OFFSET_TYPE>(value), p);
+    p += sizeof(OFFSET_TYPE);
+  };
+  writeOffset(m_count);
+  writeOffset(frames.size());
+  for (const auto& offset: blobOffsets) {
+    writeOffset(offset.v);
+  }
+  for (const auto& firstBlob: frameFirstBlobs) {
+    writeOffset(firstBlob);
+  }
+  size_type frameOffset = 0;
+  writeOffset(frameOffset);
+  for (const auto& frame: frames) {
+    frameOffset += frame.second.v;
+    writeOffset(frameOffset);
+  }
+  for (const auto& frame: frames) {
+    memcpy(p, frame.first.get(), frame.second.v);
+    p += frame.second.v;
+  }
+  compressed_data = Blob(data.release(), totalSize);
+}
+
+void Cluster::write(OutputStream& out) const
 {
   // write clusterInfo
   char clusterInfo = 0;
@@ -178,9 +272,7 @@ void Cluster::write(int out_fd) const
     clusterInfo = 0x10;
   }
   clusterInfo += getCompression();
-  if (_write(out_fd, &clusterInfo, 1) == -1) {
-    throw std::runtime_error("Error writng");
-  }
+  out.write(&clusterInfo, 1);
 
   // Open a comprestion stream if needed
   switch(getCompression())
@@ -188,19 +280,8 @@ void Cluster::write(int out_fd) const
     case zim::zimcompDefault:
     case zim::zimcompNone:
     {
-      auto writer = [=](const Blob& data) -> void {
-        // Ideally we would simply have to do :
-        // ::write(tmp_fd, data.c_str(), data.size());
-        // However, the data can be pretty big (> 4Gb), especially with test,
-        // And ::write fails to write data > 4Gb. So we have to chunck the write.
-        size_type to_write = data.size();
-        const char* src = data.data();
-        while (to_write) {
-         size_type chunk_size = std::min(MAX_WRITE_SIZE, to_write);
-         auto ret = _write(out_fd, src, chunk_size);
-         src += ret;
-         to_write -= ret;
-        }
+      auto writer = [&out](const Blob& data) -> void {
+        out.write(data);
       };
       write_content(writer);
       break;
@@ -210,11 +291,10 @@ void Cluster::write(int out_fd) const
     case zim::zimcompBzip2:
     case zim::zimcompLzma:
     case zim::zimcompZstd:
+    case zim::zimcompZstdSeekable:
       {
         log_debug("compress data");
-        if (_write(out_fd, compressed_data.data(), compressed_data.size()) == -1) {
-          throw std::runtime_error("Error writing");
-        }
+        out.write(compressed_data);
         break;
       }
 
@@ -26,6 +26,8 @@
 #include <vector>
 #include <functional>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #include <zim/writer/item.h>
 #include "../zim_types.h"
@@ -37,6 +39,7 @@ namespace writer {
 
 using writer_t = std::function<void(const Blob& data)>;
 class ContentProvider;
+class OutputStream;
 
 class Cluster {
   typedef std::vector<offset_t> Offsets;
@@ -61,6 +64,8 @@ class Cluster {
     void clear_data();
     void close();
     bool isClosed() const;
+    // Blocks until the cluster is closed (by another thread).
+    void waitClosed() const;
 
     void setClusterIndex(cluster_index_t idx) { index = idx; }
     cluster_index_t getClusterIndex() const { return index; }
@@ -74,7 +79,7 @@ class Cluster {
       return offset_t(1) + offset_t((count().v + 1) * (isExtended?sizeof(uint64_t):sizeof(uint32_t)));
     }
 
-    void write(int out_fd) const;
+    void write(OutputStream& out) const;
 
   protected:
     CompressionType compression;
@@ -87,6 +92,8 @@ class Cluster {
     mutable Blob compressed_data;
     std::string tmp_filename;
     std::atomic<bool> closed { false };
+    mutable std::mutex m_closedMutex;
+    mutable std::condition_variable m_closedCond;
     blob_index_type m_count { 0 };
 
   private:
@@ -97,6 +104,8 @@ class Cluster {
     void compress();
     template<typename COMP_INFO>
     void _compress();
+    template<typename OFFSET_TYPE>
+    void _compressSeekable();
     void clear_raw_data();
     void clear_compressed_data();
 };
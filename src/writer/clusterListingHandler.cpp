@@ -0,0 +1,90 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "clusterListingHandler.h"
+#include "creatordata.h"
+#include "cluster.h"
+
+#include "../endian_tools.h"
+
+#include <zim/writer/contentProvider.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace zim::writer;
+
+ClusterListingHandler::ClusterListingHandler(CreatorData* data)
+  : mp_creatorData(data)
+{}
+
+ClusterListingHandler::~ClusterListingHandler() = default;
+
+void ClusterListingHandler::start() {
+}
+
+void ClusterListingHandler::stop() {
+  // All the user content has been added and the handlers only add
+  // uncompressed content: the compressed cluster can be closed now.
+  // The items still in the open uncompressed cluster will then be in the
+  // last cluster with user content, whatever its index.
+  if (mp_creatorData->compCluster->count()) {
+    mp_creatorData->closeCluster(true);
+  }
+  const auto openCluster = mp_creatorData->uncompCluster;
+
+  // The redirections have no cluster, the readers sort them as in cluster 0.
+  std::vector<std::pair<zim::cluster_index_type, zim::entry_index_type>> entries;
+  for (const auto dirent: mp_creatorData->dirents) {
+    if (dirent->getNamespace() != 'C') {
+      continue;
+    }
+    zim::cluster_index_type cluster = 0;
+    if (dirent->isItem()) {
+      cluster = dirent->getCluster() == openCluster
+              ? std::numeric_limits<zim::cluster_index_type>::max()
+              : dirent->getClusterNumber().v;
+    }
+    entries.push_back({cluster, dirent->getIdx().v});
+  }
+  std::sort(entries.begin(), entries.end());
+
+  std::string content(entries.size() * sizeof(zim::entry_index_type), '\0');
+  auto p = &content[0];
+  for (const auto& entry: entries) {
+    zim::toLittleEndian(entry.second, p);
+    p += sizeof(zim::entry_index_type);
+  }
+  mp_content = std::make_shared<std::string>(std::move(content));
+}
+
+Dirent* ClusterListingHandler::createDirent() const {
+  return mp_creatorData->createDirent('X', "listing/clusterOrdered/v0", "application/octet-stream+zimlisting", "");
+}
+
+std::unique_ptr<ContentProvider> ClusterListingHandler::getContentProvider() const {
+  return std::unique_ptr<ContentProvider>(new SharedStringProvider(mp_content));
+}
+
+void ClusterListingHandler::handle(Dirent* dirent, std::shared_ptr<Item> item)
+{
+}
+
+void ClusterListingHandler::handle(Dirent* dirent, const Hints& hints)
+{
+}
@@ -20,8 +20,9 @@
 #include "clusterWorker.h"
 
 #include "cluster.h"
+#include "creatordata.h"
 
-std::atomic<unsigned long> zim::writer::ClusterTask::waiting_task(0);
+zim::writer::PendingTasks zim::writer::ClusterTask::waiting_tasks;
 
 namespace zim
 {
@@ -30,6 +31,10 @@ namespace zim
 
     void ClusterTask::run(CreatorData* data) {
       cluster->close();
+      if (data->clusterCompletionOrder) {
+        // Written as soon as closed, whatever the order of the clusters.
+        data->clusterToWrite.pushToQueue(cluster);
+      }
     };
 
   }
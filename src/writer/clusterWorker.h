@@ -20,7 +20,6 @@
 #ifndef OPENZIM_LIBZIM_CLUSTER_WORKER_H
 #define OPENZIM_LIBZIM_CLUSTER_WORKER_H
 
-#include <atomic>
 #include "workers.h"
 
 namespace zim {
@@ -35,15 +34,15 @@ class ClusterTask : public Task {
     explicit ClusterTask(Cluster* cluster) :
       cluster(cluster)
     {
-      ++waiting_task;
+      waiting_tasks.add();
     };
     virtual ~ClusterTask()
     {
-      --waiting_task;
+      waiting_tasks.remove();
     }
 
     virtual void run(CreatorData* data);
-    static std::atomic<unsigned long> waiting_task;
+    static PendingTasks waiting_tasks;
 
   private:
     Cluster* cluster;
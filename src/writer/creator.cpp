@@ -26,6 +26,7 @@
 #include "debug.h"
 #include "workers.h"
 #include "clusterWorker.h"
+#include "outputStream.h"
 #include <zim/blob.h>
 #include <zim/writer/contentProvider.h>
 #include "../endian_tools.h"
@@ -142,10 +143,28 @@ namespace zim
       return *this;
     }
 
+    Creator& Creator::configQueueSize(unsigned queueSize)
+    {
+      m_queueSize = queueSize;
+      return *this;
+    }
+
+    Creator& Creator::configPathHashIndex(bool withIndex)
+    {
+      m_withPathHashIndex = withIndex;
+      return *this;
+    }
+
+    Creator& Creator::configClusterCompletionOrder(bool completionOrder)
+    {
+      m_clusterCompletionOrder = completionOrder;
+      return *this;
+    }
+
     void Creator::startZimCreation(const std::string& filepath)
     {
       data = std::unique_ptr<CreatorData>(
-        new CreatorData(filepath, m_verbose, m_withIndex, m_indexingLanguage, m_compression)
+        new CreatorData(filepath, m_verbose, m_withIndex, m_indexingLanguage, m_compression, m_withPathHashIndex, m_clusterCompletionOrder, m_queueSize)
       );
       data->setMinChunkSize(m_minClusterSize);
 
@@ -261,11 +280,7 @@ namespace zim
 
       TINFO("Waiting for workers");
       // wait all cluster compression has been done
-      unsigned int wait = 0;
-      do {
-        microsleep(wait);
-        wait += 10;
-      } while(ClusterTask::waiting_task.load() > 0);
+      ClusterTask::waiting_tasks.waitNone();
 
       // Quit all workerThreads
       for (auto i=0U; i< m_nbWorkers; i++) {
@@ -327,42 +342,48 @@ namespace zim
 
       lseek(out_fd, header.getMimeListPos(), SEEK_SET);
       TINFO(" write mimetype list");
-      for(auto& mimeType: data->mimeTypesList)
       {
-        _write(out_fd, mimeType.c_str(), mimeType.size()+1);
-      }
+        OutputStream out(out_fd);
+        for(auto& mimeType: data->mimeTypesList)
+        {
+          out.write(mimeType.c_str(), mimeType.size()+1);
+        }
 
-      _write(out_fd, "", 1);
+        out.write("", 1);
 
-      ASSERT(lseek(out_fd, 0, SEEK_CUR), <, CLUSTER_BASE_OFFSET);
+        ASSERT(out.tell().v, <, offset_type(CLUSTER_BASE_OFFSET));
+        out.flush();
+      }
 
       TINFO(" write directory entries");
       lseek(out_fd, 0, SEEK_END);
+      OutputStream out(out_fd);
       for (Dirent* dirent: data->dirents)
       {
-        dirent->setOffset(offset_t(lseek(out_fd, 0, SEEK_CUR)));
-        dirent->write(out_fd);
+        dirent->setOffset(out.tell());
+        dirent->write(out);
       }
 
       TINFO(" write url prt list");
-      header.setUrlPtrPos(lseek(out_fd, 0, SEEK_CUR));
+      header.setUrlPtrPos(out.tell().v);
       for (auto& dirent: data->dirents)
       {
         char tmp_buff[sizeof(offset_type)];
         toLittleEndian(dirent->getOffset(), tmp_buff);
-        _write(out_fd, tmp_buff, sizeof(offset_type));
+        out.write(tmp_buff, sizeof(offset_type));
       }
 
       TINFO(" write cluster offset list");
-      header.setClusterPtrPos(lseek(out_fd, 0, SEEK_CUR));
+      header.setClusterPtrPos(out.tell().v);
       for (auto cluster : data->clustersList)
       {
         char tmp_buff[sizeof(offset_type)];
         toLittleEndian(cluster->getOffset(), tmp_buff);
-        _write(out_fd, tmp_buff, sizeof(offset_type));
+        out.write(tmp_buff, sizeof(offset_type));
       }
 
-      header.setChecksumPos(lseek(out_fd, 0, SEEK_CUR));
+      header.setChecksumPos(out.tell().v);
+      out.flush();
 
       TINFO(" write header");
       lseek(out_fd, 0, SEEK_SET);
@@ -393,9 +414,15 @@ namespace zim
                                    bool verbose,
                                    bool withIndex,
                                    std::string language,
-                                   CompressionType c)
+                                   CompressionType c,
+                                   bool withPathHashIndex,
+                                   bool clusterCompletionOrder,
+                                   unsigned queueSize)
       : mainPageDirent(nullptr),
+        clusterToWrite(queueSize),
+        taskList(queueSize),
         compression(c),
+        clusterCompletionOrder(clusterCompletionOrder),
         zimName(fname),
         tmpFileName(fname + ".tmp"),
         withIndex(withIndex),
@@ -448,6 +475,11 @@ namespace zim
       mp_titleListingHandler = std::make_shared<TitleListingHandler>(this);
       m_direntHandlers.push_back(mp_titleListingHandler);
       m_direntHandlers.push_back(std::make_shared<TitleListingHandlerV1>(this));
+      m_direntHandlers.push_back(std::make_shared<ClusterListingHandler>(this));
+      m_direntHandlers.push_back(std::make_shared<LookupGridHandler>(this));
+      if (withPathHashIndex) {
+        m_direntHandlers.push_back(std::make_shared<PathHashIndexHandler>(this));
+      }
 
       for(auto& handler:m_direntHandlers) {
         handler->start();
@@ -575,7 +607,9 @@ namespace zim
       cluster->setClusterIndex(cluster_index_t(clustersList.size()));
       clustersList.push_back(cluster);
       taskList.pushToQueue(new ClusterTask(cluster));
-      clusterToWrite.pushToQueue(cluster);
+      if (!clusterCompletionOrder) {
+        clusterToWrite.pushToQueue(cluster);
+      }
 
       if (cluster->is_extended() )
         isExtended = true;
@@ -35,6 +35,9 @@
 #include "../fileheader.h"
 #include "direntPool.h"
 #include "titleListingHandler.h"
+#include "clusterListingHandler.h"
+#include "lookupGridHandler.h"
+#include "pathHashIndexHandler.h"
 
 namespace zim
 {
@@ -61,7 +64,10 @@ namespace zim
 
         CreatorData(const std::string& fname, bool verbose,
                        bool withIndex, std::string language,
-                       CompressionType compression);
+                       CompressionType compression,
+                       bool withPathHashIndex,
+                       bool clusterCompletionOrder,
+                       unsigned queueSize);
         virtual ~CreatorData();
 
         void addDirent(Dirent* dirent);
@@ -98,6 +104,8 @@ namespace zim
         ThreadList workerThreads;
         std::thread  writerThread;
         const CompressionType compression;
+        // Write the clusters as they are compressed rather than in index order.
+        const bool clusterCompletionOrder;
         std::string zimName;
         std::string tmpFileName;
         bool isEmpty = true;
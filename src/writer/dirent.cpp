@@ -18,23 +18,17 @@
  */
 
 #include "_dirent.h"
+#include "outputStream.h"
 #include <zim/zim.h>
 #include "buffer.h"
 #include "endian_tools.h"
 #include "log.h"
 #include <algorithm>
 #include <cstring>
-#ifdef _WIN32
-# include <io.h>
-#else
-# include <unistd.h>
-# define _write(fd, addr, size) if(::write((fd), (addr), (size)) != (ssize_t)(size)) \
-{throw std::runtime_error("Error writing");}
-#endif
 
 log_define("zim.dirent")
 
-void zim::writer::Dirent::write(int out_fd) const
+void zim::writer::Dirent::write(OutputStream& out) const
 {
   union
   {
@@ -52,21 +46,21 @@ void zim::writer::Dirent::write(int out_fd) const
   if (isRedirect())
   {
     zim::toLittleEndian(getRedirectIndex().v, header.d + 8);
-    _write(out_fd, header.d, 12);
+    out.write(header.d, 12);
   }
   else
   {
     zim::toLittleEndian(zim::cluster_index_type(getClusterNumber()), header.d + 8);
     zim::toLittleEndian(zim::blob_index_type(getBlobNumber()), header.d + 12);
-    _write(out_fd, header.d, 16);
+    out.write(header.d, 16);
   }
 
-  _write(out_fd, path.c_str(), path.size()+1);
+  out.write(path.c_str(), path.size()+1);
 
   std::string t = getTitle();
   if (t != path)
-    _write(out_fd, t.c_str(), t.size());
+    out.write(t.c_str(), t.size());
   char c = 0;
-  _write(out_fd, &c, 1);
+  out.write(&c, 1);
 
 }
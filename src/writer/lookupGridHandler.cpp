@@ -0,0 +1,71 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "lookupGridHandler.h"
+#include "creatordata.h"
+#include "config.h"
+
+#include "../narrowdown.h"
+
+#include <zim/writer/contentProvider.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace zim::writer;
+
+LookupGridHandler::LookupGridHandler(CreatorData* data)
+  : mp_creatorData(data)
+{}
+
+LookupGridHandler::~LookupGridHandler() = default;
+
+void LookupGridHandler::start() {
+}
+
+void LookupGridHandler::stop() {
+  // All the dirents (including the ones of the handlers) are known and
+  // sorted by path. Same sampling than zim::DirentLookup.
+  const std::vector<const Dirent*> dirents(mp_creatorData->dirents.begin(), mp_creatorData->dirents.end());
+  const auto getKey = [&dirents](zim::entry_index_type i) {
+    return dirents[i]->getNamespace() + dirents[i]->getPath();
+  };
+  const auto direntCount = zim::entry_index_type(dirents.size());
+  const zim::entry_index_type step = std::max(1u, direntCount/DIRENT_LOOKUP_CACHE_SIZE);
+  zim::NarrowDown grid;
+  for (zim::entry_index_type i = 0; i < direntCount-1; i += step) {
+    grid.add(getKey(i), i, getKey(i+1));
+  }
+  grid.close(getKey(direntCount-1), direntCount-1);
+  mp_content = std::make_shared<std::string>(grid.serialize());
+}
+
+Dirent* LookupGridHandler::createDirent() const {
+  return mp_creatorData->createDirent('X', "index/lookupGrid/v0", "application/octet-stream+zimgrid", "");
+}
+
+std::unique_ptr<ContentProvider> LookupGridHandler::getContentProvider() const {
+  return std::unique_ptr<ContentProvider>(new SharedStringProvider(mp_content));
+}
+
+void LookupGridHandler::handle(Dirent* dirent, std::shared_ptr<Item> item)
+{
+}
+
+void LookupGridHandler::handle(Dirent* dirent, const Hints& hints)
+{
+}
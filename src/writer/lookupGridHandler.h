@@ -0,0 +1,55 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef OPENZIM_LIBZIM_LOOKUP_GRID_HANDLER_H
+#define OPENZIM_LIBZIM_LOOKUP_GRID_HANDLER_H
+
+#include "handler.h"
+
+#include <memory>
+#include <string>
+
+namespace zim {
+namespace writer {
+
+/**
+ * Writes in X/index/lookupGrid/v0 the lookup grid (see zim::NarrowDown) of
+ * the paths, as the readers would build it by reading the dirents.
+ */
+class LookupGridHandler : public DirentHandler {
+  public:
+    explicit LookupGridHandler(CreatorData* data);
+    virtual ~LookupGridHandler();
+
+    void start() override;
+    void stop() override;
+    std::unique_ptr<ContentProvider> getContentProvider() const override;
+    void handle(Dirent* dirent, std::shared_ptr<Item> item) override;
+    void handle(Dirent* dirent, const Hints& hints) override;
+
+  protected:
+    Dirent* createDirent() const override;
+
+  private:
+    CreatorData* mp_creatorData;
+    std::shared_ptr<const std::string> mp_content;
+};
+
+}
+}
+
+#endif // OPENZIM_LIBZIM_LOOKUP_GRID_HANDLER_H
@@ -0,0 +1,145 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "outputStream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <sys/uio.h>
+# include <unistd.h>
+#endif
+
+namespace zim {
+namespace writer {
+
+namespace {
+
+// Some systems fail to write more than 2GiB at once.
+const size_t MAX_WRITE_SIZE = 1024*1024*1024;
+
+#ifdef _WIN32
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+
+// No vectored write: the buffers are written one after the other, up to
+// the first error or partial write.
+int64_t writeVector(int fd, const iovec* iov, int count)
+{
+  int64_t written = 0;
+  for (int i = 0; i < count; ++i) {
+    const int ret = _write(fd, iov[i].iov_base, unsigned(iov[i].iov_len));
+    if (ret < 0) {
+      return written ? written : ret;
+    }
+    written += ret;
+    if (size_t(ret) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return written;
+}
+#else
+int64_t writeVector(int fd, const iovec* iov, int count)
+{
+  return ::writev(fd, iov, count);
+}
+#endif
+
+} // unnamed namespace
+
+const size_t OutputStream::DEFAULT_BUFFER_SIZE;
+
+OutputStream::OutputStream(int fd, size_t bufferSize)
+  : m_fd(fd),
+    m_capacity(bufferSize),
+    m_buffer(new char[bufferSize]),
+    m_size(0),
+    m_offset(lseek(fd, 0, SEEK_CUR))
+{}
+
+void OutputStream::write(const char* data, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+  if (m_size + size <= m_capacity) {
+    memcpy(m_buffer.get() + m_size, data, size);
+    m_size += size;
+  } else if (size < m_capacity) {
+    flush();
+    memcpy(m_buffer.get(), data, size);
+    m_size = size;
+  } else {
+    writeWithBuffer(data, size);
+  }
+  m_offset += size;
+}
+
+void OutputStream::flush()
+{
+  writeWithBuffer(nullptr, 0);
+}
+
+void OutputStream::writeWithBuffer(const char* data, size_t size)
+{
+  size_t buffered = m_size;
+  while (buffered || size) {
+    iovec iov[2];
+    int count = 0;
+    if (buffered) {
+      iov[count].iov_base = m_buffer.get() + m_size - buffered;
+      iov[count].iov_len = buffered;
+      ++count;
+    }
+    if (size) {
+      iov[count].iov_base = const_cast<char*>(data);
+      iov[count].iov_len = std::min(size, MAX_WRITE_SIZE);
+      ++count;
+    }
+    const auto ret = writeVector(m_fd, iov, count);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Error writing");
+    }
+    if (ret == 0) {
+      // Nothing written while there is data to write: retrying would
+      // loop forever.
+      throw std::runtime_error("Error writing: nothing written");
+    }
+    size_t written = ret;
+    const auto fromBuffer = std::min(written, buffered);
+    buffered -= fromBuffer;
+    written -= fromBuffer;
+    data += written;
+    size -= written;
+  }
+  m_size = 0;
+}
+
+} // writer
+} // zim
@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_WRITER_OUTPUTSTREAM_H_
+#define ZIM_WRITER_OUTPUTSTREAM_H_
+
+#include <zim/blob.h>
+#include <memory>
+
+#include "../zim_types.h"
+
+namespace zim {
+
+namespace writer {
+
+// A buffered output to a file, from its current position.
+// The small writes are gathered in the buffer. A big write is not copied:
+// it is written along with the buffered data by a single (vectored) call.
+// The data is only written to the file once flushed.
+class OutputStream {
+  public:
+    static const size_t DEFAULT_BUFFER_SIZE = 1024*1024;
+
+    explicit OutputStream(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    OutputStream(const OutputStream&) = delete;
+    OutputStream& operator=(const OutputStream&) = delete;
+
+    void write(const char* data, size_t size);
+    void write(const Blob& blob) { write(blob.data(), blob.size()); }
+
+    // The offset in the file of the next byte to write.
+    offset_t tell() const { return offset_t(m_offset); }
+
+    void flush();
+
+  private:
+    void writeWithBuffer(const char* data, size_t size);
+
+    const int m_fd;
+    const size_t m_capacity;
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_size;
+    offset_type m_offset;
+};
+
+}
+
+}
+
+#endif // ZIM_WRITER_OUTPUTSTREAM_H_
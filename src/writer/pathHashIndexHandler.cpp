@@ -0,0 +1,172 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "pathHashIndexHandler.h"
+#include "creatordata.h"
+
+#include "../endian_tools.h"
+#include "../path_hash_index.h"
+
+#include <zim/writer/contentProvider.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace zim::writer;
+
+namespace {
+
+// Average number of paths in a bucket.
+const uint32_t PATHS_PER_BUCKET = 4;
+// Number of seeds tried to place a bucket before giving up.
+const uint32_t MAX_SEED = 1 << 20;
+
+struct HashedPath {
+  uint32_t bucket;
+  uint32_t entryIndex;
+  uint64_t hash;
+};
+
+// Builds a perfect hash of the paths with the "hash and displace" method:
+// the buckets are placed from the biggest to the smallest one, each with
+// the first seed putting all its paths in free slots.
+// Returns an empty index if no seed is found for a bucket (this may only
+// happen if two paths have the same hash).
+std::string buildIndex(const std::vector<std::pair<uint64_t, uint32_t>>& paths)
+{
+  using zim::PathHashIndex;
+  if (paths.empty()) {
+    return std::string(PathHashIndex::HEADER_SIZE, '\0');
+  }
+  const uint32_t pathCount = paths.size();
+  const uint32_t slotCount = pathCount + pathCount/16 + 1;
+  const uint32_t bucketCount = (pathCount + PATHS_PER_BUCKET - 1) / PATHS_PER_BUCKET;
+
+  std::vector<HashedPath> hashedPaths;
+  hashedPaths.reserve(pathCount);
+  for (const auto& p: paths) {
+    hashedPaths.push_back({PathHashIndex::getBucket(p.first, bucketCount), p.second, p.first});
+  }
+  std::sort(hashedPaths.begin(), hashedPaths.end(),
+    [](const HashedPath& a, const HashedPath& b) { return a.bucket < b.bucket; });
+
+  // The [begin, end) ranges of the buckets in hashedPaths, biggest first.
+  std::vector<std::pair<uint32_t, uint32_t>> buckets;
+  for (uint32_t begin = 0; begin < pathCount; ) {
+    uint32_t end = begin + 1;
+    while (end < pathCount && hashedPaths[end].bucket == hashedPaths[begin].bucket) {
+      ++end;
+    }
+    buckets.push_back({begin, end});
+    begin = end;
+  }
+  std::stable_sort(buckets.begin(), buckets.end(),
+    [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+      return a.second - a.first > b.second - b.first;
+    });
+
+  std::vector<uint32_t> seeds(bucketCount, 0);
+  std::vector<uint32_t> slots(slotCount, PathHashIndex::EMPTY_SLOT);
+  std::vector<uint32_t> bucketSlots;
+  for (const auto& bucket: buckets) {
+    bool placed = false;
+    for (uint32_t seed = 0; seed < MAX_SEED && !placed; ++seed) {
+      bucketSlots.clear();
+      placed = true;
+      for (auto i = bucket.first; i < bucket.second; ++i) {
+        const auto slot = PathHashIndex::getSlot(hashedPaths[i].hash, seed, slotCount);
+        if (slots[slot] != PathHashIndex::EMPTY_SLOT
+         || std::find(bucketSlots.begin(), bucketSlots.end(), slot) != bucketSlots.end()) {
+          placed = false;
+          break;
+        }
+        bucketSlots.push_back(slot);
+      }
+      if (placed) {
+        seeds[hashedPaths[bucket.first].bucket] = seed;
+        for (auto i = bucket.first; i < bucket.second; ++i) {
+          slots[bucketSlots[i - bucket.first]] = i;
+        }
+      }
+    }
+    if (!placed) {
+      return std::string(PathHashIndex::HEADER_SIZE, '\0');
+    }
+  }
+
+  std::string content(PathHashIndex::HEADER_SIZE
+                    + PathHashIndex::SEED_SIZE * bucketCount
+                    + PathHashIndex::SLOT_SIZE * slotCount, '\0');
+  char* p = &content[0];
+  zim::toLittleEndian(slotCount, p);
+  zim::toLittleEndian(bucketCount, p + 4);
+  p += PathHashIndex::HEADER_SIZE;
+  for (const auto seed: seeds) {
+    zim::toLittleEndian(seed, p);
+    p += PathHashIndex::SEED_SIZE;
+  }
+  for (const auto i: slots) {
+    if (i == PathHashIndex::EMPTY_SLOT) {
+      zim::toLittleEndian(PathHashIndex::EMPTY_SLOT, p);
+      zim::toLittleEndian(uint16_t(0), p + 4);
+    } else {
+      zim::toLittleEndian(hashedPaths[i].entryIndex, p);
+      zim::toLittleEndian(PathHashIndex::getFingerprint(hashedPaths[i].hash), p + 4);
+    }
+    p += PathHashIndex::SLOT_SIZE;
+  }
+  return content;
+}
+
+} // end of anonymous namespace
+
+PathHashIndexHandler::PathHashIndexHandler(CreatorData* data)
+  : mp_creatorData(data)
+{}
+
+PathHashIndexHandler::~PathHashIndexHandler() = default;
+
+void PathHashIndexHandler::start() {
+}
+
+void PathHashIndexHandler::stop() {
+  // All the dirents (including the ones of the handlers) are known and
+  // their indexes are set.
+  std::vector<std::pair<uint64_t, uint32_t>> paths;
+  paths.reserve(mp_creatorData->dirents.size());
+  for (const auto dirent: mp_creatorData->dirents) {
+    paths.push_back({zim::PathHashIndex::hashPath(dirent->getNamespace(), dirent->getPath()),
+                     dirent->getIdx().v});
+  }
+  mp_content = std::make_shared<std::string>(buildIndex(paths));
+}
+
+Dirent* PathHashIndexHandler::createDirent() const {
+  return mp_creatorData->createDirent('X', "index/pathHash/v0", "application/octet-stream+zimhashindex", "");
+}
+
+std::unique_ptr<ContentProvider> PathHashIndexHandler::getContentProvider() const {
+  return std::unique_ptr<ContentProvider>(new SharedStringProvider(mp_content));
+}
+
+void PathHashIndexHandler::handle(Dirent* dirent, std::shared_ptr<Item> item)
+{
+}
+
+void PathHashIndexHandler::handle(Dirent* dirent, const Hints& hints)
+{
+}
@@ -0,0 +1,57 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef OPENZIM_LIBZIM_PATH_HASH_INDEX_HANDLER_H
+#define OPENZIM_LIBZIM_PATH_HASH_INDEX_HANDLER_H
+
+#include "handler.h"
+
+#include <memory>
+#include <string>
+
+namespace zim {
+namespace writer {
+
+/**
+ * Writes the path hash index (see zim::PathHashIndex) of all the entries
+ * in X/index/pathHash/v0.
+ *
+ * The index is built in `stop()`, once the entry indexes are set.
+ */
+class PathHashIndexHandler : public DirentHandler {
+  public:
+    explicit PathHashIndexHandler(CreatorData* data);
+    virtual ~PathHashIndexHandler();
+
+    void start() override;
+    void stop() override;
+    std::unique_ptr<ContentProvider> getContentProvider() const override;
+    void handle(Dirent* dirent, std::shared_ptr<Item> item) override;
+    void handle(Dirent* dirent, const Hints& hints) override;
+
+  protected:
+    Dirent* createDirent() const override;
+
+  private:
+    CreatorData* mp_creatorData;
+    std::shared_ptr<const std::string> mp_content;
+};
+
+}
+}
+
+#endif // OPENZIM_LIBZIM_PATH_HASH_INDEX_HANDLER_H
@@ -20,26 +20,31 @@
 #ifndef OPENZIM_LIBZIM_QUEUE_H
 #define OPENZIM_LIBZIM_QUEUE_H
 
-#define MAX_QUEUE_SIZE 10
-
+#include <condition_variable>
 #include <mutex>
 #include <queue>
-#include "../tools.h"
 
+// A queue of bounded size, shared by producer and consumer threads.
+// Pushing to a full queue blocks until an element is popped.
 template<typename T>
 class Queue {
     public:
-        Queue() = default;
+        explicit Queue(size_t maxSize);
         virtual ~Queue() = default;
         virtual bool isEmpty();
         virtual size_t size();
         virtual void pushToQueue(const T& element);
         virtual bool getHead(T &element);
         virtual bool popFromQueue(T &element);
+        // Blocks until there is an element to pop.
+        virtual void waitAndPop(T &element);
 
     protected:
         std::queue<T>   m_realQueue;
         std::mutex      m_queueMutex;
+        std::condition_variable m_notEmpty;
+        std::condition_variable m_notFull;
+        const size_t    m_maxSize;
 
     private:
         // Make this queue non copyable
@@ -47,6 +52,11 @@ class Queue {
         Queue& operator=(const Queue&);
 };
 
+template<typename T>
+Queue<T>::Queue(size_t maxSize)
+  : m_maxSize(maxSize ? maxSize : 1)
+{}
+
 template<typename T>
 bool Queue<T>::isEmpty() {
     std::lock_guard<std::mutex> l(m_queueMutex);
@@ -61,17 +71,12 @@ size_t Queue<T>::size() {
 
 template<typename T>
 void Queue<T>::pushToQueue(const T &element) {
-    unsigned int wait = 0;
-    unsigned int queueSize = 0;
-
-    do {
-        zim::microsleep(wait);
-        queueSize = size();
-        wait += 10;
-    } while (queueSize > MAX_QUEUE_SIZE);
-
-    std::lock_guard<std::mutex> l(m_queueMutex);
-    m_realQueue.push(element);
+    {
+        std::unique_lock<std::mutex> l(m_queueMutex);
+        m_notFull.wait(l, [this]() { return m_realQueue.size() < m_maxSize; });
+        m_realQueue.push(element);
+    }
+    m_notEmpty.notify_one();
 }
 
 template<typename T>
@@ -86,15 +91,28 @@ bool Queue<T>::getHead(T &element) {
 
 template<typename T>
 bool Queue<T>::popFromQueue(T &element) {
-    std::lock_guard<std::mutex> l(m_queueMutex);
-    if (m_realQueue.empty()) {
-        return false;
+    {
+        std::lock_guard<std::mutex> l(m_queueMutex);
+        if (m_realQueue.empty()) {
+            return false;
+        }
+
+        element = m_realQueue.front();
+        m_realQueue.pop();
     }
+    m_notFull.notify_one();
+    return true;
+}
 
-    element = m_realQueue.front();
-    m_realQueue.pop();
-
-  return true;
+template<typename T>
+void Queue<T>::waitAndPop(T &element) {
+    {
+        std::unique_lock<std::mutex> l(m_queueMutex);
+        m_notEmpty.wait(l, [this]() { return !m_realQueue.empty(); });
+        element = m_realQueue.front();
+        m_realQueue.pop();
+    }
+    m_notFull.notify_one();
 }
 
 #endif // OPENZIM_LIBZIM_QUEUE_H
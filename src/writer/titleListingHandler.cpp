@@ -29,10 +29,14 @@ using namespace zim::writer;
 
 namespace {
 
+// The entries fed at once (at most).
+const size_t FEED_ENTRY_COUNT = 64*1024;
+
 class ListingProvider : public ContentProvider {
   public:
     explicit ListingProvider(const TitleListingHandler::Dirents* dirents)
       : mp_dirents(dirents),
+        buffer(new char[std::min(dirents->size(), FEED_ENTRY_COUNT) * sizeof(zim::entry_index_type)]),
         m_it(dirents->begin())
     {}
 
@@ -44,14 +48,17 @@ class ListingProvider : public ContentProvider {
       if (m_it == mp_dirents->end()) {
         return zim::Blob(nullptr, 0);
       }
-      zim::toLittleEndian((*m_it)->getIdx().v, buffer);
-      m_it++;
-      return zim::Blob(buffer, sizeof(zim::entry_index_type));
+      char* p = buffer.get();
+      for (size_t i = 0; i < FEED_ENTRY_COUNT && m_it != mp_dirents->end(); ++i, ++m_it) {
+        zim::toLittleEndian((*m_it)->getIdx().v, p);
+        p += sizeof(zim::entry_index_type);
+      }
+      return zim::Blob(buffer.get(), p - buffer.get());
     }
 
   private:
     const TitleListingHandler::Dirents* mp_dirents;
-    char buffer[sizeof(zim::entry_index_type)];
+    std::unique_ptr<char[]> buffer;
     TitleListingHandler::Dirents::const_iterator m_it;
 };
 
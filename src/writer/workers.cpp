@@ -20,8 +20,7 @@
 #include "workers.h"
 #include "cluster.h"
 #include "creatordata.h"
-
-#include "../tools.h"
+#include "outputStream.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -37,19 +36,14 @@ namespace zim
     void* taskRunner(void* arg) {
       auto creatorData = static_cast<zim::writer::CreatorData*>(arg);
       Task* task;
-      unsigned int wait = 0;
 
       while(true) {
-        microsleep(wait);
-        wait += 100;
-        if (creatorData->taskList.popFromQueue(task)) {
-          if (task == nullptr) {
-            return nullptr;
-          }
-          task->run(creatorData);
-          delete task;
-          wait = 0;
+        creatorData->taskList.waitAndPop(task);
+        if (task == nullptr) {
+          return nullptr;
         }
+        task->run(creatorData);
+        delete task;
       }
       return nullptr;
     }
@@ -57,24 +51,19 @@ namespace zim
     void* clusterWriter(void* arg) {
       auto creatorData = static_cast<zim::writer::CreatorData*>(arg);
       Cluster* cluster;
-      unsigned int wait = 0;
+      OutputStream out(creatorData->out_fd);
       while(true) {
-        microsleep(wait);
-        wait += 100;
-        if(creatorData->clusterToWrite.getHead(cluster)) {
-          if (cluster == nullptr) {
-            // All cluster writen, we can quit
-            return nullptr;
-          }
-          if (not cluster->isClosed()) {
-            continue;
-          }
-          creatorData->clusterToWrite.popFromQueue(cluster);
-          cluster->setOffset(offset_t(lseek(creatorData->out_fd, 0, SEEK_CUR)));
-          cluster->write(creatorData->out_fd);
-          cluster->clear_data();
-          wait = 0;
+        creatorData->clusterToWrite.waitAndPop(cluster);
+        if (cluster == nullptr) {
+          // All cluster writen, we can quit
+          out.flush();
+          return nullptr;
         }
+        // In index order, the cluster may still be compressed by a worker.
+        cluster->waitClosed();
+        cluster->setOffset(out.tell());
+        cluster->write(out);
+        cluster->clear_data();
       }
       return nullptr;
     }
@@ -20,6 +20,9 @@
 #ifndef OPENZIM_LIBZIM_WORKERS_H
 #define OPENZIM_LIBZIM_WORKERS_H
 
+#include <condition_variable>
+#include <mutex>
+
 namespace zim {
 namespace writer {
 
@@ -33,6 +36,38 @@ class Task {
     virtual void run(CreatorData* data) = 0;
 };
 
+// The count of the tasks not done yet, that a thread can wait to be zero.
+class PendingTasks {
+  public:
+    PendingTasks() = default;
+
+    void add()
+    {
+      std::lock_guard<std::mutex> l(m_mutex);
+      ++m_count;
+    }
+
+    void remove()
+    {
+      {
+        std::lock_guard<std::mutex> l(m_mutex);
+        --m_count;
+      }
+      m_done.notify_all();
+    }
+
+    void waitNone()
+    {
+      std::unique_lock<std::mutex> l(m_mutex);
+      m_done.wait(l, [this]() { return m_count == 0; });
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    unsigned long m_count = 0;
+};
+
 void* taskRunner(void* data);
 void* clusterWriter(void* data);
 
@@ -27,7 +27,7 @@
 #include <mutex>
 
 static std::mutex s_dbaccessLock;
-std::atomic<unsigned long> zim::writer::IndexTask::waiting_task(0);
+zim::writer::PendingTasks zim::writer::IndexTask::waiting_tasks;
 
 namespace zim
 {
@@ -38,15 +38,15 @@ class IndexTask : public Task {
       mp_item(item),
       mp_indexer(indexer)
     {
-      ++waiting_task;
+      waiting_tasks.add();
     }
     virtual ~IndexTask()
     {
-      --waiting_task;
+      waiting_tasks.remove();
     }
 
     virtual void run(CreatorData* data);
-    static std::atomic<unsigned long> waiting_task;
+    static PendingTasks waiting_tasks;
 
   private:
     std::shared_ptr<Item> mp_item;
@@ -20,14 +20,23 @@
 #define ZIM_PRIVATE
 #include <zim/zim.h>
 #include <zim/archive.h>
+#include <zim/error.h>
 #include <zim/item.h>
 #include <zim/search.h>
 
 #include "tools.h"
 #include "../src/fs.h"
+#include "../src/fileimpl.h"
 
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
 namespace
 {
 
@@ -269,6 +278,28 @@ TEST(ZimArchive, validate)
   );
 }
 
+TEST(ZimArchive, checkIntegrityWithThreads)
+{
+  zim::IntegrityCheckList checksToRun;
+  checksToRun.set();
+  checksToRun.reset(size_t(zim::IntegrityCheck::CHECKSUM));
+
+  for (unsigned nbThreads: {1, 2, 4}) {
+    zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+    ASSERT_TRUE(archive.checkAll(nbThreads)) << nbThreads;
+    ASSERT_TRUE(archive.checkIntegrity(zim::IntegrityCheck::CLUSTER_DATA, nbThreads)) << nbThreads;
+
+    // The reported failure doesn't depend on the number of threads.
+    zim::Archive broken("./data/invalid.nonsorted_title_index.zim");
+    CapturedStderr stderror;
+    EXPECT_FALSE(broken.checkIntegrity(checksToRun, nbThreads)) << nbThreads;
+    EXPECT_EQ(
+      "Title index is not properly sorted.\n",
+      std::string(stderror)
+    ) << nbThreads;
+  }
+}
+
 void checkEquivalence(const zim::Archive& archive1, const zim::Archive& archive2)
 {
   EXPECT_EQ(archive1.getFilesize(), archive2.getFilesize());
@@ -352,6 +383,315 @@ TEST(ZimArchive, multipart)
   checkEquivalence(archive1, archive2);
 }
 
+TEST(ZimArchive, openLazily)
+{
+  const zim::Archive archive1("./data/wikibooks_be_all_nopic_2017-02.zim");
+  const zim::Archive archive2("./data/wikibooks_be_all_nopic_2017-02.zim", zim::OpenMode::LAZY);
+  checkEquivalence(archive1, archive2);
+
+  // The first uses of the archive may be concurrent.
+  const zim::Archive archive3("./data/wikibooks_be_all_nopic_2017-02.zim", zim::OpenMode::LAZY);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      EXPECT_EQ(archive1.getEntryCount(), archive3.getEntryCount());
+      EXPECT_EQ(archive1.getMainEntry().getPath(), archive3.getMainEntry().getPath());
+      const auto entry = archive3.getEntryByPath(archive1.getMainEntry().getPath());
+      EXPECT_EQ(entry.getTitle(), archive3.getEntryByTitle(entry.getTitle()).getTitle());
+      EXPECT_EQ(entry.getItem(true).getMimetype(), archive1.getMainEntry().getItem(true).getMimetype());
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+
+  // The header is checked when opening the archive...
+  EXPECT_THROW(zim::Archive("./data/invalid.outofbounds_urlptrpos.zim", zim::OpenMode::LAZY),
+               zim::ZimFileFormatError);
+
+  // ... but the other parts are only checked when used.
+  const zim::Archive broken("./data/invalid.nonsorted_dirent_table.zim", zim::OpenMode::LAZY);
+  EXPECT_THROW(broken.getEntryByPath("A/main.html"), zim::ZimFileFormatError);
+}
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+TEST(ZimArchive, registry)
+{
+  std::weak_ptr<zim::FileImpl> impl;
+  {
+    const auto archive1 = zim::ArchiveRegistry::open("./data/small.zim");
+    impl = archive1.getImpl();
+
+    // Same file, other path.
+    const auto archive2 = zim::ArchiveRegistry::open("data/../data/small.zim", zim::OpenMode::LAZY);
+    EXPECT_EQ(archive1.getImpl(), archive2.getImpl());
+
+    // Same archive (UUID and size), other file.
+    const auto tmpfile = makeTempFile("small_copy", readFile("./data/small.zim"));
+    const auto archive3 = zim::ArchiveRegistry::open(tmpfile->path());
+    EXPECT_EQ(archive1.getImpl(), archive3.getImpl());
+
+    // Other archive.
+    const auto archive4 = zim::ArchiveRegistry::open("./data/wikibooks_be_all_nopic_2017-02.zim");
+    EXPECT_NE(archive1.getImpl(), archive4.getImpl());
+
+    // Not registered.
+    const zim::Archive archive5("./data/small.zim");
+    EXPECT_NE(archive1.getImpl(), archive5.getImpl());
+  }
+  // The registry doesn't keep the archives open.
+  EXPECT_TRUE(impl.expired());
+
+  EXPECT_THROW(zim::ArchiveRegistry::open("./data/invalid.outofbounds_urlptrpos.zim"),
+               zim::ZimFileFormatError);
+}
+
+TEST(ZimArchive, maxOpenFiles)
+{
+  const auto maxOpenFiles = zim::ArchiveRegistry::getMaxOpenFiles();
+  zim::ArchiveRegistry::setMaxOpenFiles(1);
+  {
+    const zim::Archive small("./data/small.zim");
+    const zim::Archive archive1("./data/wikibooks_be_all_nopic_2017-02.zim");
+    zim::Archive archive2("./data/wikibooks_be_all_nopic_2017-02_splitted.zim");
+    EXPECT_EQ(zim::ArchiveRegistry::getOpenFileCount(), 1U);
+
+    // The files are reopened when needed.
+    checkEquivalence(archive1, archive2);
+    EXPECT_TRUE(small.check());
+    EXPECT_TRUE(archive2.checkIntegrity(zim::IntegrityCheck::CHECKSUM));
+    EXPECT_LE(zim::ArchiveRegistry::getOpenFileCount(), 1U);
+  }
+  zim::ArchiveRegistry::setMaxOpenFiles(maxOpenFiles);
+}
+
+TEST(ZimArchive, maxOpenFilesReplacedFile)
+{
+  const auto maxOpenFiles = zim::ArchiveRegistry::getMaxOpenFiles();
+  zim::ArchiveRegistry::setMaxOpenFiles(1);
+  {
+    const auto content = readFile("./data/small.zim");
+    const auto tmpfile = makeTempFile("small_replaced", content);
+    const zim::Archive archive(tmpfile->path());
+    const zim::Archive other("./data/wikibooks_be_all_nopic_2017-02.zim");
+    EXPECT_EQ(zim::ArchiveRegistry::getOpenFileCount(), 1U);
+
+    // The closed file is not reopened if its path names another file.
+    std::remove(tmpfile->path().c_str());
+    std::ofstream(tmpfile->path(), std::ios::binary) << content;
+    EXPECT_THROW(archive.getMainEntry().getItem(true).getData(), std::runtime_error);
+    EXPECT_FALSE(archive.check());
+  }
+  zim::ArchiveRegistry::setMaxOpenFiles(maxOpenFiles);
+}
+
+TEST(ZimArchive, mmapPolicy)
+{
+  const std::vector<zim::MemoryRegion> regions{
+    zim::MemoryRegion::POINTER_TABLES,
+    zim::MemoryRegion::CLUSTERS,
+    zim::MemoryRegion::BLOBS
+  };
+  std::vector<zim::MmapPolicy> defaultPolicies;
+  for (const auto region: regions) {
+    defaultPolicies.push_back(zim::getMmapPolicy(region));
+  }
+
+  for (const auto policy: {zim::MmapPolicy::POPULATE, zim::MmapPolicy::LAZY, zim::MmapPolicy::RANDOM,
+                           zim::MmapPolicy::WILLNEED, zim::MmapPolicy::HUGEPAGE}) {
+    for (const auto region: regions) {
+      zim::setMmapPolicy(region, policy);
+      EXPECT_EQ(policy, zim::getMmapPolicy(region));
+    }
+    const zim::Archive archive1("./data/wikibooks_be_all_nopic_2017-02.zim");
+    const zim::Archive archive2("./data/wikibooks_be_all_nopic_2017-02_splitted.zim");
+    checkEquivalence(archive1, archive2);
+  }
+
+  for (size_t i = 0; i < regions.size(); ++i) {
+    zim::setMmapPolicy(regions[i], defaultPolicies[i]);
+  }
+}
+
+TEST(ZimArchive, clusterCacheSize)
+{
+  zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+  archive.setClusterCacheMaxSize(1024*1024);
+  ASSERT_EQ(1024*1024U, archive.getClusterCacheMaxSize());
+
+  for ( auto entry : archive.iterEfficient() ) {
+    if (!entry.isRedirect()) {
+      entry.getItem().getData();
+    }
+    ASSERT_LE(archive.getClusterCacheCurrentSize(), archive.getClusterCacheMaxSize());
+  }
+  ASSERT_NE(0U, archive.getClusterCacheCurrentSize());
+
+  archive.setClusterCacheMaxSize(0);
+  ASSERT_EQ(0U, archive.getClusterCacheCurrentSize());
+  for ( auto entry : archive.iterEfficient() ) {
+    if (!entry.isRedirect()) {
+      entry.getItem().getData();
+    }
+  }
+  ASSERT_EQ(0U, archive.getClusterCacheCurrentSize());
+}
+
+TEST(ZimArchive, getEntriesByPath)
+{
+  zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+
+  std::vector<std::string> paths;
+  for (zim::entry_index_type i = 0; i < archive.getEntryCount(); i += 3) {
+    const auto path = archive.getEntryByPath(i).getPath();
+    paths.push_back(path);
+    paths.push_back(path + "_");
+    // Path without namespace
+    paths.push_back(path.substr(2));
+  }
+  paths.push_back("");
+  paths.push_back("/");
+  std::reverse(paths.begin(), paths.end());
+
+  // With the dirent cache, then with the preloaded dirent table.
+  for (bool preloaded: {false, true}) {
+    if (preloaded) {
+      archive.preloadDirents();
+    }
+    const auto results = archive.getEntriesByPath(paths);
+    ASSERT_EQ(paths.size(), results.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (archive.hasEntryByPath(paths[i])) {
+        ASSERT_TRUE(results[i].first) << paths[i];
+        ASSERT_EQ(archive.getEntryByPath(paths[i]).getIndex(), results[i].second) << paths[i];
+      } else {
+        ASSERT_FALSE(results[i].first) << paths[i];
+      }
+    }
+  }
+}
+
+TEST(ZimArchive, prefetch)
+{
+  zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+  const auto impl = archive.getImpl();
+
+  std::vector<std::string> paths;
+  for (auto entry: archive.iterByPath()) {
+    paths.push_back(entry.getPath());
+  }
+  paths.push_back("non/existent/path");
+
+  archive.prefetch(paths, false);
+  impl->waitPrefetchTasks();
+  ASSERT_EQ(0U, archive.getClusterCacheCurrentSize());
+
+  archive.prefetch(paths);
+  impl->waitPrefetchTasks();
+  const auto cacheSize = archive.getClusterCacheCurrentSize();
+  ASSERT_NE(0U, cacheSize);
+
+  // Everything is already in the cache
+  for (auto entry: archive.iterByPath()) {
+    if (!entry.isRedirect()) {
+      entry.getItem().getData();
+    }
+  }
+  ASSERT_EQ(cacheSize, archive.getClusterCacheCurrentSize());
+
+  archive.setClusterCacheMaxSize(0);
+  archive.prefetch(std::vector<zim::entry_index_type>{0, 1, 2, archive.getEntryCount() + 10});
+  impl->waitPrefetchTasks();
+  ASSERT_EQ(0U, archive.getClusterCacheCurrentSize());
+}
+
+TEST(ZimArchive, forEachItem)
+{
+  zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+
+  std::map<zim::entry_index_type, std::string> expected;
+  for (auto entry: archive.iterEfficient()) {
+    if (!entry.isRedirect()) {
+      expected[entry.getIndex()] = entry.getItem().getData();
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+
+  for (unsigned nbThreads: {0, 1, 3}) {
+    std::mutex mutex;
+    std::map<zim::entry_index_type, std::string> visited;
+    archive.forEachItem([&](const zim::Item& item, const zim::Blob& data) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ASSERT_TRUE(visited.insert({item.getIndex(), data}).second);
+    }, nbThreads);
+    ASSERT_EQ(expected, visited);
+  }
+
+  std::atomic<int> calls(0);
+  ASSERT_THROW(archive.forEachItem([&](const zim::Item&, const zim::Blob&) {
+    if (++calls == 5) {
+      throw std::runtime_error("stop");
+    }
+  }, 2), std::runtime_error);
+  ASSERT_LT(calls.load(), int(expected.size()));
+}
+
+TEST(ZimArchive, checkWithProgress)
+{
+  for (auto path: {"./data/wikibooks_be_all_nopic_2017-02.zim",
+                   "./data/wikibooks_be_all_nopic_2017-02_splitted.zim"}) {
+    const zim::Archive archive(path);
+    std::vector<std::pair<zim::size_type, zim::size_type>> calls;
+    ASSERT_TRUE(archive.check([&](zim::size_type checked, zim::size_type total) {
+      calls.push_back({checked, total});
+    })) << path;
+
+    // The whole archive is checked, except for the checksum itself.
+    ASSERT_FALSE(calls.empty()) << path;
+    ASSERT_EQ(archive.getFilesize() - 16, calls.back().first) << path;
+    for (size_t i = 0; i < calls.size(); ++i) {
+      ASSERT_EQ(calls.back().first, calls[i].second) << path;
+      if (i > 0) {
+        ASSERT_LT(calls[i-1].first, calls[i].first) << path;
+      }
+    }
+  }
+}
+
+TEST(ZimArchive, preloadDirents)
+{
+  zim::Archive archive("./data/wikibooks_be_all_nopic_2017-02.zim");
+  zim::Archive preloaded("./data/wikibooks_be_all_nopic_2017-02.zim");
+  preloaded.preloadDirents();
+  preloaded.preloadDirents();
+
+  ASSERT_EQ(archive.getEntryCount(), preloaded.getEntryCount());
+  for (zim::entry_index_type i = 0; i < archive.getEntryCount(); ++i) {
+    const auto entry = archive.getEntryByPath(i);
+    const auto preloadedEntry = preloaded.getEntryByPath(i);
+    ASSERT_EQ(entry.getPath(), preloadedEntry.getPath());
+    ASSERT_EQ(entry.getTitle(), preloadedEntry.getTitle());
+    ASSERT_EQ(entry.isRedirect(), preloadedEntry.isRedirect());
+    if (entry.isRedirect()) {
+      ASSERT_EQ(entry.getRedirectEntry().getIndex(), preloadedEntry.getRedirectEntry().getIndex());
+    } else {
+      ASSERT_EQ(entry.getItem().getMimetype(), preloadedEntry.getItem().getMimetype());
+      ASSERT_EQ(entry.getItem().getData(), preloadedEntry.getItem().getData());
+    }
+
+    const auto found = preloaded.getEntryByPath(entry.getPath());
+    ASSERT_EQ(i, found.getIndex());
+  }
+
+  ASSERT_THROW(preloaded.getEntryByPath("non/existent/path"), zim::EntryNotFound);
+  ASSERT_THROW(preloaded.getEntryByPath(archive.getEntryCount()), std::out_of_range);
+}
+
 #ifdef _WIN32
 #include <fcntl.h>
 #include <sys/types.h>
@@ -374,6 +714,26 @@ TEST(ZimArchive, openByFD)
   checkEquivalence(archive1, archive2);
 }
 
+TEST(ZimArchive, openByFDWithMaxOpenFiles)
+{
+  const auto maxOpenFiles = zim::ArchiveRegistry::getMaxOpenFiles();
+  zim::ArchiveRegistry::setMaxOpenFiles(1);
+  {
+    const zim::Archive archive1("./data/small.zim");
+    const int fd = OPEN_READ_ONLY("./data/small.zim");
+    const zim::Archive archive2(fd);
+    close(fd);
+
+    // The file opened from a descriptor is never closed (it could not be
+    // reopened), the other one is.
+    const zim::Archive other("./data/wikibooks_be_all_nopic_2017-02.zim");
+    EXPECT_EQ(zim::ArchiveRegistry::getOpenFileCount(), 2U);
+    checkEquivalence(archive1, archive2);
+    EXPECT_EQ(zim::ArchiveRegistry::getOpenFileCount(), 2U);
+  }
+  zim::ArchiveRegistry::setMaxOpenFiles(maxOpenFiles);
+}
+
 TEST(ZimArchive, openZIMFileEmbeddedInAnotherFile)
 {
   const zim::Archive archive1("./data/small.zim");
@@ -381,6 +741,8 @@ TEST(ZimArchive, openZIMFileEmbeddedInAnotherFile)
   const zim::Archive archive2(fd, 8, archive1.getFilesize());
 
   checkEquivalence(archive1, archive2);
+  ASSERT_TRUE(archive1.check());
+  ASSERT_TRUE(archive2.check());
 }
 #endif
 
@@ -24,6 +24,8 @@
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 #if defined(_MSC_VER)
 # include <BaseTsd.h>
   typedef SSIZE_T ssize_t;
@@ -52,6 +54,7 @@
 #include "../src/file_part.h"
 #include "../src/file_compound.h"
 #include "../src/buffer_reader.h"
+#include "../src/buffer_pool.h"
 #include "../src/writer/cluster.h"
 #include "../src/endian_tools.h"
 #include "../src/config.h"
@@ -184,6 +187,169 @@ TEST(ClusterTest, read_write_clusterZstd)
   ASSERT_EQ(blob2, std::string(cluster2.getBlob(zim::blob_index_t(2))));
 }
 
+TEST(ClusterTest, read_write_clusterInMemory)
+{
+  for (auto comp: {zim::zimcompLzma, zim::zimcompZstd}) {
+    zim::writer::Cluster cluster(comp);
+
+    std::string blob0("123456789012345678901234567890");
+    std::string blob1(100*1024, 'a');
+    std::string blob2("abcdefghijklmnopqrstuvwxyz");
+
+    cluster.addContent(blob0);
+    cluster.addContent(blob1);
+    cluster.addContent(blob2);
+
+    cluster.close();
+    auto clusterBuffer = write_to_buffer(cluster);
+    // The cluster may be followed by other data in the archive.
+    std::string data(clusterBuffer.data(), clusterBuffer.size().v);
+    data += std::string(64, '\0');
+    auto buffer = zim::Buffer::makeBuffer(data.data(), zim::zsize_t(data.size()));
+
+    // Above the limit of the clusters read at once, the cluster is streamed.
+    for (auto maxSize: {buffer.size(), zim::zsize_t(64*1024*1024)}) {
+      const auto cluster2shptr = zim::Cluster::read(zim::BufferReader(buffer), zim::offset_t(0), maxSize);
+      zim::Cluster& cluster2 = *cluster2shptr;
+      ASSERT_EQ(cluster2.getCompression(), comp);
+      ASSERT_EQ(cluster2.count().v, 3U);
+      ASSERT_EQ(blob2, std::string(cluster2.getBlob(zim::blob_index_t(2))));
+      ASSERT_EQ(blob1, std::string(cluster2.getBlob(zim::blob_index_t(1))));
+      ASSERT_EQ(blob0, std::string(cluster2.getBlob(zim::blob_index_t(0))));
+    }
+  }
+}
+
+TEST(ClusterTest, read_write_clusterDecodedAtOnce)
+{
+  for (auto comp: {zim::zimcompLzma, zim::zimcompZstd}) {
+    zim::writer::Cluster cluster(comp);
+
+    std::string blob0("123456789012345678901234567890");
+    std::string blob1(100*1024, 'a');
+    std::string blob2("abcdefghijklmnopqrstuvwxyz");
+
+    cluster.addContent(blob0);
+    cluster.addContent(blob1);
+    cluster.addContent(blob2);
+
+    cluster.close();
+    auto buffer = write_to_buffer(cluster);
+    const auto contentSize = blob0.size() + blob1.size() + blob2.size();
+    // The content fits (or not) in the size of the clusters decoded at once.
+    for (auto maxDecodeSize: {contentSize, contentSize - 1}) {
+      const auto cluster2shptr = zim::Cluster::read(zim::BufferReader(buffer), zim::offset_t(0), buffer.size(), zim::zsize_t(maxDecodeSize));
+      zim::Cluster& cluster2 = *cluster2shptr;
+      ASSERT_EQ(cluster2.getCompression(), comp);
+      ASSERT_EQ(cluster2.count().v, 3U);
+      ASSERT_EQ(blob2, std::string(cluster2.getBlob(zim::blob_index_t(2))));
+      ASSERT_EQ(blob0, std::string(cluster2.getBlob(zim::blob_index_t(0))));
+      ASSERT_EQ("789", std::string(cluster2.getBlob(zim::blob_index_t(0), zim::offset_t(6), zim::zsize_t(3))));
+      ASSERT_EQ(blob1, std::string(cluster2.getBlob(zim::blob_index_t(1))));
+    }
+  }
+}
+
+TEST(ClusterTest, read_write_clusterZstdSeekable)
+{
+  zim::writer::Cluster cluster(zim::zimcompZstdSeekable);
+
+  std::vector<std::string> blobs;
+  blobs.push_back("123456789012345678901234567890");
+  blobs.push_back("");
+  blobs.push_back(std::string(200*1024, 'a'));
+  blobs.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+  for (int i = 0; i < 100; ++i) {
+    blobs.push_back(std::string(4*1024, char('a' + i%26)) + std::to_string(i));
+  }
+  blobs.push_back("abcdefghijklmnopqrstuvwxyz");
+
+  for (const auto& blob: blobs) {
+    cluster.addContent(blob);
+  }
+
+  cluster.close();
+  auto buffer = write_to_buffer(cluster);
+  const auto cluster2shptr = zim::Cluster::read(zim::BufferReader(buffer), zim::offset_t(0));
+  zim::Cluster& cluster2 = *cluster2shptr;
+  ASSERT_EQ(cluster2.isExtended, false);
+  ASSERT_EQ(cluster2.count().v, blobs.size());
+  ASSERT_EQ(cluster2.getCompression(), zim::zimcompZstdSeekable);
+  ASSERT_TRUE(cluster2.isCompressed());
+
+  // Access the blobs in reverse order, each frame is decoded independently.
+  for (auto i = blobs.size(); i > 0; --i) {
+    const zim::blob_index_t n(i-1);
+    ASSERT_EQ(cluster2.getBlobSize(n).v, blobs[n.v].size());
+    ASSERT_EQ(blobs[n.v], std::string(cluster2.getBlob(n)));
+  }
+  ASSERT_EQ(std::string("DEF"), std::string(cluster2.getBlob(zim::blob_index_t(3), zim::offset_t(3), zim::zsize_t(3))));
+}
+
+TEST(ClusterTest, read_clusterZstdSeekableInvalidCounts)
+{
+  zim::writer::Cluster cluster(zim::zimcompZstdSeekable);
+  cluster.addContent(std::string("123456789012345678901234567890"));
+  cluster.addContent(std::string("ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
+  cluster.close();
+  const auto buffer = write_to_buffer(cluster);
+  const std::string data(buffer.data(), buffer.size().v);
+
+  // The blob count, then the frame count, follow the cluster info byte.
+  for (auto position: {1, 5}) {
+    for (uint32_t count: {uint32_t(0xFFFFFFFF), uint32_t(0x7FFFFFFF), uint32_t(100)}) {
+      std::string invalidData(data);
+      zim::toLittleEndian(count, &invalidData[position]);
+      const auto invalidBuffer = zim::Buffer::makeBuffer(invalidData.data(), zim::zsize_t(invalidData.size()));
+      ASSERT_THROW(zim::Cluster::read(zim::BufferReader(invalidBuffer), zim::offset_t(0)), zim::ZimFileFormatError) << position << " " << count;
+    }
+  }
+}
+
+TEST(ClusterTest, decodedClusterBlobs)
+{
+  for (auto comp: {zim::zimcompLzma, zim::zimcompZstd}) {
+    zim::writer::Cluster cluster(comp);
+    std::vector<std::string> blobs;
+    for (int i = 0; i < 64; ++i) {
+      blobs.push_back(std::string(4*1024, char('a' + i%26)) + std::to_string(i));
+      cluster.addContent(blobs.back());
+    }
+    cluster.close();
+    const auto buffer = write_to_buffer(cluster);
+    const zim::zsize_t maxDecodeSize(1024*1024);
+
+    {
+      const auto cluster2 = zim::Cluster::read(zim::BufferReader(buffer), zim::offset_t(0), zim::zsize_t(0), maxDecodeSize);
+
+      // The blobs are views of the content, decoded at once.
+      const zim::Blob blob0 = cluster2->getBlob(zim::blob_index_t(0));
+      const zim::Blob blob1 = cluster2->getBlob(zim::blob_index_t(1));
+      ASSERT_EQ(blob0.data() + blob0.size(), blob1.data());
+
+      std::vector<std::thread> threads;
+      for (unsigned t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+          for (size_t i = 0; i < blobs.size(); ++i) {
+            const zim::blob_index_t n((i + t * 16) % blobs.size());
+            EXPECT_EQ(blobs[n.v], std::string(cluster2->getBlob(n)));
+          }
+        });
+      }
+      for (auto& thread: threads) {
+        thread.join();
+      }
+    }
+
+    // The memory of the content is reused by the next decoded cluster.
+    const auto freeSize = zim::BufferPool::instance().getFreeSize();
+    ASSERT_GT(freeSize, 0U);
+    const auto cluster3 = zim::Cluster::read(zim::BufferReader(buffer), zim::offset_t(0), zim::zsize_t(0), maxDecodeSize);
+    ASSERT_LT(zim::BufferPool::instance().getFreeSize(), freeSize);
+    ASSERT_EQ(blobs[3], std::string(cluster3->getBlob(zim::blob_index_t(3))));
+  }
+}
+
 class FakeProvider : public zim::writer::ContentProvider
 {
   public:
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <thread>
 #include "gtest/gtest.h"
 
 #include <zim/zim.h>
@@ -100,5 +101,40 @@ TYPED_TEST(CompressionTest, compress) {
   }
 }
 
+// The decoder contexts are reused by the next decodings, in any thread.
+TYPED_TEST(CompressionTest, decodeInParallel) {
+  std::string data;
+  for (int i=0; i<100000; i++) {
+    data.append(1, (char)(i%251));
+  }
+
+  typename TestFixture::CompressorT compressor;
+  compressor.init(const_cast<char*>(data.c_str()));
+  compressor.feed(data.c_str(), data.size());
+  zim::zsize_t comp_size;
+  const auto comp_data = compressor.get_data(&comp_size);
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (unsigned i = 0; i < 10; ++i) {
+        typename TestFixture::DecompressorT decompressor;
+        decompressor.init(comp_data.get());
+        // Stop in the middle of the stream, the next decoding starts anew.
+        const auto size = i % 2 ? comp_size.v : comp_size.v / 2;
+        decompressor.feed(comp_data.get(), size);
+        zim::zsize_t decomp_size;
+        const auto decomp_data = decompressor.get_data(&decomp_size);
+        if (i % 2) {
+          EXPECT_EQ(data, std::string(decomp_data.get(), decomp_size.v));
+        }
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+}
+
 
 }  // namespace
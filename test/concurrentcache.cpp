@@ -0,0 +1,224 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "clockcache.h"
+#include "concurrent_cache.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+TEST(ClockCacheTest, KeepsAllValuesWithinCapacity) {
+  zim::clock_cache<int, int> cache(50);
+
+  for (int i = 0; i < 100; ++i) {
+    cache.put(i, i);
+  }
+
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_FALSE(cache.exists(i));
+  }
+
+  for (int i = 50; i < 100; ++i) {
+    EXPECT_TRUE(cache.exists(i));
+    EXPECT_EQ(i, cache.get(i));
+  }
+  EXPECT_EQ(50U, cache.size());
+}
+
+TEST(ClockCacheTest, ReferencedValuesSurviveEviction) {
+  zim::clock_cache<int, int> cache(3);
+  cache.put(1, 1);
+  cache.put(2, 2);
+  cache.put(3, 3);
+  EXPECT_TRUE(cache.get(1).hit());
+
+  cache.put(4, 4);
+  EXPECT_TRUE(cache.exists(1));
+  EXPECT_FALSE(cache.exists(2));
+  EXPECT_TRUE(cache.exists(3));
+  EXPECT_TRUE(cache.exists(4));
+}
+
+TEST(ClockCacheTest, Drop) {
+  zim::clock_cache<int, int> cache(3);
+  cache.put(1, 1);
+  cache.put(2, 2);
+  cache.put(3, 3);
+
+  EXPECT_TRUE(cache.drop(1));
+  EXPECT_FALSE(cache.drop(1));
+  EXPECT_FALSE(cache.exists(1));
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_EQ(3, cache.get(3));
+
+  cache.put(4, 4);
+  EXPECT_EQ(3U, cache.size());
+  EXPECT_EQ(2, cache.get(2));
+  EXPECT_EQ(3, cache.get(3));
+  EXPECT_EQ(4, cache.get(4));
+}
+
+TEST(ClockCacheTest, ZeroCapacity) {
+  zim::clock_cache<int, int> cache(0);
+  EXPECT_TRUE(cache.getOrPut(1, 1).miss());
+  EXPECT_FALSE(cache.exists(1));
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ClockCacheTest, Cost) {
+  zim::clock_cache<int, int> cache(10);
+  cache.put(1, 1);
+  cache.put(2, 2);
+  cache.put(3, 3);
+  EXPECT_EQ(3U, cache.cost());
+
+  cache.setCost(2, 5);
+  EXPECT_EQ(7U, cache.cost());
+  EXPECT_EQ(3U, cache.size());
+
+  // Entry 2 is the most recently used one, the others go first.
+  cache.setCost(2, 7);
+  EXPECT_EQ(9U, cache.cost());
+  cache.get(3);
+  cache.setCost(3, 3);
+  EXPECT_EQ(10U, cache.cost());
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_FALSE(cache.exists(1));
+
+  // Entries bigger than the cache are evicted too.
+  cache.setCost(2, 11);
+  EXPECT_EQ(3U, cache.cost());
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_TRUE(cache.exists(3));
+}
+
+TEST(ClockCacheTest, SetMaxCost) {
+  zim::clock_cache<int, int> cache(10);
+  for (int i = 0; i < 10; ++i) {
+    cache.put(i, i);
+  }
+  cache.setMaxCost(4);
+  EXPECT_EQ(4U, cache.size());
+  for (int i = 6; i < 10; ++i) {
+    EXPECT_TRUE(cache.exists(i));
+  }
+}
+
+TEST(ConcurrentCacheTest, Sharding) {
+  typedef zim::ConcurrentCache<int, int> Cache;
+  EXPECT_EQ(16U, Cache(0).shardCount());
+  EXPECT_EQ(16U, Cache(512).shardCount());
+  EXPECT_EQ(3U, Cache(512, 3).shardCount());
+  EXPECT_EQ(1U, Cache(512, 0).shardCount());
+
+  zim::ConcurrentCache<int, int> cache(100, 7);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(i, cache.getOrPut(i, [=](){ return i; }));
+  }
+  EXPECT_EQ(100U, cache.size());
+}
+
+TEST(ConcurrentCacheTest, GetOrPut) {
+  zim::ConcurrentCache<int, int> cache(16);
+  int calls = 0;
+  const auto f = [&](){ ++calls; return 7; };
+  EXPECT_EQ(7, cache.getOrPut(1, f));
+  EXPECT_EQ(7, cache.getOrPut(1, f));
+  EXPECT_EQ(1, calls);
+}
+
+struct StringSize
+{
+  static size_t cost(const std::string& s) { return s.size(); }
+};
+
+TEST(ConcurrentCacheTest, CostEstimation) {
+  zim::ConcurrentCache<int, std::string, StringSize> cache(400, 4);
+  EXPECT_EQ(400U, cache.maxCost());
+
+  // The budget is shared by the shards.
+  for (int i = 0; i < 100; ++i) {
+    cache.getOrPut(i, [](){ return std::string(30, 'a'); });
+    EXPECT_LE(cache.cost(), 400U);
+  }
+  EXPECT_EQ(390U, cache.cost());
+  EXPECT_EQ(13U, cache.size());
+
+  cache.setMaxCost(200);
+  EXPECT_EQ(200U, cache.maxCost());
+  EXPECT_EQ(180U, cache.cost());
+  EXPECT_EQ(6U, cache.size());
+
+  // Too big to be cached
+  EXPECT_EQ(260U, cache.getOrPut(1000, [](){ return std::string(260, 'b'); }).size());
+  EXPECT_FALSE(cache.exists(1000));
+  EXPECT_LE(cache.cost(), 200U);
+}
+
+TEST(ConcurrentCacheTest, BigValue) {
+  zim::ConcurrentCache<int, std::string, StringSize> cache(400, 4);
+
+  // A value may take (almost) the whole budget, not only the share of its
+  // shard.
+  cache.getOrPut(0, [](){ return std::string(30, 'a'); });
+  cache.getOrPut(1, [](){ return std::string(350, 'b'); });
+  EXPECT_TRUE(cache.exists(0));
+  EXPECT_TRUE(cache.exists(1));
+  EXPECT_EQ(380U, cache.cost());
+
+  cache.getOrPut(2, [](){ return std::string(100, 'c'); });
+  EXPECT_LE(cache.cost(), 400U);
+  EXPECT_EQ(cache.cost(), 30U * cache.exists(0) + 350U * cache.exists(1) + 100U * cache.exists(2));
+}
+
+TEST(ConcurrentCacheTest, FailureIsNotCached) {
+  zim::ConcurrentCache<int, int> cache(16);
+  EXPECT_THROW(cache.getOrPut(1, [](){ return std::stoi("x"); }), std::invalid_argument);
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(2, cache.getOrPut(1, [](){ return 2; }));
+}
+
+TEST(ConcurrentCacheTest, SingleFlight) {
+  zim::ConcurrentCache<int, int> cache(64);
+  std::atomic<int> calls(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&](){
+      for (int i = 0; i < 64; ++i) {
+        const int v = cache.getOrPut(i, [&](){
+          ++calls;
+          std::this_thread::yield();
+          return i * 2;
+        });
+        EXPECT_EQ(i * 2, v);
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  EXPECT_EQ(64, calls.load());
+}
+
+} // unnamed namespace
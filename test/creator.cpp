@@ -18,6 +18,8 @@
  */
 
 #include <zim/zim.h>
+#include <zim/archive.h>
+#include <zim/error.h>
 #include <zim/writer/creator.h>
 #include <zim/writer/item.h>
 #include <zim/writer/contentProvider.h>
@@ -31,9 +33,14 @@
 #include "../src/fileheader.h"
 #include "../src/cluster.h"
 #include "../src/rawstreamreader.h"
+#include "../src/fileimpl.h"
 
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <functional>
+#include <future>
+
 namespace
 {
 
@@ -114,12 +121,14 @@ TEST(ZimCreator, createEmptyZim)
   header.read(*reader);
   ASSERT_FALSE(header.hasMainPage());
 #if defined(ENABLE_XAPIAN)
-  entry_index_type nb_entry = 3; // xapiantitleIndex and titleListIndexes (*2)
+  entry_index_type nb_entry = 5; // xapiantitleIndex, lookupGrid, titleListIndexes (*2) and clusterListIndex
   int xapian_mimetype = 0;
-  int listing_mimetype = 1;
+  int grid_mimetype = 1;
+  int listing_mimetype = 2;
 #else
-  entry_index_type nb_entry = 2; // titleListIndexes (*2)
-  int listing_mimetype = 0;
+  entry_index_type nb_entry = 4; // lookupGrid, titleListIndexes (*2) and clusterListIndex
+  int grid_mimetype = 0;
+  int listing_mimetype = 1;
 #endif
   ASSERT_EQ(header.getArticleCount(), nb_entry);
 
@@ -129,15 +138,22 @@ TEST(ZimCreator, createEmptyZim)
   std::shared_ptr<const Dirent> dirent;
 
   dirent = direntAccessor.getDirent(entry_index_t(0));
+  test_article_dirent(dirent, 'X', "index/lookupGrid/v0", None, grid_mimetype, cluster_index_t(0), None);
+
+  dirent = direntAccessor.getDirent(entry_index_t(1));
+  test_article_dirent(dirent, 'X', "listing/clusterOrdered/v0", None, listing_mimetype, cluster_index_t(0), None);
+  auto clusterListingBlobIndex = dirent->getBlobNumber();
+
+  dirent = direntAccessor.getDirent(entry_index_t(2));
   test_article_dirent(dirent, 'X', "listing/titleOrdered/v0", None, listing_mimetype, cluster_index_t(0), None);
   auto v0BlobIndex = dirent->getBlobNumber();
 
-  dirent = direntAccessor.getDirent(entry_index_t(1));
+  dirent = direntAccessor.getDirent(entry_index_t(3));
   test_article_dirent(dirent, 'X', "listing/titleOrdered/v1", None, listing_mimetype, cluster_index_t(0), None);
   auto v1BlobIndex = dirent->getBlobNumber();
 
 #if defined(ENABLE_XAPIAN)
-  dirent = direntAccessor.getDirent(entry_index_t(2));
+  dirent = direntAccessor.getDirent(entry_index_t(4));
   test_article_dirent(dirent, 'X', "title/xapian", None, xapian_mimetype, cluster_index_t(0), None);
 #endif
 
@@ -150,6 +166,8 @@ TEST(ZimCreator, createEmptyZim)
   ASSERT_EQ(blob.size(), nb_entry*sizeof(title_index_t));
   blob = cluster->getBlob(v1BlobIndex);
   ASSERT_EQ(blob.size(), 0);
+  blob = cluster->getBlob(clusterListingBlobIndex);
+  ASSERT_EQ(blob.size(), 0);
 }
 
 
@@ -205,16 +223,18 @@ TEST(ZimCreator, createZim)
   header.read(*reader);
   ASSERT_TRUE(header.hasMainPage());
 #if defined(ENABLE_XAPIAN)
-  entry_index_type nb_entry = 9; // xapiantitleIndex + xapianfulltextIndex + foo + foo2 + foo3 + Title + mainPage + titleListIndexes*2
+  entry_index_type nb_entry = 11; // xapiantitleIndex + xapianfulltextIndex + foo + foo2 + foo3 + Title + mainPage + lookupGrid + titleListIndexes*2 + clusterListIndex
   int xapian_mimetype = 0;
+  int grid_mimetype = 1;
+  int listing_mimetype = 2;
+  int html_mimetype = 3;
+  int plain_mimetype = 4;
+#else
+  entry_index_type nb_entry = 9; // foo + foo2 + foo3 + Title + mainPage + lookupGrid + titleListIndexes*2 + clusterListIndex
+  int grid_mimetype = 0;
   int listing_mimetype = 1;
   int html_mimetype = 2;
   int plain_mimetype = 3;
-#else
-  entry_index_type nb_entry = 7; // foo + foo2 + foo3 + Title + mainPage + titleListIndexes*2
-  int listing_mimetype = 0;
-  int html_mimetype = 1;
-  int plain_mimetype = 2;
 #endif
 
   ASSERT_EQ(header.getArticleCount(), nb_entry);
@@ -248,6 +268,13 @@ TEST(ZimCreator, createZim)
   test_article_dirent(dirent, 'X', "fulltext/xapian", "fulltext/xapian", xapian_mimetype, cluster_index_t(1), None);
 #endif
 
+  dirent = direntAccessor.getDirent(entry_index_t(direntIdx++));
+  test_article_dirent(dirent, 'X', "index/lookupGrid/v0", None, grid_mimetype, cluster_index_t(1), None);
+
+  dirent = direntAccessor.getDirent(entry_index_t(direntIdx++));
+  test_article_dirent(dirent, 'X', "listing/clusterOrdered/v0", None, listing_mimetype, cluster_index_t(1), None);
+  auto clusterListingBlobIndex = dirent->getBlobNumber();
+
   dirent = direntAccessor.getDirent(entry_index_t(direntIdx++));
   test_article_dirent(dirent, 'X', "listing/titleOrdered/v0", None, listing_mimetype, cluster_index_t(1), None);
   auto v0BlobIndex = dirent->getBlobNumber();
@@ -295,10 +322,12 @@ TEST(ZimCreator, createZim)
     3, 0, 0, 0,
     4, 0, 0, 0,
     5, 0, 0, 0,
-    6, 0, 0, 0
+    6, 0, 0, 0,
+    7, 0, 0, 0,
+    8, 0, 0, 0
 #if defined(ENABLE_XAPIAN)
-    ,7, 0, 0, 0
-    ,8, 0, 0, 0
+    ,9, 0, 0, 0
+    ,10, 0, 0, 0
 #endif
     };
   ASSERT_EQ(blob0Data, expectedBlob0Data);
@@ -311,6 +340,398 @@ TEST(ZimCreator, createZim)
     0, 0, 0, 0
   };
   ASSERT_EQ(blob1Data, expectedBlob1Data);
+
+  // foo and foo2 are in the cluster 0, the redirection foo3 is sorted as
+  // if it was in the cluster 0 too.
+  blob = cluster->getBlob(clusterListingBlobIndex);
+  std::vector<char> clusterListingData(blob.data(), blob.end());
+  std::vector<char> expectedClusterListingData = {
+    0, 0, 0, 0,
+    1, 0, 0, 0,
+    2, 0, 0, 0
+  };
+  ASSERT_EQ(clusterListingData, expectedClusterListingData);
+}
+
+class UncompressedTestItem : public TestItem
+{
+  public:
+    UncompressedTestItem(const std::string& path, const std::string& title, const std::string& content):
+      TestItem(path, title, content) { }
+
+    virtual writer::Hints getHints() const { return { { writer::COMPRESS, 0 } }; }
+};
+
+TEST(ZimCreator, createZimClusterOrderListing)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  writer::Creator creator;
+  creator.configMinClusterSize(1);
+  creator.startZimCreation(tempPath);
+  for (auto i = 0; i < 300; ++i) {
+    const auto n = std::to_string((i * 7) % 300);
+    const std::string content(300, 'a' + i % 26);
+    if (i % 3) {
+      creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, content));
+    } else {
+      creator.addItem(std::make_shared<UncompressedTestItem>("path" + n, "Title" + n, content));
+    }
+    if (i % 10 == 0) {
+      creator.addRedirection("redirect" + n, "Redirect" + n, "path" + n);
+    }
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  const auto impl = archive.getImpl();
+  ASSERT_TRUE(impl->findx('X', "listing/clusterOrdered/v0").first);
+  ASSERT_GT(impl->getCountClusters().v, 4U);
+
+  // The order computed from the dirents.
+  std::vector<std::pair<cluster_index_type, entry_index_type>> expected;
+  for (auto i = impl->getStartUserEntry().v; i < impl->getEndUserEntry().v; ++i) {
+    const auto dirent = impl->getDirent(entry_index_t(i));
+    expected.push_back({dirent->isRedirect() ? 0 : dirent->getClusterNumber().v, i});
+  }
+  std::sort(expected.begin(), expected.end());
+
+  ASSERT_EQ(expected.size(), 330U);
+  for (entry_index_type i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(impl->getIndexByClusterOrder(entry_index_t(i)).v, expected[i].second);
+  }
+  ASSERT_THROW(impl->getIndexByClusterOrder(entry_index_t(330)), std::out_of_range);
+}
+
+TEST(ZimCreator, createZimWithSmallQueues)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  // Adding content waits for the workers at each cluster.
+  writer::Creator creator;
+  creator.configMinClusterSize(1);
+  creator.configNbWorkers(2);
+  creator.configQueueSize(1);
+  creator.startZimCreation(tempPath);
+  for (auto i = 0; i < 100; ++i) {
+    const auto n = std::to_string(i);
+    const std::string content(300, 'a' + i % 26);
+    if (i % 2) {
+      creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, content));
+    } else {
+      creator.addItem(std::make_shared<UncompressedTestItem>("path" + n, "Title" + n, content));
+    }
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  ASSERT_GT(archive.getImpl()->getCountClusters().v, 20U);
+  for (auto i = 0; i < 100; ++i) {
+    const auto n = std::to_string(i);
+    const std::string content(300, 'a' + i % 26);
+    ASSERT_EQ(std::string(archive.getEntryByPath("path" + n).getItem().getData()), content);
+  }
+  ASSERT_TRUE(archive.check());
+}
+
+// Feeds its content once `released` is ready (or after a timeout).
+class WaitingProvider : public writer::ContentProvider
+{
+  public:
+    WaitingProvider(const std::string& content, std::shared_future<void> released)
+      : provider(content), released(released) {}
+    zim::size_type getSize() const { return provider.getSize(); }
+    Blob feed() {
+      released.wait_for(std::chrono::seconds(10));
+      return provider.feed();
+    }
+
+  private:
+    writer::StringProvider provider;
+    std::shared_future<void> released;
+};
+
+// Sets `fed` once its content is fed.
+class NotifyingProvider : public writer::StringProvider
+{
+  public:
+    NotifyingProvider(const std::string& content, std::shared_ptr<std::promise<void>> fed)
+      : writer::StringProvider(content), fed(fed) {}
+    Blob feed() {
+      if (fed) {
+        fed->set_value();
+        fed.reset();
+      }
+      return writer::StringProvider::feed();
+    }
+
+  private:
+    std::shared_ptr<std::promise<void>> fed;
+};
+
+class ProviderTestItem : public TestItem
+{
+  public:
+    ProviderTestItem(const std::string& path, std::function<writer::ContentProvider*()> makeProvider)
+      : TestItem(path, path, ""), makeProvider(makeProvider) {}
+    virtual std::unique_ptr<writer::ContentProvider> getContentProvider() const {
+      return std::unique_ptr<writer::ContentProvider>(makeProvider());
+    }
+
+  private:
+    std::function<writer::ContentProvider*()> makeProvider;
+};
+
+TEST(ZimCreator, createZimClustersOutOfOrder)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  // The first cluster is compressed (and written) only once the second
+  // one has been compressed.
+  const std::string content0(1000, 'a');
+  const std::string content1(1000, 'b');
+  auto fed = std::make_shared<std::promise<void>>();
+  const std::shared_future<void> released = fed->get_future().share();
+
+  writer::Creator creator;
+  creator.configMinClusterSize(1);
+  creator.configNbWorkers(2);
+  creator.configClusterCompletionOrder(true);
+  creator.startZimCreation(tempPath);
+  creator.addItem(std::make_shared<ProviderTestItem>("path0", [=]() {
+    return new WaitingProvider(content0, released);
+  }));
+  creator.addItem(std::make_shared<ProviderTestItem>("path1", [=]() {
+    return new NotifyingProvider(content1, fed);
+  }));
+  for (auto i = 2; i < 50; ++i) {
+    const auto n = std::to_string(i);
+    creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, std::string(1000, 'a' + i % 26)));
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  const auto impl = archive.getImpl();
+  const auto clusterOffset = [&](const std::string& path) {
+    const auto idx = archive.getEntryByPath(path).getIndex();
+    return impl->getClusterOffset(impl->getDirent(entry_index_t(idx))->getClusterNumber());
+  };
+  ASSERT_GT(clusterOffset("path0"), clusterOffset("path1"));
+
+  ASSERT_EQ(std::string(archive.getEntryByPath("path0").getItem().getData()), content0);
+  ASSERT_EQ(std::string(archive.getEntryByPath("path1").getItem().getData()), content1);
+  for (auto i = 2; i < 50; ++i) {
+    const auto n = std::to_string(i);
+    ASSERT_EQ(std::string(archive.getEntryByPath("path" + n).getItem().getData()), std::string(1000, 'a' + i % 26));
+  }
+  ASSERT_TRUE(archive.check());
+  ASSERT_TRUE(archive.checkAll());
+  ASSERT_TRUE(archive.checkIntegrity(zim::IntegrityCheck::CLUSTER_DATA));
+}
+
+TEST(ZimCreator, createZimClustersInOrder)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  // The first cluster is compressed only once the second one has been,
+  // but the clusters are still written in index order (the default).
+  auto fed = std::make_shared<std::promise<void>>();
+  const std::shared_future<void> released = fed->get_future().share();
+
+  writer::Creator creator;
+  creator.configMinClusterSize(1);
+  creator.configNbWorkers(2);
+  creator.startZimCreation(tempPath);
+  creator.addItem(std::make_shared<ProviderTestItem>("path0", [=]() {
+    return new WaitingProvider(std::string(1000, 'a'), released);
+  }));
+  creator.addItem(std::make_shared<ProviderTestItem>("path1", [=]() {
+    return new NotifyingProvider(std::string(1000, 'b'), fed);
+  }));
+  for (auto i = 2; i < 50; ++i) {
+    const auto n = std::to_string(i);
+    creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, std::string(1000, 'a' + i % 26)));
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  const auto impl = archive.getImpl();
+  for (cluster_index_type i = 1; i < impl->getCountClusters().v; ++i) {
+    ASSERT_LT(impl->getClusterOffset(cluster_index_t(i-1)), impl->getClusterOffset(cluster_index_t(i))) << i;
+  }
+  ASSERT_TRUE(archive.check());
+}
+
+TEST(ZimCreator, prefetchSeekableClusters)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  writer::Creator creator;
+  creator.configCompression(zimcompZstdSeekable);
+  creator.configMinClusterSize(1);
+  creator.startZimCreation(tempPath);
+  std::vector<std::string> paths;
+  for (auto i = 0; i < 100; ++i) {
+    const auto n = std::to_string(i);
+    paths.push_back("path" + n);
+    creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, std::string(300, 'a' + i % 26)));
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  archive.prefetch(paths);
+  archive.getImpl()->waitPrefetchTasks();
+  const auto cacheSize = archive.getClusterCacheCurrentSize();
+  ASSERT_NE(0U, cacheSize);
+
+  // The clusters decoded from the batched reads are used as is.
+  for (auto i = 0; i < 100; ++i) {
+    const auto item = archive.getEntryByPath(paths[i]).getItem();
+    ASSERT_EQ(std::string(item.getData()), std::string(300, 'a' + i % 26));
+  }
+  ASSERT_EQ(cacheSize, archive.getClusterCacheCurrentSize());
+}
+
+TEST(ZimCreator, prefetchUncompressedClusters)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  writer::Creator creator;
+  creator.startZimCreation(tempPath);
+  std::vector<std::string> paths;
+  for (auto i = 0; i < 100; ++i) {
+    const auto n = std::to_string(i);
+    paths.push_back("path" + n);
+    if (i % 2) {
+      creator.addItem(std::make_shared<UncompressedTestItem>("path" + n, "Title" + n, std::string(10000, 'a' + i % 26)));
+    } else {
+      creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, std::string(10000, 'a' + i % 26)));
+    }
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  archive.prefetch(paths);
+  archive.getImpl()->waitPrefetchTasks();
+  const auto cacheSize = archive.getClusterCacheCurrentSize();
+  // The compressed clusters are decompressed, the blobs of the uncompressed
+  // ones are not read in memory.
+  ASSERT_GT(cacheSize, 50U * 10000U);
+  ASSERT_LT(cacheSize, 100U * 10000U);
+
+  for (auto i = 0; i < 100; ++i) {
+    const auto item = archive.getEntryByPath(paths[i]).getItem();
+    ASSERT_EQ(std::string(item.getData()), std::string(10000, 'a' + i % 26));
+  }
+  ASSERT_EQ(cacheSize, archive.getClusterCacheCurrentSize());
+}
+
+TEST(ZimCreator, createZimLookupGrid)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  // More entries than DIRENT_LOOKUP_CACHE_SIZE, the lookup grid doesn't
+  // have all the paths.
+  const auto count = 5000;
+  writer::Creator creator;
+  creator.startZimCreation(tempPath);
+  for (auto i = 0; i < count; ++i) {
+    const auto n = std::to_string(i);
+    creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, "Content"));
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  const auto impl = archive.getImpl();
+  ASSERT_TRUE(impl->findx('X', "index/lookupGrid/v0").first);
+  for (auto i = 0; i < count; ++i) {
+    const auto path = "path" + std::to_string(i);
+    const auto r = impl->findx('C', path);
+    ASSERT_TRUE(r.first);
+    ASSERT_EQ(archive.getEntryByPath(r.second.v).getPath(), path);
+    // The insertion position of a missing path is right after this one.
+    ASSERT_EQ(impl->findx('C', path + "\x01"), std::make_pair(false, entry_index_t(r.second.v + 1)));
+  }
+  ASSERT_EQ(impl->findx('C', "a"), std::make_pair(false, entry_index_t(0)));
+  ASSERT_EQ(impl->findx('C', "z"), std::make_pair(false, entry_index_t(count)));
+}
+
+TEST(ZimCreator, createZimWithPathHashIndex)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  writer::Creator creator;
+  creator.configPathHashIndex(true);
+  creator.startZimCreation(tempPath);
+  for (auto i = 0; i < 200; ++i) {
+    const auto n = std::to_string(i);
+    creator.addItem(std::make_shared<TestItem>("path" + n, "Title" + n, "Content" + n));
+  }
+  creator.addRedirection("redirect", "Redirect", "path10");
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  const auto impl = archive.getImpl();
+  ASSERT_TRUE(impl->findx('X', "index/pathHash/v0").first);
+  ASSERT_TRUE(impl->findx('X', "listing/titleOrdered/v1").first);
+  ASSERT_FALSE(impl->findx('X', "index/pathHash/v1").first);
+
+  for (auto i = 0; i < 200; ++i) {
+    const auto n = std::to_string(i);
+    ASSERT_EQ(archive.getEntryByPath("path" + n).getTitle(), "Title" + n);
+    ASSERT_FALSE(archive.hasEntryByPath("path" + n + "_"));
+  }
+  ASSERT_EQ(archive.getEntryByPath("redirect").getItem(true).getPath(), "path10");
+  ASSERT_FALSE(archive.hasEntryByPath("redirect_"));
+  ASSERT_EQ(archive.getEntryByTitle("Title42").getPath(), "path42");
+
+  // A missing path still gets its insertion position.
+  ASSERT_EQ(impl->findx('C', "path0_").second, impl->findx('C', "path1").second);
+  ASSERT_TRUE(archive.check());
+}
+
+TEST(ZimCreator, findByTitleInBigZim)
+{
+  unittests::TempFile temp("zimfile");
+  auto tempPath = temp.path();
+
+  // More entries than DIRENT_LOOKUP_CACHE_SIZE, the lookup grid of the
+  // title index doesn't have all the titles.
+  const auto count = 5000;
+  writer::Creator creator;
+  creator.startZimCreation(tempPath);
+  for (auto i = 0; i < count; ++i) {
+    // Not in the same order than the paths.
+    const auto n = std::to_string((i * 7919) % count);
+    creator.addItem(std::make_shared<TestItem>("path" + std::to_string(i), "Title" + n, "Content"));
+  }
+  creator.finishZimCreation();
+
+  zim::Archive archive(tempPath);
+  for (auto i = 0; i < count; ++i) {
+    const auto n = std::to_string(i);
+    ASSERT_EQ(archive.getEntryByTitle("Title" + n).getTitle(), "Title" + n);
+    ASSERT_THROW(archive.getEntryByTitle("Title" + n + "_"), zim::EntryNotFound);
+  }
+  ASSERT_THROW(archive.getEntryByTitle("A"), zim::EntryNotFound);
+  ASSERT_THROW(archive.getEntryByTitle("Z"), zim::EntryNotFound);
+
+  // Title12, Title120-Title129 and Title1200-Title1299
+  auto range = archive.findByTitle("Title12");
+  auto found = 0;
+  for (auto& entry: range) {
+    ASSERT_EQ(entry.getTitle().find("Title12"), 0U);
+    found++;
+  }
+  ASSERT_EQ(found, 111);
 }
 
 
@@ -99,4 +99,22 @@ TYPED_TEST(DecoderStreamReaderTest, compressedDataFollowedByGarbage) {
   }
 }
 
+TYPED_TEST(DecoderStreamReaderTest, compressedDataInMemory) {
+  typedef typename TestFixture::CompressionInfo CompressionInfo;
+
+  const int N = 10;
+  const std::string s("DecoderStreamReader should work correctly");
+  std::string compDataStr = compress<CompressionInfo>(s*N);
+  compDataStr += std::string(10, '\0');
+
+  auto compData = zim::Buffer::makeBuffer(compDataStr.data(), zim::zsize_t(compDataStr.size()));
+
+  zim::DecoderStreamReader<CompressionInfo> dds(compData);
+  for (int i=0; i<N; i++)
+  {
+    auto decompReader = dds.sub_reader(zim::zsize_t(s.size()));
+    ASSERT_EQ(s, toString(decompReader->get_buffer(zim::offset_t(0), zim::zsize_t(s.size())))) << "i: " << i;
+  }
+}
+
 } // unnamed namespace
@@ -34,11 +34,16 @@
 
 #include "gtest/gtest.h"
 
+#include <zim/error.h>
+
 #include "../src/buffer.h"
 #include "../src/_dirent.h"
 #include "../src/direntreader.h"
 #include "../src/buffer_reader.h"
+#include "../src/file_compound.h"
+#include "../src/file_reader.h"
 #include "../src/writer/_dirent.h"
+#include "../src/writer/outputStream.h"
 
 #include "tools.h"
 
@@ -58,7 +63,9 @@ size_t writenDirentSize(const zim::writer::Dirent& dirent)
 {
   TempFile tmpFile("test_dirent");
   const auto tmp_fd = tmpFile.fd();
-  dirent.write(tmp_fd);
+  zim::writer::OutputStream out(tmp_fd);
+  dirent.write(out);
+  out.flush();
   auto size = lseek(tmp_fd, 0, SEEK_END);
   return size;
 }
@@ -114,6 +121,46 @@ TEST(DirentTest, read_write_article_dirent)
   ASSERT_EQ(dirent2.getVersion(), 0U);
 }
 
+TEST(DirentTest, read_long_dirent_from_file)
+{
+  zim::writer::Dirent dirent;
+  dirent.setNamespace('A');
+  dirent.setPath(std::string(1000, 'a'));
+  dirent.setTitle(std::string(600, 'b'));
+  dirent.setItem(17, zim::cluster_index_t(45), zim::blob_index_t(1234));
+
+  TempFile tmpFile("test_dirent");
+  zim::writer::OutputStream out(tmpFile.fd());
+  dirent.write(out);
+  out.flush();
+  const auto size = lseek(tmpFile.fd(), 0, SEEK_END);
+  tmpFile.close();
+
+  const zim::FileCompound fileCompound(tmpFile.path());
+  const auto& part = fileCompound.begin()->second;
+  zim::DirentReader direntReader(std::make_shared<zim::FileReader>(part, zim::offset_t(0), zim::zsize_t(size)));
+  const auto dirent2 = direntReader.readDirent(zim::offset_t(0));
+
+  ASSERT_EQ(dirent2->getUrl(), std::string(1000, 'a'));
+  ASSERT_EQ(dirent2->getTitle(), std::string(600, 'b'));
+  ASSERT_EQ(dirent2->getClusterNumber().v, 45U);
+  ASSERT_EQ(dirent2->getBlobNumber().v, 1234U);
+}
+
+TEST(DirentTest, read_truncated_dirent)
+{
+  zim::writer::Dirent dirent;
+  dirent.setNamespace('A');
+  dirent.setPath(std::string(300, 'a'));
+  dirent.setTitle("Foo");
+  dirent.setItem(17, zim::cluster_index_t(45), zim::blob_index_t(1234));
+
+  auto buffer = write_to_buffer(dirent);
+  const auto truncated = buffer.sub_buffer(zim::offset_t(0), zim::zsize_t(buffer.size().v - 2));
+  zim::DirentReader direntReader(std::make_shared<zim::BufferReader>(truncated));
+  ASSERT_THROW(direntReader.readDirent(zim::offset_t(0)), zim::ZimFileFormatError);
+}
+
 TEST(DirentTest, read_write_article_dirent_unicode)
 {
   zim::writer::Dirent dirent;
@@ -164,6 +211,37 @@ TEST(DirentTest, read_write_redirect_dirent)
   ASSERT_EQ(dirent2.getRedirectIndex().v, 321U);
 }
 
+TEST(DirentTest, read_title_key)
+{
+  const auto readTitleKey = [](const zim::writer::Dirent& dirent) {
+    zim::DirentReader direntReader(std::make_shared<zim::BufferReader>(write_to_buffer(dirent)));
+    return direntReader.readTitleKey(zim::offset_t(0));
+  };
+
+  zim::writer::Dirent article;
+  article.setNamespace('A');
+  article.setPath("Bar");
+  article.setTitle("Foo");
+  article.setItem(17, zim::cluster_index_t(45), zim::blob_index_t(1234));
+  ASSERT_EQ(readTitleKey(article), "AFoo");
+
+  // Without title, the title is the path.
+  zim::writer::Dirent targetDirent;
+  targetDirent.setIdx(zim::entry_index_t(321));
+  zim::writer::Dirent redirect;
+  redirect.setNamespace('B');
+  redirect.setPath("Bar");
+  redirect.setRedirect(&targetDirent);
+  ASSERT_EQ(readTitleKey(redirect), "BBar");
+
+  zim::writer::Dirent longArticle;
+  longArticle.setNamespace('C');
+  longArticle.setPath(std::string(1000, 'a'));
+  longArticle.setTitle(std::string(600, 'b'));
+  longArticle.setItem(17, zim::cluster_index_t(45), zim::blob_index_t(1234));
+  ASSERT_EQ(readTitleKey(longArticle), "C" + std::string(600, 'b'));
+}
+
 TEST(DirentTest, dirent_size)
 {
   zim::writer::Dirent dirent;
@@ -23,6 +23,7 @@
 
 #include "gtest/gtest.h"
 
+#include <map>
 #include <vector>
 #include <string>
 #include <utility>
@@ -190,5 +191,103 @@ TEST_F(FindxTest, NoExactMatch)
   ASSERT_EQ(result.second.v, 10);
 }
 
+TEST_F(FindxTest, Batch)
+{
+  zim::DirentLookup<GetDirentMock> dl(&impl, 4);
+  std::vector<zim::DirentLookup<GetDirentMock>::Key> keys(articleurl.begin(), articleurl.end());
+  keys.insert(keys.end(), {
+    {'U', "aa"}, {'A', "aabb"}, {'A', "aabbb"}, {'A', "aabbbc"}, {'A', "bb"},
+    {'A', "dd"}, {'M', "f"}, {'M', "bar"}, {'M', "foo1"}, {' ', ""}, {'z', "z"},
+    {'A', "aa"}, {'b', "aa"}
+  });
+  // Keys are not given in sorted order
+  std::reverse(keys.begin(), keys.end());
+  std::swap(keys[3], keys[17]);
+
+  const auto results = dl.find(keys);
+  ASSERT_EQ(results.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const auto expected = dl.find(keys[i].first, keys[i].second);
+    EXPECT_EQ(results[i].first, expected.first) << keys[i].first << "/" << keys[i].second;
+    EXPECT_EQ(results[i].second.v, expected.second.v) << keys[i].first << "/" << keys[i].second;
+  }
+
+  ASSERT_TRUE(dl.find(std::vector<zim::DirentLookup<GetDirentMock>::Key>()).empty());
+}
+
+// Counts the reads of each dirent.
+struct CountingDirentMock : GetDirentMock
+{
+  std::shared_ptr<const zim::Dirent> getDirent(zim::entry_index_t idx) const {
+    ++reads[idx.v];
+    return GetDirentMock::getDirent(idx);
+  }
+
+  mutable std::map<zim::entry_index_type, int> reads;
+};
+
+TEST(FindxBatchTest, DirentsAreReadOnce)
+{
+  CountingDirentMock impl;
+  zim::DirentLookup<CountingDirentMock> dl(&impl, 4);
+  impl.reads.clear();
+
+  // The neighbouring keys probe the same dirents.
+  std::vector<zim::DirentLookup<CountingDirentMock>::Key> keys(articleurl.begin(), articleurl.end());
+  keys.insert(keys.end(), {{'A', "aab"}, {'A', "aabbb"}, {'A', "aabbbc"}});
+  const auto results = dl.find(keys);
+  for (size_t i = 0; i < articleurl.size(); ++i) {
+    EXPECT_TRUE(results[i].first);
+    EXPECT_EQ(results[i].second.v, i);
+  }
+  for (const auto& r: impl.reads) {
+    EXPECT_EQ(r.second, 1) << "dirent #" << r.first;
+  }
+}
+
+TEST_F(FindxTest, StoredGrid)
+{
+  // The grid built by the creator, with the same sampling than
+  // DirentLookup(&impl, 4).
+  zim::NarrowDown grid;
+  const auto getKey = [](zim::entry_index_type i) {
+    return articleurl[i].first + articleurl[i].second;
+  };
+  const zim::entry_index_type count = articleurl.size();
+  for (zim::entry_index_type i = 0; i < count-1; i += count/4) {
+    grid.add(getKey(i), i, getKey(i+1));
+  }
+  grid.close(getKey(count-1), count-1);
+  const auto data = grid.serialize();
+
+  zim::DirentLookup<GetDirentMock> expected(&impl, 4);
+  zim::DirentLookup<GetDirentMock> dl(&impl, zim::NarrowDown(zim::Buffer::makeBuffer(data.data(), zim::zsize_t(data.size()))));
+  std::vector<zim::DirentLookup<GetDirentMock>::Key> keys(articleurl.begin(), articleurl.end());
+  keys.insert(keys.end(), {
+    {'U', "aa"}, {'A', "aabb"}, {'A', "aabbb"}, {'A', "aabbbc"}, {'A', "bb"},
+    {'A', "dd"}, {'M', "f"}, {'M', "bar"}, {'M', "foo1"}, {' ', ""}, {'z', "z"}
+  });
+  for (const auto& key: keys) {
+    const auto result = dl.find(key.first, key.second);
+    EXPECT_EQ(result.first, expected.find(key.first, key.second).first) << key.first << "/" << key.second;
+    EXPECT_EQ(result.second.v, expected.find(key.first, key.second).second.v) << key.first << "/" << key.second;
+  }
+
+  // A truncated grid or a grid of another dirent table are rejected.
+  ASSERT_THROW(zim::NarrowDown(zim::Buffer::makeBuffer(data.data(), zim::zsize_t(data.size()-1))), zim::ZimFileFormatError);
+  zim::NarrowDown shortGrid;
+  shortGrid.close(getKey(0), 0);
+  ASSERT_THROW(zim::DirentLookup<GetDirentMock>(&impl, std::move(shortGrid)), zim::ZimFileFormatError);
+
+  // Same indexes, but the keys of the first or last dirent differ.
+  zim::NarrowDown otherFirstKey;
+  otherFirstKey.add(" ", 0, getKey(1));
+  otherFirstKey.close(getKey(count-1), count-1);
+  ASSERT_THROW(zim::DirentLookup<GetDirentMock>(&impl, std::move(otherFirstKey)), zim::ZimFileFormatError);
+  zim::NarrowDown otherLastKey;
+  otherLastKey.add(getKey(0), 0, getKey(1));
+  otherLastKey.close("zz", count-1);
+  ASSERT_THROW(zim::DirentLookup<GetDirentMock>(&impl, std::move(otherLastKey)), zim::ZimFileFormatError);
+}
 
 }  // namespace
@@ -0,0 +1,94 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "../src/writer/outputStream.h"
+
+#include "gtest/gtest.h"
+#include "tools.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+namespace
+{
+
+using zim::unittests::TempFile;
+using zim::writer::OutputStream;
+
+std::string fileContent(TempFile& file)
+{
+  std::ifstream in(file.path(), std::ios::binary);
+  std::ostringstream content;
+  content << in.rdbuf();
+  return content.str();
+}
+
+TEST(OutputStream, smallWrites)
+{
+  TempFile file("output_stream");
+  OutputStream out(file.fd(), 16);
+  std::string expected;
+  for (auto i = 0; i < 100; ++i) {
+    const std::string data(i % 7, 'a' + i % 26);
+    ASSERT_EQ(out.tell().v, expected.size());
+    out.write(data.data(), data.size());
+    expected += data;
+  }
+  ASSERT_EQ(out.tell().v, expected.size());
+  out.flush();
+  ASSERT_EQ(fileContent(file), expected);
+}
+
+TEST(OutputStream, bigWrites)
+{
+  TempFile file("output_stream");
+  OutputStream out(file.fd(), 16);
+  const std::string small("0123456789");
+  const std::string big(1000, 'x');
+  out.write(small.data(), small.size());
+  // Nothing is written until flushed, or the buffer is full.
+  ASSERT_EQ(fileContent(file), "");
+  out.write(zim::Blob(big.data(), big.size()));
+  ASSERT_EQ(fileContent(file), small + big);
+  out.write(small.data(), small.size());
+  out.write(big.data(), big.size());
+  out.write(small.data(), small.size());
+  ASSERT_EQ(out.tell().v, 3 * small.size() + 2 * big.size());
+  out.flush();
+  ASSERT_EQ(fileContent(file), small + big + small + big + small);
+}
+
+TEST(OutputStream, fromFilePosition)
+{
+  TempFile file("output_stream");
+  ASSERT_EQ(lseek(file.fd(), 100, SEEK_SET), 100);
+  OutputStream out(file.fd());
+  ASSERT_EQ(out.tell().v, 100U);
+  out.write("abc", 3);
+  ASSERT_EQ(out.tell().v, 103U);
+  out.flush();
+  ASSERT_EQ(fileContent(file), std::string(100, '\0') + "abc");
+}
+
+} // unnamed namespace
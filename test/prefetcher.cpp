@@ -0,0 +1,67 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "prefetcher.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+TEST(PrefetcherTest, RunsTasks) {
+  zim::Prefetcher prefetcher(3, 100);
+  std::atomic<int> sum(0);
+  for (int i = 1; i <= 10; ++i) {
+    prefetcher.add([&sum, i](){ sum += i; });
+  }
+  prefetcher.wait();
+  EXPECT_EQ(55, sum.load());
+
+  // Exceptions are ignored
+  prefetcher.add([](){ throw std::runtime_error("error"); });
+  prefetcher.add([&sum](){ sum += 1; });
+  prefetcher.wait();
+  EXPECT_EQ(56, sum.load());
+}
+
+TEST(PrefetcherTest, DropsOldestTasks) {
+  zim::Prefetcher prefetcher(1, 2);
+  std::mutex blocker;
+  std::unique_lock<std::mutex> lock(blocker);
+  std::atomic<bool> started(false);
+  std::atomic<int> done(0);
+  prefetcher.add([&](){
+    started = true;
+    std::lock_guard<std::mutex> l(blocker);
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  // The thread is busy, only the last two tasks are kept.
+  for (int i = 0; i < 5; ++i) {
+    prefetcher.add([&done, i](){ done += i; });
+  }
+  lock.unlock();
+  prefetcher.wait();
+  EXPECT_EQ(3+4, done.load());
+}
+
+} // unnamed namespace
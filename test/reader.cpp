@@ -25,6 +25,9 @@
 
 #include "gtest/gtest.h"
 
+#include <cstdio>
+#include <fstream>
+
 namespace
 {
 
@@ -154,4 +157,80 @@ TEST(FileReader, zeroReader)
   }
 }
 
+TEST(FileReader, readBatch)
+{
+  char data[] = "abcdefghijklmnopqrstuvwxyz";
+  for(auto& createReader:createReaders) {
+    auto reader = createReader(data, zsize_t(26));
+
+    // More requests than io_uring submits at once.
+    std::vector<std::string> out(200, std::string(4, '.'));
+    std::vector<Reader::ReadRequest> requests;
+    for (size_t i = 0; i < out.size(); ++i) {
+      const offset_t offset((i * 7) % 23);
+      const zsize_t size(i % 5);
+      requests.push_back({&out[i][0], offset, size});
+    }
+    reader->readBatch(requests);
+
+    for (size_t i = 0; i < out.size(); ++i) {
+      std::string expected(data + (i * 7) % 23, i % 5);
+      expected.resize(4, '.');
+      ASSERT_EQ(expected, out[i]) << i;
+    }
+  }
+}
+
+TEST(FileReader, multiPart)
+{
+  // With parts of 64KiB (a multiple of the page size), a range over several
+  // parts is mapped in memory. Otherwise, it is copied.
+  for (const size_t partSize: {1000, 64*1024}) {
+    const auto tmpfile = makeTempFile("multipart", "");
+    const std::string path = tmpfile->path() + "_split";
+    std::string data(3*partSize, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = char(i % 251);
+    }
+    const std::vector<std::string> partPaths{path + "aa", path + "ab", path + "ac"};
+    for (size_t i = 0; i < partPaths.size(); ++i) {
+      std::ofstream(partPaths[i], std::ios::binary).write(&data[i*partSize], partSize);
+    }
+
+    const auto fileCompound = std::make_shared<FileCompound>(path);
+    ASSERT_TRUE(fileCompound->is_multiPart());
+    const MultiPartFileReader reader(fileCompound);
+    const std::vector<std::pair<size_t, size_t>> ranges{
+      {0, data.size()},
+      {10, 2*partSize},
+      {partSize-1, 2},
+      {partSize, partSize},
+      {2*partSize+5, 10}
+    };
+    for (const auto& range: ranges) {
+      const std::string expected = data.substr(range.first, range.second);
+      const offset_t offset(range.first);
+      const zsize_t size(range.second);
+      const auto buffer = reader.get_buffer(offset, size);
+      ASSERT_EQ(expected, std::string(buffer.data(), buffer.size().v)) << range.first;
+
+      const auto subReader = reader.sub_reader(offset, size);
+      std::string out(range.second, '.');
+      subReader->read(&out[0], offset_t(0), size);
+      ASSERT_EQ(expected, out) << range.first;
+      const auto subBuffer = subReader->get_buffer(offset_t(0), size);
+      ASSERT_EQ(expected, std::string(subBuffer.data(), subBuffer.size().v)) << range.first;
+    }
+
+    // A sub-reader in a single part reads the part directly.
+    const auto subReader = reader.sub_reader(offset_t(partSize+1), zsize_t(partSize-1));
+    ASSERT_NE(nullptr, dynamic_cast<const FileReader*>(subReader.get()));
+    ASSERT_EQ(data[partSize+1], subReader->read(offset_t(0)));
+
+    for (const auto& partPath: partPaths) {
+      std::remove(partPath.c_str());
+    }
+  }
+}
+
 } // unnamed namespace
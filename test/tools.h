@@ -22,6 +22,7 @@
 
 
 #include <string>
+#include <utility>
 #include <sys/types.h>
 #ifdef _WIN32
 #include <windows.h>
@@ -33,6 +34,7 @@
 #endif
 
 #include "../src/buffer.h"
+#include "../src/writer/outputStream.h"
 
 namespace zim
 {
@@ -98,12 +100,27 @@ std::unique_ptr<TempFile>
 makeTempFile(const char* name, const std::string& content);
 
 
+// The objects of the writer write to an OutputStream, the others to a file.
+template<typename T>
+auto write_to_fd(const T& object, int fd) -> decltype(object.write(fd))
+{
+  object.write(fd);
+}
+
+template<typename T>
+auto write_to_fd(const T& object, int fd) -> decltype(object.write(std::declval<zim::writer::OutputStream&>()))
+{
+  zim::writer::OutputStream out(fd);
+  object.write(out);
+  out.flush();
+}
+
 template<typename T>
 zim::Buffer write_to_buffer(const T& object)
 {
   TempFile tmpFile("test_temp_file");
   const auto tmp_fd = tmpFile.fd();
-  object.write(tmp_fd);
+  write_to_fd(object, tmp_fd);
   auto size = LSEEK(tmp_fd, 0, SEEK_END);
 
   auto buf = zim::Buffer::makeBuffer(zim::zsize_t(size));